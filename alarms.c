@@ -0,0 +1,342 @@
+#include "rbus_elements.h"
+
+extern rbusHandle_t g_rbusHandle;
+
+typedef enum {
+   ALARM_GT = 0,     // value > threshold
+   ALARM_LT = 1,     // value < threshold
+   ALARM_DELTA = 2   // increase within the window > threshold
+} AlarmCondition;
+
+typedef struct {
+   char name[MAX_NAME_LEN];
+   char target[MAX_NAME_LEN];
+   AlarmCondition cond;
+   double threshold;
+   double clear;
+   uint32_t window;
+} AlarmRule;
+
+typedef struct {
+   bool primed;
+   bool active;
+   uint32_t row;          // instance in ALARM_TABLE while active
+   double window_value;   // value at start of the current delta window
+   time_t window_start;
+   int free_next;         // free list link, valid for the first slot of a free run
+   int free_len;
+} AlarmState;
+
+static AlarmRule* g_alarm_rules = NULL;
+static int g_num_alarm_rules = 0;
+static AlarmState* g_alarm_states = NULL;
+static int g_num_alarm_states = 0;
+static int g_alarm_free_head = -1;
+
+static time_t monotonic_seconds(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec;
+}
+
+bool alarm_add_rule(cJSON* item, int index) {
+   cJSON* name_obj = cJSON_GetObjectItem(item, "name");
+   cJSON* target_obj = cJSON_GetObjectItem(item, "target");
+   cJSON* cond_obj = cJSON_GetObjectItem(item, "condition");
+   cJSON* threshold_obj = cJSON_GetObjectItem(item, "threshold");
+   cJSON* clear_obj = cJSON_GetObjectItem(item, "clear");
+   cJSON* window_obj = cJSON_GetObjectItem(item, "window");
+
+   if (!cJSON_IsString(target_obj) || !cJSON_IsNumber(threshold_obj)) {
+      fprintf(stderr, "Alarm item %d needs a target and a numeric threshold\n", index);
+      return false;
+   }
+
+   AlarmCondition cond = ALARM_GT;
+   const char* cond_str = cJSON_IsString(cond_obj) ? cJSON_GetStringValue(cond_obj) : "gt";
+   if (strcmp(cond_str, "gt") == 0) {
+      cond = ALARM_GT;
+   } else if (strcmp(cond_str, "lt") == 0) {
+      cond = ALARM_LT;
+   } else if (strcmp(cond_str, "delta") == 0) {
+      cond = ALARM_DELTA;
+   } else {
+      fprintf(stderr, "Invalid alarm condition '%s' for item %d\n", cond_str, index);
+      return false;
+   }
+
+   AlarmRule* rules = realloc(g_alarm_rules, (g_num_alarm_rules + 1) * sizeof(AlarmRule));
+   if (!rules) {
+      fprintf(stderr, "Failed to allocate memory for alarm rules\n");
+      return false;
+   }
+   g_alarm_rules = rules;
+   AlarmRule* r = &g_alarm_rules[g_num_alarm_rules++];
+   snprintf(r->name, MAX_NAME_LEN, "%s", cJSON_IsString(name_obj) ? cJSON_GetStringValue(name_obj) : cJSON_GetStringValue(target_obj));
+   snprintf(r->target, MAX_NAME_LEN, "%s", cJSON_GetStringValue(target_obj));
+   r->cond = cond;
+   r->threshold = threshold_obj->valuedouble;
+   r->clear = cJSON_IsNumber(clear_obj) ? clear_obj->valuedouble : r->threshold;
+   r->window = cJSON_IsNumber(window_obj) && window_obj->valuedouble >= 1 ? (uint32_t)window_obj->valuedouble : ALARM_DEFAULT_WINDOW;
+   return true;
+}
+
+static int compare_rules(const void* a, const void* b) {
+   return strcmp(((const AlarmRule*)a)->target, ((const AlarmRule*)b)->target);
+}
+
+void alarm_bind_rules(void) {
+   if (g_num_alarm_rules == 0) return;
+
+   // Group rules by target so each element references one contiguous run
+   qsort(g_alarm_rules, g_num_alarm_rules, sizeof(AlarmRule), compare_rules);
+
+   if (!find_table(ALARM_TABLE)) {
+      create_table(ALARM_TABLE);
+   }
+
+   int i = 0;
+   while (i < g_num_alarm_rules) {
+      int j = i + 1;
+      while (j < g_num_alarm_rules && strcmp(g_alarm_rules[j].target, g_alarm_rules[i].target) == 0) j++;
+
+      DataElement* de = lookup_element(g_alarm_rules[i].target);
+      if (!de || de->elementType != RBUS_ELEMENT_TYPE_PROPERTY) {
+         fprintf(stderr, "Alarm rule %s: unknown property %s\n", g_alarm_rules[i].name, g_alarm_rules[i].target);
+      } else {
+         de->alarms.rule = i;
+         de->alarms.count = j - i;
+         // Wildcard rules get their state per row property when the row property is created
+         if (!strstr(de->name, "{i}")) {
+            AlarmBinding rules = de->alarms;
+            alarm_bind(&de->alarms, &rules);
+         }
+      }
+      i = j;
+   }
+}
+
+void alarm_bind(AlarmBinding* binding, const AlarmBinding* rules) {
+   binding->count = 0;
+   if (!rules || rules->count == 0) return;
+
+   int base = -1;
+   for (int* link = &g_alarm_free_head; *link != -1; link = &g_alarm_states[*link].free_next) {
+      if (g_alarm_states[*link].free_len == rules->count) {
+         base = *link;
+         *link = g_alarm_states[base].free_next;
+         break;
+      }
+   }
+   if (base == -1) {
+      AlarmState* states = realloc(g_alarm_states, (g_num_alarm_states + rules->count) * sizeof(AlarmState));
+      if (!states) {
+         fprintf(stderr, "Failed to allocate alarm state\n");
+         return;
+      }
+      g_alarm_states = states;
+      base = g_num_alarm_states;
+      g_num_alarm_states += rules->count;
+   }
+
+   memset(&g_alarm_states[base], 0, rules->count * sizeof(AlarmState));
+   binding->rule = rules->rule;
+   binding->count = rules->count;
+   binding->state = base;
+}
+
+static void publish_alarm(const AlarmRule* r, const AlarmState* st, const char* name, double value) {
+   rbusObject_t data;
+   rbusObject_Init(&data, NULL);
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, r->name);
+   rbusObject_SetValue(data, "RuleName", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, name);
+   rbusObject_SetValue(data, "Target", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, st->active ? "Raised" : "Cleared");
+   rbusObject_SetValue(data, "State", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetDouble(val, value);
+   rbusObject_SetValue(data, "Value", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetDouble(val, r->threshold);
+   rbusObject_SetValue(data, "Threshold", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, st->row);
+   rbusObject_SetValue(data, "Instance", val);
+   rbusValue_Release(val);
+
+   rbusEvent_t event = {.name = ALARM_EVENT, .type = RBUS_EVENT_GENERAL, .data = data};
+   rbusError_t rc = rbusEvent_Publish(g_rbusHandle, &event);
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish %s: %d\n", ALARM_EVENT, rc);
+   }
+   rbusObject_Release(data);
+}
+
+static void raise_alarm(const AlarmRule* r, AlarmState* st, const char* name, double value) {
+   st->active = true;
+   st->row = 0;
+
+   uint32_t inst = 0;
+   if (table_add_row(g_rbusHandle, ALARM_TABLE, NULL, &inst) == RBUS_ERROR_SUCCESS) {
+      TableRow* row = find_row(find_table(ALARM_TABLE), inst);
+      RowProperty* p;
+      if (row) {
+         if ((p = row_property(row, "RuleName", TYPE_STRING))) {
+            free(p->value.strVal);
+            p->value.strVal = strdup(r->name);
+         }
+         if ((p = row_property(row, "Target", TYPE_STRING))) {
+            free(p->value.strVal);
+            p->value.strVal = strdup(name);
+         }
+         if ((p = row_property(row, "Value", TYPE_DOUBLE))) {
+            p->value.doubleVal = value;
+         }
+         if ((p = row_property(row, "RaisedTime", TYPE_DATETIME))) {
+            char time_str[32];
+            time_t now = time(NULL);
+            struct tm tm_utc;
+            gmtime_r(&now, &tm_utc);
+            strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%SZ", &tm_utc);
+            free(p->value.strVal);
+            p->value.strVal = strdup(time_str);
+         }
+      }
+      st->row = inst;
+      rbusError_t rc = rbusTable_registerRow(g_rbusHandle, ALARM_TABLE, inst, NULL);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         fprintf(stderr, "Failed to register alarm row %s%u.: %d\n", ALARM_TABLE, inst, rc);
+      }
+   }
+
+   fprintf(stderr, "Alarm %s raised for %s (value %g, threshold %g)\n", r->name, name, value, r->threshold);
+   publish_alarm(r, st, name, value);
+}
+
+static void clear_alarm(const AlarmRule* r, AlarmState* st, const char* name, double value) {
+   st->active = false;
+
+   if (st->row) {
+      char row_name[MAX_NAME_LEN];
+      snprintf(row_name, sizeof(row_name), "%s%u.", ALARM_TABLE, st->row);
+      rbusTable_unregisterRow(g_rbusHandle, row_name);
+      table_remove_row(g_rbusHandle, row_name);
+   }
+
+   fprintf(stderr, "Alarm %s cleared for %s (value %g)\n", r->name, name, value);
+   publish_alarm(r, st, name, value);
+   st->row = 0;
+}
+
+void alarm_unbind(AlarmBinding* binding, const char* name) {
+   if (binding->count == 0) return;
+
+   for (int k = 0; k < binding->count; k++) {
+      AlarmState* st = &g_alarm_states[binding->state + k];
+      if (st->active) {
+         clear_alarm(&g_alarm_rules[binding->rule + k], st, name, 0);
+      }
+   }
+
+   // Runs are recycled whole; every binding of one element has the same length
+   AlarmState* first = &g_alarm_states[binding->state];
+   first->free_len = binding->count;
+   first->free_next = g_alarm_free_head;
+   g_alarm_free_head = binding->state;
+   binding->count = 0;
+}
+
+static bool value_as_double(rbusValue_t value, double* out) {
+   switch (rbusValue_GetType(value)) {
+      case RBUS_INT32: *out = rbusValue_GetInt32(value); return true;
+      case RBUS_UINT32: *out = rbusValue_GetUInt32(value); return true;
+      case RBUS_INT64: *out = (double)rbusValue_GetInt64(value); return true;
+      case RBUS_UINT64: *out = (double)rbusValue_GetUInt64(value); return true;
+      case RBUS_SINGLE: *out = rbusValue_GetSingle(value); return true;
+      case RBUS_DOUBLE: *out = rbusValue_GetDouble(value); return true;
+      case RBUS_BYTE: *out = rbusValue_GetByte(value); return true;
+      case RBUS_BOOLEAN: *out = rbusValue_GetBoolean(value) ? 1 : 0; return true;
+      default: return false;
+   }
+}
+
+void alarm_evaluate(const char* name, const AlarmBinding* binding, rbusValue_t value) {
+   if (!binding || binding->count == 0) return;
+
+   double v;
+   if (!value_as_double(value, &v)) return;
+
+   time_t now = monotonic_seconds();
+   for (int k = 0; k < binding->count; k++) {
+      const AlarmRule* r = &g_alarm_rules[binding->rule + k];
+      AlarmState* st = &g_alarm_states[binding->state + k];
+      bool raise = false, clear = false;
+
+      switch (r->cond) {
+         case ALARM_GT:
+            raise = v > r->threshold;
+            clear = v <= r->clear;
+            break;
+         case ALARM_LT:
+            raise = v < r->threshold;
+            clear = v >= r->clear;
+            break;
+         case ALARM_DELTA: {
+            if (!st->primed || v < st->window_value) {
+               // First sample, or the counter was reset: start a new window
+               st->window_value = v;
+               st->window_start = now;
+               st->primed = true;
+               break;
+            }
+            double delta = v - st->window_value;
+            time_t elapsed = now - st->window_start;
+            if (elapsed > (time_t)r->window) {
+               // Writes sparser than the window: judge the increase per window, so a slow
+               // climb over a long gap is not mistaken for a burst
+               delta = delta * r->window / elapsed;
+            }
+            raise = delta > r->threshold;
+            if (elapsed >= (time_t)r->window) {
+               // A full window elapsed; a quiet window clears the alarm
+               clear = delta <= r->clear;
+               st->window_value = v;
+               st->window_start = now;
+            }
+            break;
+         }
+      }
+
+      if (!st->active && raise) {
+         raise_alarm(r, st, name, v);
+      } else if (st->active && clear && !raise) {
+         clear_alarm(r, st, name, v);
+      }
+   }
+}
+
+void alarm_cleanup(void) {
+   free(g_alarm_rules);
+   g_alarm_rules = NULL;
+   g_num_alarm_rules = 0;
+   free(g_alarm_states);
+   g_alarm_states = NULL;
+   g_num_alarm_states = 0;
+   g_alarm_free_head = -1;
+}
@@ -0,0 +1,267 @@
+#include "rbus_elements.h"
+#include <pthread.h>
+
+typedef struct {
+   uint64_t version;
+   ChangeKind kind;
+   char* name;
+} ChangeEntry;
+
+// Version v lives in slot v % CHANGE_LOG_SIZE; versions are consecutive so the ring
+// holds exactly (g_version - CHANGE_LOG_SIZE, g_version] once it has wrapped.
+static ChangeEntry g_changes[CHANGE_LOG_SIZE];
+static uint64_t g_version = 0;
+static time_t g_epoch = 0;
+// Changes are recorded from rbus callbacks, set sessions and main-loop providers
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t changelog_record(const char* name, ChangeKind kind) {
+   char* dup = strdup(name);
+   pthread_mutex_lock(&g_lock);
+   if (g_epoch == 0) {
+      g_epoch = time(NULL);
+   }
+   uint64_t version = ++g_version;
+   ChangeEntry* e = &g_changes[version % CHANGE_LOG_SIZE];
+   char* old = e->name;
+   e->name = dup;
+   e->version = version;
+   e->kind = kind;
+   pthread_mutex_unlock(&g_lock);
+   free(old);
+   return version;
+}
+
+uint64_t changelog_version(void) {
+   pthread_mutex_lock(&g_lock);
+   uint64_t version = g_version;
+   pthread_mutex_unlock(&g_lock);
+   return version;
+}
+
+rbusError_t get_model_version(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   rbusValue_SetUInt64(value, changelog_version());
+   rbusProperty_SetValue(property, value);
+   rbusValue_Release(value);
+   return RBUS_ERROR_SUCCESS;
+}
+
+typedef struct {
+   bool found;
+   uint64_t version;
+} VersionLookup;
+
+static void capture_version(const ModelEntry* entry, void* ctx) {
+   VersionLookup* l = (VersionLookup*)ctx;
+   l->found = true;
+   l->version = entry->version;
+}
+
+// A row property only enters its row on the first set; before that it is known from
+// its wildcard definition and has never been written
+static bool unwritten_row_property(const char* name) {
+   uint32_t inst;
+   char* prop = NULL;
+   char* tbl = get_table_name(name, &inst, &prop);
+   bool known = false;
+   if (tbl) {
+      TableDef* table = find_table(tbl);
+      char* wildcard = create_wildcard(name);
+      DataElement* de = wildcard ? lookup_element(wildcard) : NULL;
+      known = table && find_row(table, inst) && de && de->elementType == RBUS_ELEMENT_TYPE_PROPERTY;
+      free(wildcard);
+   }
+   free(tbl);
+   free(prop);
+   return known;
+}
+
+// Companion "<name>_Version" of a stored property: the version of its last set, 0 if never set
+rbusError_t get_element_version(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+   const char* name = rbusProperty_GetName(property);
+   size_t len = strlen(name);
+   size_t suffix_len = strlen(VERSION_SUFFIX);
+   char target[MAX_NAME_LEN * 2];
+   if (len <= suffix_len || len - suffix_len >= sizeof(target)) {
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   memcpy(target, name, len - suffix_len);
+   target[len - suffix_len] = '\0';
+
+   VersionLookup l = {.found = false};
+   model_lock();
+   model_walk(target, capture_version, &l);
+   if (!l.found && unwritten_row_property(target)) {
+      l.found = true;
+      l.version = 0;
+   }
+   model_unlock();
+   if (!l.found) {
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   rbusValue_SetUInt64(value, l.version);
+   rbusProperty_SetValue(property, value);
+   rbusValue_Release(value);
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t set_element_version(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+   (void)property;
+   return set_session_end(handle, options, RBUS_ERROR_ACCESS_NOT_ALLOWED);
+}
+
+static bool get_cursor(rbusValue_t val, uint64_t* cursor) {
+   switch (val ? rbusValue_GetType(val) : RBUS_NONE) {
+      case RBUS_UINT64:
+         *cursor = rbusValue_GetUInt64(val);
+         return true;
+      case RBUS_INT64:
+         *cursor = (uint64_t)rbusValue_GetInt64(val);
+         return rbusValue_GetInt64(val) >= 0;
+      case RBUS_UINT32:
+         *cursor = rbusValue_GetUInt32(val);
+         return true;
+      case RBUS_INT32:
+         *cursor = (uint64_t)rbusValue_GetInt32(val);
+         return rbusValue_GetInt32(val) >= 0;
+      case RBUS_STRING: {
+         const char* str = rbusValue_GetString(val, NULL);
+         char* end;
+         errno = 0;
+         unsigned long long v = strtoull(str, &end, 10);
+         if (errno != 0 || end == str || *end != '\0') return false;
+         *cursor = v;
+         return true;
+      }
+      default:
+         return false;
+   }
+}
+
+rbusError_t get_changes_since_method(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
+   (void)methodName; (void)asyncHandle;
+
+   uint64_t cursor = 0;
+   rbusValue_t cursorVal = rbusObject_GetValue(inParams, "Cursor");
+   if (cursorVal && !get_cursor(cursorVal, &cursor)) {
+      rbusValue_t errorVal;
+      rbusValue_Init(&errorVal);
+      rbusValue_SetString(errorVal, "Cursor must be a non-negative integer");
+      rbusObject_SetValue(outParams, "error", errorVal);
+      rbusValue_Release(errorVal);
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   // The entries are copied out, so values are read without holding the ring
+   pthread_mutex_lock(&g_lock);
+   uint64_t version = g_version;
+   time_t epoch_now = g_epoch;
+
+   // A different epoch means the cursor came from a previous run of the daemon
+   bool resync = false;
+   rbusValue_t epochVal = rbusObject_GetValue(inParams, "Epoch");
+   uint64_t epoch = 0;
+   if (epochVal && get_cursor(epochVal, &epoch) && epoch != (uint64_t)epoch_now) {
+      resync = true;
+   }
+   if (cursor > version || version - cursor > CHANGE_LOG_SIZE) {
+      resync = true;
+   }
+   ChangeEntry* changes = NULL;
+   int num_changes = 0;
+   if (!resync && version > cursor) {
+      changes = calloc(version - cursor, sizeof(ChangeEntry));
+      for (uint64_t v = cursor + 1; changes && v <= version; v++) {
+         const ChangeEntry* e = &g_changes[v % CHANGE_LOG_SIZE];
+         if (!e->name) continue;
+         changes[num_changes] = *e;
+         changes[num_changes].name = strdup(e->name);
+         if (changes[num_changes].name) num_changes++;
+      }
+   }
+   pthread_mutex_unlock(&g_lock);
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetUInt64(val, version);
+   rbusObject_SetValue(outParams, "Cursor", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt64(val, (uint64_t)epoch_now);
+   rbusObject_SetValue(outParams, "Epoch", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetBoolean(val, resync);
+   rbusObject_SetValue(outParams, "ResyncRequired", val);
+   rbusValue_Release(val);
+
+   if (resync) {
+      return RBUS_ERROR_SUCCESS;
+   }
+
+   rbusObject_t values, added, removed;
+   rbusObject_Init(&values, NULL);
+   rbusObject_Init(&added, NULL);
+   rbusObject_Init(&removed, NULL);
+
+   // Walk oldest to newest so a name changed several times reports its latest state once
+   for (int i = 0; i < num_changes; i++) {
+      const ChangeEntry* e = &changes[i];
+
+      if (e->kind == CHANGE_VALUE) {
+         rbusProperty_t prop = rbusProperty_Init(NULL, e->name, NULL);
+         if (getHandler(handle, prop, NULL) == RBUS_ERROR_SUCCESS && rbusProperty_GetValue(prop)) {
+            rbusObject_SetValue(values, e->name, rbusProperty_GetValue(prop));
+         }
+         rbusProperty_Release(prop);
+      } else {
+         rbusValue_Init(&val);
+         rbusValue_SetUInt64(val, e->version);
+         rbusObject_SetValue(e->kind == CHANGE_ROW_ADDED ? added : removed, e->name, val);
+         rbusValue_Release(val);
+      }
+   }
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, values);
+   rbusObject_SetValue(outParams, "Values", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, added);
+   rbusObject_SetValue(outParams, "RowsAdded", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, removed);
+   rbusObject_SetValue(outParams, "RowsRemoved", val);
+   rbusValue_Release(val);
+
+   rbusObject_Release(values);
+   rbusObject_Release(added);
+   rbusObject_Release(removed);
+   for (int i = 0; i < num_changes; i++) {
+      free(changes[i].name);
+   }
+   free(changes);
+
+   return RBUS_ERROR_SUCCESS;
+}
+
+void changelog_cleanup(void) {
+   pthread_mutex_lock(&g_lock);
+   for (int i = 0; i < CHANGE_LOG_SIZE; i++) {
+      free(g_changes[i].name);
+      g_changes[i].name = NULL;
+   }
+   g_version = 0;
+   pthread_mutex_unlock(&g_lock);
+}
@@ -2,95 +2,366 @@
 #include <ifaddrs.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/ioctl.h>
 #include <net/if.h>
 #include <netdb.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
+#ifndef __APPLE__
+#include <linux/rtnetlink.h>
+#endif
 
 
-// Memory cache for optimization
+// Memory snapshot shared by all getters. Readers copy it under a sequence counter
+// (odd while a refresh is writing) so total/free/used always come from one read.
 typedef struct {
    uint64_t total;  // Total memory in kB
    uint64_t free;   // Free memory in kB
    uint64_t used;   // Used memory in kB
-   time_t last_updated; // Last update timestamp
-} MemoryCache;
+   uint64_t last_updated; // CLOCK_MONOTONIC ms of the last refresh
+} MemorySnapshot;
+
+static MemorySnapshot g_mem_snap = {0};
+static unsigned int g_mem_seq = 0;
+static int g_mem_refreshing = 0;
+static unsigned int g_mem_refresh_ms = MEMORY_CACHE_TIMEOUT * 1000;
+#ifndef __APPLE__
+static int g_meminfo_fd = -1;
+#endif
+
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static bool read_memory_snapshot(MemorySnapshot* out) {
+   unsigned int seq;
+   do {
+      seq = __atomic_load_n(&g_mem_seq, __ATOMIC_ACQUIRE);
+      out->total = __atomic_load_n(&g_mem_snap.total, __ATOMIC_RELAXED);
+      out->free = __atomic_load_n(&g_mem_snap.free, __ATOMIC_RELAXED);
+      out->used = __atomic_load_n(&g_mem_snap.used, __ATOMIC_RELAXED);
+      out->last_updated = __atomic_load_n(&g_mem_snap.last_updated, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while ((seq & 1) || seq != __atomic_load_n(&g_mem_seq, __ATOMIC_RELAXED));
+   return out->total != 0;
+}
 
-static MemoryCache g_mem_cache = {0};
+static void publish_memory_snapshot(uint64_t total, uint64_t free, uint64_t used, uint64_t now) {
+   __atomic_fetch_add(&g_mem_seq, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   __atomic_store_n(&g_mem_snap.total, total, __ATOMIC_RELAXED);
+   __atomic_store_n(&g_mem_snap.free, free, __ATOMIC_RELAXED);
+   __atomic_store_n(&g_mem_snap.used, used, __ATOMIC_RELAXED);
+   __atomic_store_n(&g_mem_snap.last_updated, now, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&g_mem_seq, 1, __ATOMIC_RELEASE);
+}
+
+#ifndef __APPLE__
+typedef struct {
+   const char* key;
+   size_t len;
+   uint64_t* value;
+} MeminfoField;
+
+// Scan "Key:   value kB" lines for the requested keys, stopping once all are found
+static int scan_meminfo(const char* buf, size_t len, MeminfoField* fields, int count) {
+   const char* p = buf;
+   const char* end = buf + len;
+   int found = 0;
+
+   while (p < end && found < count) {
+      const char* colon = memchr(p, ':', (size_t)(end - p));
+      if (!colon) break;
+      size_t klen = (size_t)(colon - p);
+
+      for (int i = 0; i < count; i++) {
+         if (fields[i].len == klen && memcmp(fields[i].key, p, klen) == 0) {
+            const char* v = colon + 1;
+            while (v < end && *v == ' ') v++;
+            uint64_t n = 0;
+            while (v < end && *v >= '0' && *v <= '9') n = n * 10 + (uint64_t)(*v++ - '0');
+            *fields[i].value = n;
+            found++;
+            break;
+         }
+      }
 
-// Helper function to update memory cache
+      const char* nl = memchr(colon, '\n', (size_t)(end - colon));
+      if (!nl) break;
+      p = nl + 1;
+   }
+   return found;
+}
+#endif
+
+// Refresh the shared snapshot if it is older than the refresh interval. Only one caller
+// refreshes at a time; concurrent callers keep using the previous snapshot.
 static bool update_memory_cache(void) {
-   time_t now = time(NULL);
-   if (now - g_mem_cache.last_updated < MEMORY_CACHE_TIMEOUT) {
+   uint64_t now = monotonic_ms();
+   uint64_t last = __atomic_load_n(&g_mem_snap.last_updated, __ATOMIC_RELAXED);
+   if (last != 0 && now - last < __atomic_load_n(&g_mem_refresh_ms, __ATOMIC_RELAXED)) {
       return true;
    }
+   if (__atomic_exchange_n(&g_mem_refreshing, 1, __ATOMIC_ACQUIRE)) {
+      return __atomic_load_n(&g_mem_snap.total, __ATOMIC_RELAXED) != 0;
+   }
 
+   bool ok = false;
 #ifdef __APPLE__
    int mib[2] = {CTL_HW, HW_MEMSIZE};
    uint64_t total_mem;
    size_t len = sizeof(total_mem);
-   if (sysctl(mib, 2, &total_mem, &len, NULL, 0) == -1) {
-      return false;
-   }
-
    mach_port_t host_port = mach_host_self();
    vm_size_t page_size;
    vm_statistics64_data_t vm_stat;
    unsigned int count = HOST_VM_INFO64_COUNT;
 
-   if (host_statistics64(host_port, HOST_VM_INFO64, (host_info64_t)&vm_stat, &count) != KERN_SUCCESS ||
-      host_page_size(host_port, &page_size) != KERN_SUCCESS) {
-      mach_port_deallocate(mach_task_self(), host_port);
-      return false;
+   if (sysctl(mib, 2, &total_mem, &len, NULL, 0) == 0 &&
+      host_statistics64(host_port, HOST_VM_INFO64, (host_info64_t)&vm_stat, &count) == KERN_SUCCESS &&
+      host_page_size(host_port, &page_size) == KERN_SUCCESS) {
+      publish_memory_snapshot(total_mem / 1024,
+         (vm_stat.free_count + vm_stat.inactive_count) * page_size / 1024,
+         (vm_stat.active_count + vm_stat.wire_count) * page_size / 1024, now);
+      ok = true;
    }
    mach_port_deallocate(mach_task_self(), host_port);
-
-   g_mem_cache.total = total_mem / 1024;
-   g_mem_cache.free = (vm_stat.free_count + vm_stat.inactive_count) * page_size / 1024;
-   g_mem_cache.used = (vm_stat.active_count + vm_stat.wire_count) * page_size / 1024;
 #else
-   FILE* fp = fopen("/proc/meminfo", "r");
-   if (!fp) {
+   if (g_meminfo_fd < 0) {
+      g_meminfo_fd = open("/proc/meminfo", O_RDONLY | O_CLOEXEC);
+   }
+
+   // /proc/meminfo is regenerated on every read from offset 0, so the fd stays open
+   char buf[4096];
+   ssize_t n = g_meminfo_fd >= 0 ? pread(g_meminfo_fd, buf, sizeof(buf), 0) : -1;
+   if (n > 0) {
+      uint64_t mem_total = 0, mem_free = 0, buffers = 0, cached = 0, sreclaimable = 0;
+      MeminfoField fields[] = {
+         {"MemTotal", 8, &mem_total},
+         {"MemFree", 7, &mem_free},
+         {"Buffers", 7, &buffers},
+         {"Cached", 6, &cached},
+         {"SReclaimable", 12, &sreclaimable},
+      };
+      scan_meminfo(buf, (size_t)n, fields, sizeof(fields) / sizeof(fields[0]));
+
+      if (mem_total != 0 && mem_free != 0) {
+         uint64_t free = mem_free + buffers + cached + sreclaimable;
+         publish_memory_snapshot(mem_total, free, free < mem_total ? mem_total - free : 0, now);
+         ok = true;
+      }
+   }
+#endif
+
+   __atomic_store_n(&g_mem_refreshing, 0, __ATOMIC_RELEASE);
+   return ok;
+}
+
+bool device_memory_status(uint64_t* total, uint64_t* free, uint64_t* used) {
+   MemorySnapshot snap;
+   if (!update_memory_cache() || !read_memory_snapshot(&snap)) {
       return false;
    }
+   if (total) *total = snap.total;
+   if (free) *free = snap.free;
+   if (used) *used = snap.used;
+   return true;
+}
+
+// Formatted time strings shared by all callers and rebuilt at most once per second.
+// The writer bumps seq to odd while updating; readers retry until they see a stable even seq.
+typedef struct {
+   int64_t sec;
+   char str[32];
+   size_t len;
+   unsigned int seq;
+   int busy;
+   size_t (*format)(time_t sec, char* out, size_t outlen);
+} TimeStringCache;
+
+static size_t format_system_time(time_t sec, char* out, size_t outlen) {
+   int ret = snprintf(out, outlen, "%ld.", (long)sec);
+   return ret < 0 || ret >= (int)outlen ? 0 : (size_t)ret;
+}
+
+static size_t format_local_time(time_t sec, char* out, size_t outlen) {
+   struct tm tm;
+   if (!localtime_r(&sec, &tm)) {
+      return 0;
+   }
+   return strftime(out, outlen, "%Y-%m-%dT%H:%M:%S", &tm);
+}
+
+static TimeStringCache g_system_time_cache = {.sec = -1, .format = format_system_time};
+static TimeStringCache g_local_time_cache = {.sec = -1, .format = format_local_time};
 
-   char line[256];
-   unsigned long mem_total = 0, mem_free = 0, buffers = 0, cached = 0, sreclaimable = 0;
-   while (fgets(line, sizeof(line), fp)) {
-      if (sscanf(line, "MemTotal: %lu kB", &mem_total) == 1 ||
-         sscanf(line, "MemFree: %lu kB", &mem_free) == 1 ||
-         sscanf(line, "Buffers: %lu kB", &buffers) == 1 ||
-         sscanf(line, "Cached: %lu kB", &cached) == 1 ||
-         sscanf(line, "SReclaimable: %lu kB", &sreclaimable) == 1) {
-         continue;
+static size_t cached_time_string(TimeStringCache* c, time_t sec, char* out, size_t outlen) {
+   unsigned int seq;
+   size_t len;
+   do {
+      seq = __atomic_load_n(&c->seq, __ATOMIC_ACQUIRE);
+      if ((seq & 1) || __atomic_load_n(&c->sec, __ATOMIC_RELAXED) != (int64_t)sec) {
+         len = 0;
+         break;
       }
+      len = __atomic_load_n(&c->len, __ATOMIC_RELAXED);
+      if (len >= outlen) len = 0;
+      memcpy(out, c->str, len);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while (seq != __atomic_load_n(&c->seq, __ATOMIC_RELAXED));
+   if (len > 0) {
+      out[len] = '\0';
+      return len;
+   }
+
+   // Stale: format locally and let one caller publish the result for the others
+   len = c->format(sec, out, outlen);
+   if (len == 0 || len >= sizeof(c->str) || __atomic_exchange_n(&c->busy, 1, __ATOMIC_ACQUIRE)) {
+      return len;
+   }
+   __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   memcpy(c->str, out, len);
+   __atomic_store_n(&c->len, len, __ATOMIC_RELAXED);
+   __atomic_store_n(&c->sec, (int64_t)sec, __ATOMIC_RELAXED);
+   __atomic_fetch_add(&c->seq, 1, __ATOMIC_RELEASE);
+   __atomic_store_n(&c->busy, 0, __ATOMIC_RELEASE);
+   return len;
+}
+
+// /etc/localtime was replaced: reload the zone and drop the cached local time string
+static void timezone_changed(void* ctx) {
+   (void)ctx;
+   tzset();
+   __atomic_store_n(&g_local_time_cache.sec, -1, __ATOMIC_RELEASE);
+}
+
+#ifndef __APPLE__
+// Hardware address of the primary interface, packed into one word so getters on any
+// thread read it without locking. Cleared by rtnetlink link notifications.
+#define IFACE_MAC_VALID (1ULL << 63)
+static uint64_t g_iface_mac = 0;
+static uint32_t g_iface_gen = 0;
+
+// First non-loopback interface with an IPv4 address that reports a hardware address
+static bool read_primary_mac(unsigned char mac[6]) {
+   int sock = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+   if (sock < 0) {
+      return false;
    }
-   fclose(fp);
 
-   if (mem_total == 0 || mem_free == 0) {
+   struct ifreq ifr;
+   struct ifconf ifc;
+   char buf[1024];
+   bool found = false;
+
+   ifc.ifc_len = sizeof(buf);
+   ifc.ifc_buf = buf;
+   if (ioctl(sock, SIOCGIFCONF, &ifc) < 0) {
+      close(sock);
       return false;
    }
-   g_mem_cache.total = mem_total;
-   g_mem_cache.free = mem_free + buffers + cached + sreclaimable;
-   g_mem_cache.used = mem_total - g_mem_cache.free;
-#endif
 
+   struct ifreq* it = ifc.ifc_req;
+   const struct ifreq* const end = it + (ifc.ifc_len / sizeof(struct ifreq));
+
+   for (; it != end && !found; ++it) {
+      memset(&ifr, 0, sizeof(ifr));
+      strncpy(ifr.ifr_name, it->ifr_name, IFNAMSIZ - 1);
+      if (ioctl(sock, SIOCGIFFLAGS, &ifr) != 0 || (ifr.ifr_flags & IFF_LOOPBACK)) continue;
+      if (ioctl(sock, SIOCGIFHWADDR, &ifr) == 0) {
+         memcpy(mac, ifr.ifr_hwaddr.sa_data, 6);
+         found = true;
+      }
+   }
+
+   close(sock);
+   return found;
+}
 
-   g_mem_cache.last_updated = now;
+static void iface_cache_invalidate(const struct nlmsghdr* nh, void* ctx) {
+   (void)nh; (void)ctx;
+   __atomic_fetch_add(&g_iface_gen, 1, __ATOMIC_ACQ_REL);
+   __atomic_store_n(&g_iface_mac, 0, __ATOMIC_RELEASE);
+}
+
+bool device_primary_mac(unsigned char mac[6]) {
+   uint64_t word = __atomic_load_n(&g_iface_mac, __ATOMIC_ACQUIRE);
+   if (word & IFACE_MAC_VALID) {
+      for (int i = 0; i < 6; i++) mac[i] = (unsigned char)(word >> (40 - 8 * i));
+      return true;
+   }
+
+   uint32_t gen = __atomic_load_n(&g_iface_gen, __ATOMIC_ACQUIRE);
+   if (!read_primary_mac(mac)) {
+      return false;
+   }
+
+   // Without the netlink listener nothing would invalidate the cache, so only keep it
+   // while notifications flow; drop it again if a link event raced with this read
+   if (netlink_monitor_active()) {
+      word = IFACE_MAC_VALID;
+      for (int i = 0; i < 6; i++) word |= (uint64_t)mac[i] << (40 - 8 * i);
+      __atomic_store_n(&g_iface_mac, word, __ATOMIC_RELEASE);
+      if (__atomic_load_n(&g_iface_gen, __ATOMIC_ACQUIRE) != gen) {
+         __atomic_store_n(&g_iface_mac, 0, __ATOMIC_RELEASE);
+      }
+   }
    return true;
 }
+#endif
 
-rbusError_t get_system_serial_number(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
-   (void)handle; (void)options;
-   rbusValue_t value;
-   rbusValue_Init(&value);
+void device_info_init(void) {
+   tzset();
+   file_watch_add("/etc/localtime", timezone_changed, NULL);
+#ifndef __APPLE__
+   netlink_add_listener(RTMGRP_LINK, iface_cache_invalidate, NULL);
+#endif
+}
+
+uint32_t device_interfaces_up(uint32_t* names_hash) {
+   // Count non-loopback interfaces that are administratively up with carrier, and
+   // fold their names into a hash so a swap of which interfaces are up is visible too.
+   uint32_t count = 0;
+   uint32_t h = 2166136261u;
+
+   struct if_nameindex* ifs = if_nameindex();
+   if (!ifs) {
+      if (names_hash) *names_hash = 0;
+      return 0;
+   }
 
+   int sock = socket(AF_INET, SOCK_DGRAM, 0);
+   if (sock >= 0) {
+      for (struct if_nameindex* it = ifs; it->if_index != 0 && it->if_name; it++) {
+         struct ifreq ifr;
+         memset(&ifr, 0, sizeof(ifr));
+         strncpy(ifr.ifr_name, it->if_name, IFNAMSIZ - 1);
+         if (ioctl(sock, SIOCGIFFLAGS, &ifr) != 0) continue;
+         if (ifr.ifr_flags & IFF_LOOPBACK) continue;
+         if (!(ifr.ifr_flags & IFF_UP) || !(ifr.ifr_flags & IFF_RUNNING)) continue;
+         count++;
+         for (const char* c = it->if_name; *c; c++) {
+            h ^= (uint8_t)*c;
+            h *= 16777619u;
+         }
+      }
+      close(sock);
+   }
+   if_freenameindex(ifs);
+
+   if (names_hash) *names_hash = h;
+   return count;
+}
+
+// Hardware serial number, or on Linux the primary interface MAC as a stand-in
+static bool read_serial_number(char* out, size_t outlen) {
 #ifdef __APPLE__
    io_service_t platformExpert = IOServiceGetMatchingService(kIOMainPortDefault,
       IOServiceMatching("IOPlatformExpertDevice"));
    if (!platformExpert) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+      return false;
    }
 
    CFStringRef serialNumber = IORegistryEntryCreateCFProperty(platformExpert,
@@ -101,95 +372,150 @@ rbusError_t get_system_serial_number(rbusHandle_t handle, rbusProperty_t propert
    IOObjectRelease(platformExpert);
 
    if (!serialNumber) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+      return false;
    }
 
-   CFIndex length = CFStringGetLength(serialNumber);
-   CFIndex maxSize = CFStringGetMaximumSizeForEncoding(length, kCFStringEncodingUTF8) + 1;
-
-   if (maxSize <= 0 || maxSize > 4096) { // 4096 is an arbitrary upper bound for safety
-      CFRelease(serialNumber);
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+   bool ok = CFStringGetCString(serialNumber, out, (CFIndex)outlen, kCFStringEncodingUTF8);
+   CFRelease(serialNumber);
+   return ok;
+#else
+   // On non-Apple platforms, use the MAC address of the first non-loopback interface as a fallback "serial number".
+   // This is not a true serial number, but serves as a unique identifier if no hardware serial is available.
+   unsigned char mac[6];
+   if (!device_primary_mac(mac)) {
+      return false;
    }
+   int ret = snprintf(out, outlen, "%02X%02X%02X%02X%02X%02X",
+      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+   return ret > 0 && ret < (int)outlen;
+#endif
+}
 
-   char* serial = (char*)malloc(maxSize);
-   if (!serial) {
-      CFRelease(serialNumber);
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
+// DeviceInfo values gathered together and shared by the getters and GetSystemInfo, so
+// values read within one refresh interval agree with each other. Published under a
+// sequence counter like the memory snapshot; one caller refreshes, the others keep
+// reading the previous copy.
+static const char* const g_ip_role_names[DEVICE_INFO_IP_ROLES] = {
+   "Device.DeviceInfo.X_COMCAST-COM_STB_IP",
+   "Device.DeviceInfo.X_COMCAST-COM_WAN_IP",
+   "Device.DeviceInfo.X_COMCAST-COM_CM_IP",
+};
+
+static DeviceInfoSnapshot g_info_snap = {0};
+static unsigned int g_info_seq = 0;
+static int g_info_refreshing = 0;
+
+static void read_info_snapshot(DeviceInfoSnapshot* out) {
+   unsigned int seq;
+   do {
+      seq = __atomic_load_n(&g_info_seq, __ATOMIC_ACQUIRE);
+      memcpy(out, &g_info_snap, sizeof(*out));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while ((seq & 1) || seq != __atomic_load_n(&g_info_seq, __ATOMIC_RELAXED));
+}
 
-   if (!CFStringGetCString(serialNumber, serial, maxSize, kCFStringEncodingUTF8)) {
-      free(serial);
-      CFRelease(serialNumber);
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
+static void gather_info_snapshot(DeviceInfoSnapshot* snap, const DeviceInfoSnapshot* prev, uint64_t now) {
+   memset(snap, 0, sizeof(*snap));
+   snap->taken_ms = now;
 
-   CFRelease(serialNumber);
-   rbusValue_SetString(value, serial);
-   free(serial);
+   struct timespec ts;
+   if (clock_gettime(CLOCK_REALTIME, &ts) == 0) {
+      snap->time_sec = ts.tv_sec;
+      snap->time_usec = (int32_t)(ts.tv_nsec / 1000);
+      snap->valid |= DEVICE_INFO_HAS_TIME;
+   }
+   if (device_uptime(&snap->uptime)) {
+      snap->valid |= DEVICE_INFO_HAS_UPTIME;
+   }
+   if (device_memory_status(&snap->mem_total, &snap->mem_free, &snap->mem_used)) {
+      snap->valid |= DEVICE_INFO_HAS_MEMORY;
+   }
 
+#ifdef __APPLE__
+   // The platform serial never changes, so the IOKit lookup runs once
+   if (prev && (prev->valid & DEVICE_INFO_HAS_SERIAL)) {
+      memcpy(snap->serial, prev->serial, sizeof(snap->serial));
+      snap->valid |= DEVICE_INFO_HAS_SERIAL;
+   } else if (read_serial_number(snap->serial, sizeof(snap->serial))) {
+      snap->valid |= DEVICE_INFO_HAS_SERIAL;
+   }
 #else
-   // On non-Apple platforms, use the MAC address of the first non-loopback interface as a fallback "serial number".
-   // This is not a true serial number, but serves as a unique identifier if no hardware serial is available.
-   int sock = socket(AF_INET, SOCK_DGRAM, 0);
-   if (sock < 0) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+   // The MAC behind the fallback serial is itself cached until a link notification
+   (void)prev;
+   if (read_serial_number(snap->serial, sizeof(snap->serial))) {
+      snap->valid |= DEVICE_INFO_HAS_SERIAL;
    }
+#endif
 
-   struct ifreq ifr;
-   struct ifconf ifc;
-   char buf[1024];
-   char mac_str[18] = {0};
-   bool found = false;
+   for (int i = 0; i < DEVICE_INFO_IP_ROLES; i++) {
+      if (ip_cache_get(g_ip_role_names[i], snap->ip[i], sizeof(snap->ip[i]))) {
+         snap->valid |= DEVICE_INFO_HAS_IP(i);
+      }
+   }
+}
 
-   ifc.ifc_len = sizeof(buf);
-   ifc.ifc_buf = buf;
-   if (ioctl(sock, SIOCGIFCONF, &ifc) < 0) {
-      close(sock);
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+void device_info_snapshot(DeviceInfoSnapshot* out) {
+   uint64_t now = monotonic_ms();
+   uint64_t ttl = DEVICE_INFO_SNAPSHOT_MS;
+   uint64_t mem_ttl = __atomic_load_n(&g_mem_refresh_ms, __ATOMIC_RELAXED);
+   if (mem_ttl < ttl) ttl = mem_ttl; // MemoryRefreshInterval 0 still means a fresh read per get
+
+   uint64_t last = __atomic_load_n(&g_info_snap.taken_ms, __ATOMIC_RELAXED);
+   if (last != 0 && now - last < ttl) {
+      read_info_snapshot(out);
+      return;
+   }
+   if (__atomic_exchange_n(&g_info_refreshing, 1, __ATOMIC_ACQUIRE)) {
+      if (last != 0) {
+         read_info_snapshot(out);
+      } else {
+         gather_info_snapshot(out, NULL, now);
+      }
+      return;
    }
 
-   struct ifreq* it = ifc.ifc_req;
-   const struct ifreq* const end = it + (ifc.ifc_len / sizeof(struct ifreq));
+   DeviceInfoSnapshot prev;
+   read_info_snapshot(&prev);
+   gather_info_snapshot(out, &prev, now);
 
-   for (; it != end; ++it) {
-      strcpy(ifr.ifr_name, it->ifr_name);
-      if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0) {
-         // Skip loopback interfaces
-         if (!(ifr.ifr_flags & IFF_LOOPBACK)) {
-            if (ioctl(sock, SIOCGIFHWADDR, &ifr) == 0) {
-               unsigned char* mac = (unsigned char*)ifr.ifr_hwaddr.sa_data;
-               int ret = snprintf(mac_str, sizeof(mac_str),
-                  "%02X%02X%02X%02X%02X%02X",
-                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-               if (ret < 0 || ret >= (int)sizeof(mac_str)) {
-                  close(sock);
-                  rbusValue_Release(value);
-                  return RBUS_ERROR_BUS_ERROR;
-               }
-               found = true;
-               break;
-            }
-         }
-      }
+   __atomic_fetch_add(&g_info_seq, 1, __ATOMIC_RELAXED);
+   __atomic_thread_fence(__ATOMIC_RELEASE);
+   memcpy(&g_info_snap, out, sizeof(*out));
+   __atomic_fetch_add(&g_info_seq, 1, __ATOMIC_RELEASE);
+   __atomic_store_n(&g_info_refreshing, 0, __ATOMIC_RELEASE);
+}
+
+// "<seconds>.<microseconds>" of the snapshot's wall clock reading
+size_t device_info_system_time(const DeviceInfoSnapshot* snap, char* out, size_t outlen) {
+   if (!(snap->valid & DEVICE_INFO_HAS_TIME)) {
+      return 0;
    }
+   // "<seconds>." is cached per second; only the microseconds are formatted per call
+   size_t len = cached_time_string(&g_system_time_cache, (time_t)snap->time_sec, out, outlen);
+   if (len == 0 || len + 7 > outlen) {
+      return 0;
+   }
+   long usec = snap->time_usec;
+   for (int i = 5; i >= 0; i--) {
+      out[len + i] = (char)('0' + usec % 10);
+      usec /= 10;
+   }
+   out[len + 6] = '\0';
+   return len + 6;
+}
 
-   close(sock);
+rbusError_t get_system_serial_number(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
 
-   if (!found) {
-      rbusValue_Release(value);
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
+   if (!(snap.valid & DEVICE_INFO_HAS_SERIAL)) {
       return RBUS_ERROR_BUS_ERROR;
    }
 
-   rbusValue_SetString(value, mac_str);
-#endif
-
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   rbusValue_SetString(value, snap.serial);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
 
@@ -198,22 +524,16 @@ rbusError_t get_system_serial_number(rbusHandle_t handle, rbusProperty_t propert
 
 rbusError_t get_system_time(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
    (void)handle; (void)options;
-   rbusValue_t value;
-   rbusValue_Init(&value);
-
-   struct timeval tv;
-   if (gettimeofday(&tv, NULL) != 0) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
 
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
    char time_str[32];
-   int ret = snprintf(time_str, sizeof(time_str), "%ld.%06ld", (long)tv.tv_sec, (long)tv.tv_usec);
-   if (ret < 0 || ret >= (int)sizeof(time_str)) {
-      rbusValue_Release(value);
+   if (device_info_system_time(&snap, time_str, sizeof(time_str)) == 0) {
       return RBUS_ERROR_BUS_ERROR;
    }
 
+   rbusValue_t value;
+   rbusValue_Init(&value);
    rbusValue_SetString(value, time_str);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
@@ -221,49 +541,45 @@ rbusError_t get_system_time(rbusHandle_t handle, rbusProperty_t property, rbusGe
    return RBUS_ERROR_SUCCESS;
 }
 
-rbusError_t get_system_uptime(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
-   (void)handle; (void)options;
-   rbusValue_t value;
-   rbusValue_Init(&value);
-
+bool device_uptime(uint32_t* uptime_seconds) {
 #ifdef __APPLE__
    int mib[2] = {CTL_KERN, KERN_BOOTTIME};
    struct timeval boottime;
    size_t size = sizeof(boottime);
 
    if (sysctl(mib, 2, &boottime, &size, NULL, 0) == -1) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+      return false;
    }
 
    struct timeval now;
    if (gettimeofday(&now, NULL) != 0) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+      return false;
    }
 
-   uint32_t uptime_seconds = (now.tv_sec - boottime.tv_sec);
+   *uptime_seconds = (now.tv_sec - boottime.tv_sec);
 #else
-   FILE* fp = fopen("/proc/uptime", "r");
-   if (!fp) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+   // CLOCK_BOOTTIME counts time spent suspended, like /proc/uptime, and is served from the vDSO
+   struct timespec ts;
+   if (clock_gettime(CLOCK_BOOTTIME, &ts) != 0) {
+      return false;
    }
+   *uptime_seconds = (uint32_t)ts.tv_sec;
+#endif
+   return true;
+}
 
-   uint32_t uptime_seconds;
+rbusError_t get_system_uptime(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
 
-   // Read the first value from /proc/uptime (seconds since boot)
-   if (fscanf(fp, "%u", &uptime_seconds) != 1) {
-      fclose(fp);
-      rbusValue_Release(value);
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
+   if (!(snap.valid & DEVICE_INFO_HAS_UPTIME)) {
       return RBUS_ERROR_BUS_ERROR;
    }
 
-   fclose(fp);
-#endif
-
-   // Set the rbus value to the formatted uptime string
-   rbusValue_SetUInt32(value, uptime_seconds);
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   rbusValue_SetUInt32(value, snap.uptime);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
 
@@ -340,57 +656,14 @@ rbusError_t get_mac_address(rbusHandle_t handle, rbusProperty_t property, rbusGe
       return RBUS_ERROR_BUS_ERROR;
    }
 #else
-   int sock = socket(AF_INET, SOCK_DGRAM, 0);
-   if (sock < 0) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
-
-   struct ifreq ifr;
-   struct ifconf ifc;
-   char buf[1024];
+   unsigned char mac[6];
    char mac_str[18] = {0};
-   bool found = false;
-
-   ifc.ifc_len = sizeof(buf);
-   ifc.ifc_buf = buf;
-   if (ioctl(sock, SIOCGIFCONF, &ifc) < 0) {
-      close(sock);
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
-
-   struct ifreq* it = ifc.ifc_req;
-   const struct ifreq* const end = it + (ifc.ifc_len / sizeof(struct ifreq));
-
-   for (; it != end; ++it) {
-      strcpy(ifr.ifr_name, it->ifr_name);
-      if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0) {
-         // Skip loopback interfaces
-         if (!(ifr.ifr_flags & IFF_LOOPBACK)) {
-            if (ioctl(sock, SIOCGIFHWADDR, &ifr) == 0) {
-               unsigned char* mac = (unsigned char*)ifr.ifr_hwaddr.sa_data;
-               int ret = snprintf(mac_str, sizeof(mac_str),
-                  "%02x:%02x:%02x:%02x:%02x:%02x",
-                  mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
-               if (ret < 0 || ret >= (int)sizeof(mac_str)) {
-                  close(sock);
-                  rbusValue_Release(value);
-                  return RBUS_ERROR_BUS_ERROR;
-               }
-               found = true;
-               break;
-            }
-         }
-      }
-   }
-
-   close(sock);
-
-   if (!found) {
+   if (!device_primary_mac(mac)) {
       rbusValue_Release(value);
       return RBUS_ERROR_BUS_ERROR;
    }
+   snprintf(mac_str, sizeof(mac_str), "%02x:%02x:%02x:%02x:%02x:%02x",
+      mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
 #endif
 
    rbusValue_SetString(value, mac_str);
@@ -405,12 +678,14 @@ rbusError_t get_memory_free(rbusHandle_t handle, rbusProperty_t property, rbusGe
    rbusValue_t value;
    rbusValue_Init(&value);
 
-   if (!update_memory_cache()) {
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
+   if (!(snap.valid & DEVICE_INFO_HAS_MEMORY)) {
       rbusValue_Release(value);
       return RBUS_ERROR_BUS_ERROR;
    }
 
-   rbusValue_SetUInt32(value, (unsigned int)g_mem_cache.free);
+   rbusValue_SetUInt32(value, (unsigned int)snap.mem_free);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
    return RBUS_ERROR_SUCCESS;
@@ -421,12 +696,14 @@ rbusError_t get_memory_used(rbusHandle_t handle, rbusProperty_t property, rbusGe
    rbusValue_t value;
    rbusValue_Init(&value);
 
-   if (!update_memory_cache()) {
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
+   if (!(snap.valid & DEVICE_INFO_HAS_MEMORY)) {
       rbusValue_Release(value);
       return RBUS_ERROR_BUS_ERROR;
    }
 
-   rbusValue_SetUInt32(value, (unsigned int)g_mem_cache.used);
+   rbusValue_SetUInt32(value, (unsigned int)snap.mem_used);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
 
@@ -438,45 +715,56 @@ rbusError_t get_memory_total(rbusHandle_t handle, rbusProperty_t property, rbusG
    rbusValue_t value;
    rbusValue_Init(&value);
 
-   if (!update_memory_cache()) {
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
+   if (!(snap.valid & DEVICE_INFO_HAS_MEMORY)) {
       rbusValue_Release(value);
       return RBUS_ERROR_BUS_ERROR;
    }
 
-   rbusValue_SetUInt32(value, (unsigned int)g_mem_cache.total);
+   rbusValue_SetUInt32(value, (unsigned int)snap.mem_total);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
 
    return RBUS_ERROR_SUCCESS;
 }
 
-rbusError_t get_local_time(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+rbusError_t get_memory_refresh_interval(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
    (void)handle; (void)options;
    rbusValue_t value;
    rbusValue_Init(&value);
+   rbusValue_SetUInt32(value, __atomic_load_n(&g_mem_refresh_ms, __ATOMIC_RELAXED));
+   rbusProperty_SetValue(property, value);
+   rbusValue_Release(value);
+   return RBUS_ERROR_SUCCESS;
+}
 
-   // Get current time
-   time_t rawtime;
-   if (time(&rawtime) == (time_t)-1) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
+rbusError_t set_memory_refresh_interval(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+   rbusValue_t value = rbusProperty_GetValue(property);
+   if (!value || rbusValue_GetType(value) != RBUS_UINT32) {
+      return set_session_end(handle, options, RBUS_ERROR_INVALID_INPUT);
    }
+   // 0 reads /proc/meminfo on every get
+   __atomic_store_n(&g_mem_refresh_ms, rbusValue_GetUInt32(value), __ATOMIC_RELAXED);
+   return set_session_end(handle, options, RBUS_ERROR_SUCCESS);
+}
 
-   // Convert to local time
-   struct tm time_struct;
-   struct tm* timeinfo = localtime_r(&rawtime, &time_struct);
-   if (!timeinfo) {
-      rbusValue_Release(value);
+rbusError_t get_local_time(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+
+   struct timespec ts;
+   if (clock_gettime(CLOCK_REALTIME, &ts) != 0) {
       return RBUS_ERROR_BUS_ERROR;
    }
 
-   // Format time as YYYY-MM-DDThh:mm:ss (e.g., 2024-02-07T23:52:32)
-   char time_str[20];
-   if (strftime(time_str, sizeof(time_str), "%Y-%m-%dT%H:%M:%S", timeinfo) == 0) {
-      rbusValue_Release(value);
+   // Formatted as YYYY-MM-DDThh:mm:ss (e.g., 2024-02-07T23:52:32), once per second
+   char time_str[32];
+   if (cached_time_string(&g_local_time_cache, ts.tv_sec, time_str, sizeof(time_str)) == 0) {
       return RBUS_ERROR_BUS_ERROR;
    }
 
+   rbusValue_t value;
+   rbusValue_Init(&value);
    rbusValue_SetString(value, time_str);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
@@ -555,56 +843,12 @@ rbusError_t get_manufacturer_oui(rbusHandle_t handle, rbusProperty_t property, r
       return RBUS_ERROR_BUS_ERROR;
    }
 #else
-   int sock = socket(AF_INET, SOCK_DGRAM, 0);
-   if (sock < 0) {
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
-
-   struct ifreq ifr;
-   struct ifconf ifc;
-   char buf[1024];
-   bool found = false;
-
-   ifc.ifc_len = sizeof(buf);
-   ifc.ifc_buf = buf;
-   if (ioctl(sock, SIOCGIFCONF, &ifc) < 0) {
-      close(sock);
-      rbusValue_Release(value);
-      return RBUS_ERROR_BUS_ERROR;
-   }
-
-   struct ifreq* it = ifc.ifc_req;
-   const struct ifreq* const end = it + (ifc.ifc_len / sizeof(struct ifreq));
-
-   for (; it != end; ++it) {
-      strcpy(ifr.ifr_name, it->ifr_name);
-      if (ioctl(sock, SIOCGIFFLAGS, &ifr) == 0) {
-         // Skip loopback interfaces
-         if (!(ifr.ifr_flags & IFF_LOOPBACK)) {
-            if (ioctl(sock, SIOCGIFHWADDR, &ifr) == 0) {
-               unsigned char* mac = (unsigned char*)ifr.ifr_hwaddr.sa_data;
-               int ret = snprintf(oui_str, sizeof(oui_str),
-                  "%02X%02X%02X",
-                  mac[0], mac[1], mac[2]);
-               if (ret < 0 || ret >= (int)sizeof(oui_str)) {
-                  close(sock);
-                  rbusValue_Release(value);
-                  return RBUS_ERROR_BUS_ERROR;
-               }
-               found = true;
-               break;
-            }
-         }
-      }
-   }
-
-   close(sock);
-
-   if (!found) {
+   unsigned char mac[6];
+   if (!device_primary_mac(mac)) {
       rbusValue_Release(value);
       return RBUS_ERROR_BUS_ERROR;
    }
+   snprintf(oui_str, sizeof(oui_str), "%02X%02X%02X", mac[0], mac[1], mac[2]);
 #endif
 
    rbusValue_SetString(value, oui_str);
@@ -617,64 +861,24 @@ rbusError_t get_manufacturer_oui(rbusHandle_t handle, rbusProperty_t property, r
 rbusError_t get_first_ip(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
    (void)handle; (void)options;
 
-   rbusValue_t value;
-   rbusValue_Init(&value);
-   char ip_str[18] = {0};
-
-   struct ifaddrs* ifas = NULL, * ifa = NULL;
-   int fam_order[2] = {AF_INET, AF_INET6};
-   fam_order[0] = AF_INET; fam_order[1] = AF_UNSPEC;
-
-   if (getifaddrs(&ifas) != 0)
-      return RBUS_ERROR_BUS_ERROR;
-
-   int rc = -1;
-   for (int pass = 0; pass < 2 && rc != 0; ++pass) {
-      int want = fam_order[pass];
-      if (want == AF_UNSPEC) break;
-
-      for (ifa = ifas; ifa != NULL; ifa = ifa->ifa_next) {
-         if (!ifa->ifa_addr) continue;
-
-         // Skip interfaces that are down or are loopback.
-         unsigned int flags = ifa->ifa_flags;
-         if (!(flags & IFF_UP)) continue;
-         if (flags & IFF_LOOPBACK) continue;
-
-         int fam = ifa->ifa_addr->sa_family;
-         if (fam != want) continue;
-
-         // Convert to numeric string.
-         char host[NI_MAXHOST];
-         if (getnameinfo(ifa->ifa_addr,
-            (fam == AF_INET) ? sizeof(struct sockaddr_in)
-            : sizeof(struct sockaddr_in6),
-            host, sizeof(host),
-            NULL, 0, NI_NUMERICHOST) != 0) {
-            continue;
-         }
-
-         // Extra paranoia: exclude 127.0.0.0/8 and ::1 if they sneak through.
-         if (fam == AF_INET) {
-            struct sockaddr_in* sin = (struct sockaddr_in*)ifa->ifa_addr;
-            uint32_t addr = ntohl(sin->sin_addr.s_addr);
-            if ((addr >> 24) == 127) continue; // 127.x.x.x
-         } else if (fam == AF_INET6) {
-            struct sockaddr_in6* sin6 = (struct sockaddr_in6*)ifa->ifa_addr;
-            static const struct in6_addr loop6 = IN6ADDR_LOOPBACK_INIT;
-            if (memcmp(&sin6->sin6_addr, &loop6, sizeof(loop6)) == 0) continue;
-         }
-
-         // Success.
-         strncpy(ip_str, host, sizeof(ip_str));
-         ip_str[sizeof(ip_str) - 1] = '\0';
-         rc = 0;
-         break;
+   // Address selection and refresh live in ip_cache.c; the snapshot holds a copy
+   const char* name = rbusProperty_GetName(property);
+   char ip_str[INET6_ADDRSTRLEN] = {0};
+   int role = 0;
+   while (role < DEVICE_INFO_IP_ROLES && strcmp(g_ip_role_names[role], name) != 0) role++;
+   if (role < DEVICE_INFO_IP_ROLES) {
+      DeviceInfoSnapshot snap;
+      device_info_snapshot(&snap);
+      if (!(snap.valid & DEVICE_INFO_HAS_IP(role))) {
+         return RBUS_ERROR_BUS_ERROR;
       }
+      memcpy(ip_str, snap.ip[role], sizeof(ip_str));
+   } else if (!ip_cache_get(name, ip_str, sizeof(ip_str))) {
+      return RBUS_ERROR_BUS_ERROR;
    }
 
-   freeifaddrs(ifas);
-
+   rbusValue_t value;
+   rbusValue_Init(&value);
    rbusValue_SetString(value, ip_str);
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
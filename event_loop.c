@@ -0,0 +1,102 @@
+#include "rbus_elements.h"
+#include <poll.h>
+
+typedef struct {
+   unsigned int interval_ms;
+   uint64_t next_due;
+   EventLoopTimerCb cb;
+   void* ctx;
+} EventLoopTimer;
+
+typedef struct {
+   int fd;
+   EventLoopFdCb cb;
+   void* ctx;
+} EventLoopFd;
+
+static EventLoopTimer g_timers[MAX_EVENT_LOOP_TIMERS];
+static int g_num_timers = 0;
+static EventLoopFd g_fds[MAX_EVENT_LOOP_FDS];
+static int g_num_fds = 0;
+
+static uint64_t now_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+int event_loop_add_timer(unsigned int interval_ms, EventLoopTimerCb cb, void* ctx) {
+   if (!cb || interval_ms == 0 || g_num_timers >= MAX_EVENT_LOOP_TIMERS) {
+      return -1;
+   }
+   EventLoopTimer* t = &g_timers[g_num_timers];
+   t->interval_ms = interval_ms;
+   t->next_due = now_ms() + interval_ms;
+   t->cb = cb;
+   t->ctx = ctx;
+   return g_num_timers++;
+}
+
+int event_loop_add_fd(int fd, EventLoopFdCb cb, void* ctx) {
+   if (fd < 0 || !cb || g_num_fds >= MAX_EVENT_LOOP_FDS) {
+      return -1;
+   }
+   g_fds[g_num_fds].fd = fd;
+   g_fds[g_num_fds].cb = cb;
+   g_fds[g_num_fds].ctx = ctx;
+   return g_num_fds++;
+}
+
+void event_loop_remove_fd(int fd) {
+   for (int i = 0; i < g_num_fds; i++) {
+      if (g_fds[i].fd == fd) {
+         g_fds[i] = g_fds[--g_num_fds];
+         return;
+      }
+   }
+}
+
+void event_loop_run(volatile sig_atomic_t* running) {
+   while (*running) {
+      uint64_t now = now_ms();
+
+      // Cap the wait so a signal delivered to another thread is still noticed promptly
+      uint64_t wait = EVENT_LOOP_MAX_WAIT_MS;
+      for (int i = 0; i < g_num_timers; i++) {
+         uint64_t left = g_timers[i].next_due > now ? g_timers[i].next_due - now : 0;
+         if (left < wait) wait = left;
+      }
+
+      struct pollfd pfds[MAX_EVENT_LOOP_FDS];
+      int nfds = g_num_fds;
+      for (int i = 0; i < nfds; i++) {
+         pfds[i].fd = g_fds[i].fd;
+         pfds[i].events = POLLIN;
+         pfds[i].revents = 0;
+      }
+
+      if (wait > 0 || nfds > 0) {
+         int ready = poll(nfds ? pfds : NULL, (nfds_t)nfds, (int)wait);
+         // Callbacks may remove watches, so match on the fd rather than the slot
+         for (int i = 0; ready > 0 && i < nfds && *running; i++) {
+            if (!pfds[i].revents) continue;
+            for (int j = 0; j < g_num_fds; j++) {
+               if (g_fds[j].fd == pfds[i].fd) {
+                  g_fds[j].cb(g_fds[j].fd, g_fds[j].ctx);
+                  break;
+               }
+            }
+         }
+      }
+
+      now = now_ms();
+      for (int i = 0; i < g_num_timers && *running; i++) {
+         EventLoopTimer* t = &g_timers[i];
+         if (t->next_due > now) continue;
+         t->cb(t->ctx);
+         // Skip missed periods instead of firing a burst after a stall
+         t->next_due += t->interval_ms;
+         if (t->next_due <= now) t->next_due = now + t->interval_ms;
+      }
+   }
+}
@@ -0,0 +1,110 @@
+#include "rbus_elements.h"
+
+#ifdef __APPLE__
+int file_watch_add(const char* path, FileWatchCb cb, void* ctx) {
+   (void)path; (void)cb; (void)ctx;
+   return -1;
+}
+
+void file_watch_cleanup(void) {
+}
+#else
+#include <sys/inotify.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <libgen.h>
+
+// Watches are placed on the parent directory and matched by file name so a file
+// replaced by rename or re-created (the usual way config files and /etc/localtime
+// are updated) keeps being reported.
+typedef struct {
+   int wd;
+   char name[MAX_NAME_LEN];
+   FileWatchCb cb;
+   void* ctx;
+} FileWatch;
+
+static FileWatch g_watches[MAX_FILE_WATCHES];
+static int g_num_watches = 0;
+static int g_inotify_fd = -1;
+
+static void file_watch_readable(int fd, void* ctx) {
+   (void)ctx;
+   char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+   for (;;) {
+      ssize_t len = read(fd, buf, sizeof(buf));
+      if (len < 0 && errno == EINTR) continue;
+      if (len <= 0) return;
+
+      for (char* p = buf; p < buf + len;) {
+         const struct inotify_event* ev = (const struct inotify_event*)p;
+         p += sizeof(struct inotify_event) + ev->len;
+
+         for (int i = 0; i < g_num_watches; i++) {
+            FileWatch* w = &g_watches[i];
+            // Queue overflow loses events, so every watcher has to assume a change
+            if ((ev->mask & IN_Q_OVERFLOW) || (ev->wd == w->wd && ev->len && strcmp(ev->name, w->name) == 0)) {
+               w->cb(w->ctx);
+            }
+         }
+      }
+   }
+}
+
+int file_watch_add(const char* path, FileWatchCb cb, void* ctx) {
+   if (!path || !cb || g_num_watches >= MAX_FILE_WATCHES) {
+      return -1;
+   }
+
+   char dir_buf[MAX_NAME_LEN], name_buf[MAX_NAME_LEN];
+   snprintf(dir_buf, sizeof(dir_buf), "%s", path);
+   snprintf(name_buf, sizeof(name_buf), "%s", path);
+   const char* dir = dirname(dir_buf);
+   const char* name = basename(name_buf);
+
+   // procfs and sysfs generate content on read and never report it changing, so a
+   // watch there would silently stop updates; callers fall back to polling
+   struct statfs fs;
+   if (statfs(dir, &fs) == 0 && (fs.f_type == PROC_SUPER_MAGIC || fs.f_type == SYSFS_MAGIC)) {
+      fprintf(stderr, "Cannot watch %s: procfs and sysfs do not report changes\n", path);
+      return -1;
+   }
+
+   if (g_inotify_fd < 0) {
+      g_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+      if (g_inotify_fd < 0) {
+         fprintf(stderr, "Failed to initialize inotify: %s\n", strerror(errno));
+         return -1;
+      }
+      if (event_loop_add_fd(g_inotify_fd, file_watch_readable, NULL) < 0) {
+         fprintf(stderr, "Failed to watch inotify descriptor\n");
+         close(g_inotify_fd);
+         g_inotify_fd = -1;
+         return -1;
+      }
+   }
+
+   int wd = inotify_add_watch(g_inotify_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_ATTRIB);
+   if (wd < 0) {
+      fprintf(stderr, "Failed to watch %s: %s\n", dir, strerror(errno));
+      return -1;
+   }
+
+   FileWatch* w = &g_watches[g_num_watches];
+   w->wd = wd;
+   snprintf(w->name, sizeof(w->name), "%s", name);
+   w->cb = cb;
+   w->ctx = ctx;
+   return g_num_watches++;
+}
+
+void file_watch_cleanup(void) {
+   if (g_inotify_fd >= 0) {
+      event_loop_remove_fd(g_inotify_fd);
+      close(g_inotify_fd);
+      g_inotify_fd = -1;
+   }
+   g_num_watches = 0;
+}
+#endif
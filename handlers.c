@@ -1,4 +1,5 @@
 #include "rbus_elements.h"
+#include <pthread.h>
 
 extern int g_totalElements;
 extern DataElement* g_internalDataElements;
@@ -6,6 +7,30 @@ extern int g_num_tables;
 extern TableDef* g_tables;
 extern rbusHandle_t g_rbusHandle;
 
+// Guards the element values, the tables and the alarm and history state attached to
+// them. Every rbus handler that reads or changes the model and every event loop
+// callback that updates it holds this. Recursive because providers add and remove
+// their rows through the same table handlers rbus calls.
+static pthread_mutex_t g_model_lock;
+static pthread_once_t g_model_lock_once = PTHREAD_ONCE_INIT;
+
+static void model_lock_init(void) {
+   pthread_mutexattr_t attr;
+   pthread_mutexattr_init(&attr);
+   pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+   pthread_mutex_init(&g_model_lock, &attr);
+   pthread_mutexattr_destroy(&attr);
+}
+
+void model_lock(void) {
+   pthread_once(&g_model_lock_once, model_lock_init);
+   pthread_mutex_lock(&g_model_lock);
+}
+
+void model_unlock(void) {
+   pthread_mutex_unlock(&g_model_lock);
+}
+
 char* get_table_name(const char* name, uint32_t* instance, char** property_name) {
    char* dup = strdup(name);
    if (!dup) return NULL;
@@ -87,6 +112,326 @@ char* get_table_name(const char* name, uint32_t* instance, char** property_name)
    return table;
 }
 
+TableDef* find_table(const char* name) {
+   for (int i = 0; i < g_num_tables; i++) {
+      if (strcmp(g_tables[i].name, name) == 0) {
+         return &g_tables[i];
+      }
+   }
+   return NULL;
+}
+
+TableDef* create_table(const char* name) {
+   TableDef* tables = realloc(g_tables, (g_num_tables + 1) * sizeof(TableDef));
+   if (!tables) {
+      return NULL;
+   }
+   g_tables = tables;
+   TableDef* table = &g_tables[g_num_tables++];
+   strncpy(table->name, name, MAX_NAME_LEN - 1);
+   table->name[MAX_NAME_LEN - 1] = '\0';
+   table->rows = NULL;
+   table->num_rows = 0;
+   table->next_inst = 1;
+   table->num_inst = 0;
+   return table;
+}
+
+TableRow* find_row(TableDef* table, uint32_t instNum) {
+   if (!table) return NULL;
+   // Rows are appended in instance order, unless a restore put an old instance back
+   int lo = 0, hi = table->num_rows - 1;
+   while (lo <= hi) {
+      int mid = lo + (hi - lo) / 2;
+      uint32_t inst = table->rows[mid].instNum;
+      if (inst == instNum) {
+         return &table->rows[mid];
+      }
+      if (inst < instNum) lo = mid + 1; else hi = mid - 1;
+   }
+   for (int i = 0; i < table->num_rows; i++) {
+      if (table->rows[i].instNum == instNum) {
+         return &table->rows[i];
+      }
+   }
+   return NULL;
+}
+
+// Rows of tables whose add row handler is table_add_row can be added by consumers;
+// the internal tables (alarms, processes) are filled by their providers
+bool table_is_writable(const char* tableName) {
+   char* wild = create_wildcard(tableName);
+   if (!wild) return false;
+   char name[MAX_NAME_LEN * 2];
+   snprintf(name, sizeof(name), "%s{i}.", wild);
+   free(wild);
+   DataElement* de = lookup_element(name);
+   return de && de->tableAddRowHandler == table_add_row;
+}
+
+RowProperty* row_property(TableRow* row, const char* prop, ValueType type) {
+   for (RowProperty* p = row->props; p; p = p->next) {
+      if (strcmp(p->name, prop) == 0) {
+         return p;
+      }
+   }
+
+   RowProperty* p = (RowProperty*)calloc(1, sizeof(RowProperty));
+   if (!p) {
+      return NULL;
+   }
+   strncpy(p->name, prop, MAX_NAME_LEN - 1);
+   p->name[MAX_NAME_LEN - 1] = '\0';
+   p->type = type;
+   memset(&p->value, 0, sizeof(p->value));
+   if (IS_STRING_TYPE(type)) {
+      p->value.strVal = strdup("");
+      if (!p->value.strVal) {
+         free(p);
+         return NULL;
+      }
+   }
+   p->next = row->props;
+   row->props = p;
+   return p;
+}
+
+void value_to_rbus(rbusValue_t value, ValueType type, const ElementValue* v) {
+   switch (type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64:
+         rbusValue_SetString(value, v->strVal);
+         break;
+      case TYPE_INT:
+         rbusValue_SetInt32(value, v->intVal);
+         break;
+      case TYPE_UINT:
+         rbusValue_SetUInt32(value, v->uintVal);
+         break;
+      case TYPE_BOOL:
+         rbusValue_SetBoolean(value, v->boolVal);
+         break;
+      case TYPE_LONG:
+         rbusValue_SetInt64(value, v->longVal);
+         break;
+      case TYPE_ULONG:
+         rbusValue_SetUInt64(value, v->ulongVal);
+         break;
+      case TYPE_FLOAT:
+         rbusValue_SetSingle(value, v->floatVal);
+         break;
+      case TYPE_DOUBLE:
+         rbusValue_SetDouble(value, v->doubleVal);
+         break;
+      case TYPE_BYTE:
+         rbusValue_SetByte(value, v->byteVal);
+         break;
+   }
+}
+
+static bool path_matches(const char* path, size_t path_len, bool partial, const char* name) {
+   return partial ? strncmp(name, path, path_len) == 0 : strcmp(name, path) == 0;
+}
+
+void model_walk(const char* path, ModelVisitor visit, void* ctx) {
+   size_t path_len = strlen(path);
+   bool partial = path_len > 0 && path[path_len - 1] == '.';
+   ModelEntry entry;
+
+   // Plain properties: stored values, or live ones served by their own getter
+   for (int i = 0; i < g_totalElements; i++) {
+      DataElement* de = &g_internalDataElements[i];
+      if (de->elementType != RBUS_ELEMENT_TYPE_PROPERTY || strstr(de->name, "{i}")) continue;
+      if (!path_matches(path, path_len, partial, de->name)) continue;
+      entry.name = de->name;
+      entry.type = de->type;
+      entry.live = de->getHandler && de->getHandler != getHandler;
+      entry.value = entry.live ? NULL : &de->value;
+      entry.getter = entry.live ? de->getHandler : NULL;
+      entry.version = de->version;
+      visit(&entry, ctx);
+      if (!partial) return;
+   }
+
+   // Row properties
+   char name[MAX_NAME_LEN * 2];
+   for (int t = 0; t < g_num_tables; t++) {
+      TableDef* table = &g_tables[t];
+      size_t tlen = strlen(table->name);
+      // Skip tables that can neither contain nor be contained by the path
+      if (strncmp(table->name, path, tlen < path_len ? tlen : path_len) != 0) continue;
+      bool provider = !table_is_writable(table->name);
+      for (int r = 0; r < table->num_rows; r++) {
+         TableRow* row = &table->rows[r];
+         int rlen = snprintf(name, sizeof(name), "%s%u.", table->name, row->instNum);
+         if (strncmp(name, path, (size_t)rlen < path_len ? (size_t)rlen : path_len) != 0) continue;
+         for (RowProperty* p = row->props; p; p = p->next) {
+            snprintf(name + rlen, sizeof(name) - rlen, "%s", p->name);
+            if (!path_matches(path, path_len, partial, name)) continue;
+            entry.name = name;
+            entry.type = p->type;
+            entry.live = provider;
+            entry.value = &p->value;
+            entry.getter = NULL;
+            entry.version = p->version;
+            visit(&entry, ctx);
+            if (!partial) return;
+         }
+      }
+   }
+}
+
+// Resolve a full row property name (Table.{inst}.Prop) through the table and row lookups
+static RowProperty* lookup_row_property(const char* path, char* table_name, uint32_t* instNum) {
+   const char* prop = strrchr(path, '.');
+   if (!prop || prop == path) return NULL;
+   const char* inst = prop - 1;
+   while (inst > path && *inst != '.') inst--;
+   if (*inst != '.' || (size_t)(inst - path + 1) >= MAX_NAME_LEN) return NULL;
+
+   char* end = NULL;
+   unsigned long n = strtoul(inst + 1, &end, 10);
+   if (end != prop || end == inst + 1) return NULL;
+
+   memcpy(table_name, path, inst - path + 1);
+   table_name[inst - path + 1] = '\0';
+   TableDef* table = find_table(table_name);
+   TableRow* row = table ? find_row(table, (uint32_t)n) : NULL;
+   if (!row) return NULL;
+
+   for (RowProperty* p = row->props; p; p = p->next) {
+      if (strcmp(p->name, prop + 1) == 0) {
+         *instNum = (uint32_t)n;
+         return p;
+      }
+   }
+   return NULL;
+}
+
+// Bulk form of model_walk(): full names are resolved through the element index and
+// the table lookups, and all partial paths share a single pass over the model. found[i]
+// is set for every path that matched at least one property.
+void model_walk_paths(const char* const* paths, int count, bool* found, ModelVisitor visit, void* ctx) {
+   ModelEntry entry;
+   int partials = 0;
+   char name[MAX_NAME_LEN * 2];
+
+   for (int i = 0; i < count; i++) {
+      size_t len = strlen(paths[i]);
+      found[i] = false;
+      if (len == 0) continue;
+      if (paths[i][len - 1] == '.') {
+         partials++;
+         continue;
+      }
+
+      DataElement* de = lookup_element(paths[i]);
+      if (de) {
+         if (de->elementType != RBUS_ELEMENT_TYPE_PROPERTY || strstr(de->name, "{i}")) continue;
+         entry.name = de->name;
+         entry.type = de->type;
+         entry.live = de->getHandler && de->getHandler != getHandler;
+         entry.value = entry.live ? NULL : &de->value;
+         entry.getter = entry.live ? de->getHandler : NULL;
+         entry.version = de->version;
+         visit(&entry, ctx);
+         found[i] = true;
+         continue;
+      }
+
+      uint32_t instNum;
+      RowProperty* p = lookup_row_property(paths[i], name, &instNum);
+      if (p) {
+         entry.name = paths[i];
+         entry.type = p->type;
+         entry.live = !table_is_writable(name);
+         entry.value = &p->value;
+         entry.getter = NULL;
+         entry.version = p->version;
+         visit(&entry, ctx);
+         found[i] = true;
+      }
+   }
+   if (partials == 0) return;
+
+   // Overlapping partial paths all count as found, but each property is reported once
+   for (int e = 0; e < g_totalElements; e++) {
+      DataElement* de = &g_internalDataElements[e];
+      if (de->elementType != RBUS_ELEMENT_TYPE_PROPERTY || strstr(de->name, "{i}")) continue;
+      bool visited = false;
+      for (int i = 0; i < count; i++) {
+         size_t len = strlen(paths[i]);
+         if (len == 0 || paths[i][len - 1] != '.' || strncmp(de->name, paths[i], len) != 0) continue;
+         found[i] = true;
+         if (visited) continue;
+         entry.name = de->name;
+         entry.type = de->type;
+         entry.live = de->getHandler && de->getHandler != getHandler;
+         entry.value = entry.live ? NULL : &de->value;
+         entry.getter = entry.live ? de->getHandler : NULL;
+         entry.version = de->version;
+         visit(&entry, ctx);
+         visited = true;
+      }
+   }
+
+   for (int t = 0; t < g_num_tables; t++) {
+      TableDef* table = &g_tables[t];
+      size_t tlen = strlen(table->name);
+      // Skip tables that can neither contain nor be contained by any partial path
+      bool related = false;
+      for (int i = 0; i < count && !related; i++) {
+         size_t len = strlen(paths[i]);
+         related = len > 0 && paths[i][len - 1] == '.' && strncmp(table->name, paths[i], tlen < len ? tlen : len) == 0;
+      }
+      if (!related) continue;
+
+      bool provider = !table_is_writable(table->name);
+      for (int r = 0; r < table->num_rows; r++) {
+         TableRow* row = &table->rows[r];
+         int rlen = snprintf(name, sizeof(name), "%s%u.", table->name, row->instNum);
+         for (RowProperty* p = row->props; p; p = p->next) {
+            snprintf(name + rlen, sizeof(name) - rlen, "%s", p->name);
+            bool visited = false;
+            for (int i = 0; i < count; i++) {
+               size_t len = strlen(paths[i]);
+               if (len == 0 || paths[i][len - 1] != '.' || strncmp(name, paths[i], len) != 0) continue;
+               found[i] = true;
+               if (visited) continue;
+               entry.name = name;
+               entry.type = p->type;
+               entry.live = provider;
+               entry.value = &p->value;
+               entry.getter = NULL;
+               entry.version = p->version;
+               visit(&entry, ctx);
+               visited = true;
+            }
+         }
+      }
+   }
+}
+
+rbusError_t model_entry_value(const ModelEntry* entry, rbusValue_t* out) {
+   if (entry->value) {
+      rbusValue_Init(out);
+      value_to_rbus(*out, entry->type, entry->value);
+      return RBUS_ERROR_SUCCESS;
+   }
+
+   rbusProperty_t prop = rbusProperty_Init(NULL, entry->name, NULL);
+   rbusError_t rc = entry->getter(g_rbusHandle, prop, NULL);
+   if (rc == RBUS_ERROR_SUCCESS && rbusProperty_GetValue(prop)) {
+      *out = rbusProperty_GetValue(prop);
+      rbusValue_Retain(*out);
+   } else if (rc == RBUS_ERROR_SUCCESS) {
+      rc = RBUS_ERROR_BUS_ERROR;
+   }
+   rbusProperty_Release(prop);
+   return rc;
+}
+
 rbusError_t getTableHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
    (void)handle; (void)options;
    const char* name = rbusProperty_GetName(property);
@@ -96,6 +441,7 @@ rbusError_t getTableHandler(rbusHandle_t handle, rbusProperty_t property, rbusGe
    int slen = strlen(table_name);
    table_name[slen - strlen(TABLE_COUNT_PROP)] = '.';
    table_name[slen - strlen(TABLE_COUNT_PROP) + 1] = '\0';
+   model_lock();
    TableDef* table = NULL;
    for (int i = 0; i < g_num_tables; i++) {
       if (strcmp(g_tables[i].name, table_name) == 0) {
@@ -104,39 +450,28 @@ rbusError_t getTableHandler(rbusHandle_t handle, rbusProperty_t property, rbusGe
       }
    }
    if (!table) {
+      model_unlock();
       return RBUS_ERROR_INVALID_INPUT;
    }
 
    rbusValue_t value;
    rbusValue_Init(&value);
    rbusValue_SetUInt32(value, table->num_inst);
+   model_unlock();
    rbusProperty_SetValue(property, value);
    rbusValue_Release(value);
 
    return RBUS_ERROR_SUCCESS;
 }
 
-rbusError_t table_add_row(rbusHandle_t handle, const char* tableName, const char* aliasName, uint32_t* instNum) {
-   (void)handle;
-   if (!tableName || !instNum) {
-      return RBUS_ERROR_INVALID_INPUT;
-   }
-
+static rbusError_t add_row(const char* tableName, const char* aliasName, uint32_t* instNum) {
    // Find or create TableDef
-   TableDef* table = NULL;
-   for (int i = 0; i < g_num_tables; i++) {
-      if (strcmp(g_tables[i].name, tableName) == 0) {
-         table = &g_tables[i];
-         break;
-      }
-   }
+   TableDef* table = find_table(tableName);
    if (!table) {
-      g_tables = realloc(g_tables, (g_num_tables + 1) * sizeof(TableDef));
-      table = &g_tables[g_num_tables++];
-      strcpy(table->name, tableName);
-      table->rows = NULL;
-      table->num_rows = 0;
-      table->next_inst = 1;
+      table = create_table(tableName);
+      if (!table) {
+         return RBUS_ERROR_OUT_OF_RESOURCES;
+      }
    }
 
    // Check for duplicate alias if provided
@@ -158,17 +493,196 @@ rbusError_t table_add_row(rbusHandle_t handle, const char* tableName, const char
    row->props = NULL;
    *instNum = row->instNum;
    table->num_rows++;
+   // Rows of provider-owned tables (alarms, processes) come and go with the provider
+   row->version = table_is_writable(tableName) ? changelog_record(row->name, CHANGE_ROW_ADDED) : 0;
+   persist_log_row_add(tableName, row->instNum, row->alias);
 
    // fprintf(stderr, "table_add_row: %s, instNum: %d\n", row->name, *instNum);
 
    return RBUS_ERROR_SUCCESS;
 }
 
-rbusError_t table_remove_row(rbusHandle_t handle, const char* rowName) {
-   if (!rowName) {
+rbusError_t table_add_row(rbusHandle_t handle, const char* tableName, const char* aliasName, uint32_t* instNum) {
+   (void)handle;
+   if (!tableName || !instNum) {
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   model_lock();
+   rbusError_t rc = add_row(tableName, aliasName, instNum);
+   model_unlock();
+   return rc;
+}
+
+// Check one row object for AddRows(): alias unique in the table and in the batch, and
+// every property defined for the table with a value of the declared type
+static rbusError_t check_new_row(const TableDef* table, const char* table_wild, rbusObject_t rows, rbusProperty_t row_prop, char* err, size_t errlen) {
+   const char* key = rbusProperty_GetName(row_prop);
+   rbusValue_t row_val = rbusProperty_GetValue(row_prop);
+   if (!row_val || rbusValue_GetType(row_val) != RBUS_OBJECT) {
+      snprintf(err, errlen, "Row %s must be an object of property values", key);
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   char wild[MAX_NAME_LEN * 2];
+   for (rbusProperty_t p = rbusObject_GetProperties(rbusValue_GetObject(row_val)); p; p = rbusProperty_GetNext(p)) {
+      const char* name = rbusProperty_GetName(p);
+      rbusValue_t value = rbusProperty_GetValue(p);
+      if (strcmp(name, "Alias") == 0) {
+         if (!value || rbusValue_GetType(value) != RBUS_STRING) {
+            snprintf(err, errlen, "Row %s: Alias must be a string", key);
+            return RBUS_ERROR_INVALID_INPUT;
+         }
+         const char* alias = rbusValue_GetString(value, NULL);
+         for (int j = 0; alias[0] && table && j < table->num_rows; j++) {
+            if (strcmp(table->rows[j].alias, alias) == 0) {
+               snprintf(err, errlen, "Row %s: alias %s already exists", key, alias);
+               return RBUS_ERROR_ELEMENT_NAME_DUPLICATE;
+            }
+         }
+         for (rbusProperty_t other = rbusObject_GetProperties(rows); alias[0] && other != row_prop; other = rbusProperty_GetNext(other)) {
+            rbusValue_t other_val = rbusProperty_GetValue(other);
+            rbusValue_t other_alias = rbusObject_GetValue(rbusValue_GetObject(other_val), "Alias");
+            if (other_alias && strcmp(rbusValue_GetString(other_alias, NULL), alias) == 0) {
+               snprintf(err, errlen, "Row %s: alias %s used twice", key, alias);
+               return RBUS_ERROR_ELEMENT_NAME_DUPLICATE;
+            }
+         }
+         continue;
+      }
+
+      snprintf(wild, sizeof(wild), "%s{i}.%s", table_wild, name);
+      DataElement* de = lookup_element(wild);
+      if (!de || de->elementType != RBUS_ELEMENT_TYPE_PROPERTY) {
+         snprintf(err, errlen, "Row %s: unknown property %s", key, name);
+         return RBUS_ERROR_INVALID_INPUT;
+      }
+      if (!value || !value_type_matches(de->type, value)) {
+         snprintf(err, errlen, "Row %s: wrong type for %s", key, name);
+         return RBUS_ERROR_INVALID_INPUT;
+      }
+   }
+   return RBUS_ERROR_SUCCESS;
+}
+
+// Create and populate many rows in one call. Every row is validated before anything
+// changes, instance numbers are reserved as one block, the row array grows once, and a
+// single OBJECT_CREATED event on the table lists all new rows. created receives
+// row name -> instance number.
+rbusError_t table_add_rows(rbusHandle_t handle, const char* tableName, rbusObject_t rows, rbusObject_t created, char* err, size_t errlen) {
+   size_t tlen = tableName ? strlen(tableName) : 0;
+   if (tlen == 0 || tableName[tlen - 1] != '.') {
+      snprintf(err, errlen, "Table must be a table name ending in '.'");
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   // Only tables whose rows are owned by consumers can be filled this way
+   char* table_wild = create_wildcard(tableName);
+   if (!table_wild) {
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+   char wild[MAX_NAME_LEN * 2];
+   snprintf(wild, sizeof(wild), "%s{i}.", table_wild);
+   DataElement* table_de = lookup_element(wild);
+   if (!table_de || table_de->elementType != RBUS_ELEMENT_TYPE_TABLE || table_de->tableAddRowHandler != table_add_row) {
+      snprintf(err, errlen, "%s is not a writable table", tableName);
+      free(table_wild);
       return RBUS_ERROR_INVALID_INPUT;
    }
 
+   TableDef* table = find_table(tableName);
+   int count = 0;
+   for (rbusProperty_t rp = rbusObject_GetProperties(rows); rp; rp = rbusProperty_GetNext(rp)) {
+      rbusError_t rc = check_new_row(table, table_wild, rows, rp, err, errlen);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         free(table_wild);
+         return rc;
+      }
+      count++;
+   }
+   free(table_wild);
+   if (count == 0) {
+      return RBUS_ERROR_SUCCESS;
+   }
+
+   if (!table && !(table = create_table(tableName))) {
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+   TableRow* grown = realloc(table->rows, (table->num_rows + count) * sizeof(TableRow));
+   if (!grown) {
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+   table->rows = grown;
+   uint32_t first = table->next_inst;
+   table->next_inst += count;
+
+   rbusObject_t names;
+   rbusObject_Init(&names, NULL);
+   char name[MAX_NAME_LEN * 2];
+   uint32_t inst = first;
+   for (rbusProperty_t rp = rbusObject_GetProperties(rows); rp; rp = rbusProperty_GetNext(rp), inst++) {
+      rbusObject_t row_obj = rbusValue_GetObject(rbusProperty_GetValue(rp));
+      rbusValue_t alias = rbusObject_GetValue(row_obj, "Alias");
+
+      TableRow* row = &table->rows[table->num_rows++];
+      memset(row, 0, sizeof(TableRow));
+      snprintf(row->name, MAX_NAME_LEN, "%s%u.", tableName, inst);
+      row->instNum = inst;
+      snprintf(row->alias, MAX_NAME_LEN, "%s", alias ? rbusValue_GetString(alias, NULL) : "");
+      table->num_inst++;
+      row->version = changelog_record(row->name, CHANGE_ROW_ADDED);
+      persist_log_row_add(tableName, inst, row->alias);
+
+      for (rbusProperty_t p = rbusObject_GetProperties(row_obj); p; p = rbusProperty_GetNext(p)) {
+         if (strcmp(rbusProperty_GetName(p), "Alias") == 0) continue;
+         snprintf(name, sizeof(name), "%s%s", row->name, rbusProperty_GetName(p));
+         SetTarget target;
+         ElementValue v;
+         rbusValue_t value = rbusProperty_GetValue(p);
+         if (set_resolve(name, value, true, &target) != RBUS_ERROR_SUCCESS ||
+            value_from_rbus(target.type, value, &v) != RBUS_ERROR_SUCCESS) {
+            fprintf(stderr, "Failed to populate %s\n", name);
+            continue;
+         }
+         set_apply(name, &target, &v, value);
+      }
+
+      rbusError_t rc = rbusTable_registerRow(handle, tableName, inst, row->alias[0] ? row->alias : NULL);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         fprintf(stderr, "Failed to register row %s: %d\n", row->name, rc);
+      }
+
+      rbusValue_t val;
+      rbusValue_Init(&val);
+      rbusValue_SetUInt32(val, inst);
+      rbusObject_SetValue(created, row->name, val);
+      rbusObject_SetValue(names, row->name, val);
+      rbusValue_Release(val);
+   }
+
+   rbusObject_t data;
+   rbusObject_Init(&data, NULL);
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, (uint32_t)count);
+   rbusObject_SetValue(data, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, names);
+   rbusObject_SetValue(data, "Rows", val);
+   rbusValue_Release(val);
+
+   rbusEvent_t event = {.name = tableName, .type = RBUS_EVENT_OBJECT_CREATED, .data = data};
+   rbusError_t rc = rbusEvent_Publish(handle, &event);
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish row creation event for %s: %d\n", tableName, rc);
+   }
+   rbusObject_Release(data);
+   rbusObject_Release(names);
+   return RBUS_ERROR_SUCCESS;
+}
+
+static rbusError_t remove_row(rbusHandle_t handle, const char* rowName) {
    size_t len = strlen(rowName);
    if (len == 0 || rowName[len - 1] != '.') {
       return RBUS_ERROR_INVALID_INPUT;
@@ -252,10 +766,16 @@ rbusError_t table_remove_row(rbusHandle_t handle, const char* rowName) {
       return RBUS_ERROR_INVALID_INPUT;
    }
 
+   persist_log_row_remove(tableName, table->rows[row_index].instNum);
+
    // Free row properties
    RowProperty* p = table->rows[row_index].props;
    while (p) {
       RowProperty* next = p->next;
+      char prop_name[MAX_NAME_LEN * 2];
+      snprintf(prop_name, sizeof(prop_name), "%s%u.%s", tableName, table->rows[row_index].instNum, p->name);
+      alarm_unbind(&p->alarms, prop_name);
+      history_free(p->history);
       if (IS_STRING_TYPE(p->type)) {
          free(p->value.strVal);
       }
@@ -268,6 +788,10 @@ rbusError_t table_remove_row(rbusHandle_t handle, const char* rowName) {
    table->num_rows--;
    table->rows = realloc(table->rows, table->num_rows * sizeof(TableRow));
 
+   if (table_is_writable(tableName)) {
+      changelog_record(rowName, CHANGE_ROW_REMOVED);
+   }
+
    // Publish deletion event
    rbusEvent_t event = {.name = rowName, .type = RBUS_EVENT_OBJECT_DELETED, .data = NULL};
    rbusError_t rc = rbusEvent_Publish(handle, &event);
@@ -282,6 +806,16 @@ rbusError_t table_remove_row(rbusHandle_t handle, const char* rowName) {
    return RBUS_ERROR_SUCCESS;
 }
 
+rbusError_t table_remove_row(rbusHandle_t handle, const char* rowName) {
+   if (!rowName) {
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   model_lock();
+   rbusError_t rc = remove_row(handle, rowName);
+   model_unlock();
+   return rc;
+}
+
 void valueChangeHandler(rbusHandle_t handle, rbusEvent_t const* event, rbusEventSubscription_t* subscription) {
    (void)handle; (void)subscription;
    rbusValue_t newValue = rbusObject_GetValue(event->data, "value");
@@ -337,8 +871,7 @@ rbusError_t eventSubHandler(rbusHandle_t handle, rbusEventSubAction_t action, co
    return RBUS_ERROR_SUCCESS;
 }
 
-rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
-   (void)handle; (void)options;
+static rbusError_t get_stored_value(rbusProperty_t property) {
    const char* name = rbusProperty_GetName(property);
    uint32_t inst;
    char* prop;
@@ -350,37 +883,7 @@ rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHand
          return RBUS_ERROR_INVALID_INPUT;
       rbusValue_t value;
       rbusValue_Init(&value);
-      switch (de->type) {
-         case TYPE_STRING:
-         case TYPE_DATETIME:
-         case TYPE_BASE64:
-            rbusValue_SetString(value, de->value.strVal);
-            break;
-         case TYPE_INT:
-            rbusValue_SetInt32(value, de->value.intVal);
-            break;
-         case TYPE_UINT:
-            rbusValue_SetUInt32(value, de->value.uintVal);
-            break;
-         case TYPE_BOOL:
-            rbusValue_SetBoolean(value, de->value.boolVal);
-            break;
-         case TYPE_LONG:
-            rbusValue_SetInt64(value, de->value.longVal);
-            break;
-         case TYPE_ULONG:
-            rbusValue_SetUInt64(value, de->value.ulongVal);
-            break;
-         case TYPE_FLOAT:
-            rbusValue_SetSingle(value, de->value.floatVal);
-            break;
-         case TYPE_DOUBLE:
-            rbusValue_SetDouble(value, de->value.doubleVal);
-            break;
-         case TYPE_BYTE:
-            rbusValue_SetByte(value, de->value.byteVal);
-            break;
-      }
+      value_to_rbus(value, de->type, &de->value);
       rbusProperty_SetValue(property, value);
       rbusValue_Release(value);
       return RBUS_ERROR_SUCCESS;
@@ -431,7 +934,7 @@ rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHand
             return RBUS_ERROR_BUS_ERROR;
          }
 
-         p = (RowProperty*)malloc(sizeof(RowProperty));
+         p = (RowProperty*)calloc(1, sizeof(RowProperty));
          if (!p) {
             free(tbl);
             free(prop);
@@ -453,43 +956,15 @@ rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHand
                memset(&p->value, 0, sizeof(p->value));
                break;
          }
+         alarm_bind(&p->alarms, &de->alarms);
+         history_bind(&p->history, de->history);
          p->next = row->props;
          row->props = p;
       }
 
       rbusValue_t value;
       rbusValue_Init(&value);
-      switch (p->type) {
-         case TYPE_STRING:
-         case TYPE_DATETIME:
-         case TYPE_BASE64:
-            rbusValue_SetString(value, p->value.strVal);
-            break;
-         case TYPE_INT:
-            rbusValue_SetInt32(value, p->value.intVal);
-            break;
-         case TYPE_UINT:
-            rbusValue_SetUInt32(value, p->value.uintVal);
-            break;
-         case TYPE_BOOL:
-            rbusValue_SetBoolean(value, p->value.boolVal);
-            break;
-         case TYPE_LONG:
-            rbusValue_SetInt64(value, p->value.longVal);
-            break;
-         case TYPE_ULONG:
-            rbusValue_SetUInt64(value, p->value.ulongVal);
-            break;
-         case TYPE_FLOAT:
-            rbusValue_SetSingle(value, p->value.floatVal);
-            break;
-         case TYPE_DOUBLE:
-            rbusValue_SetDouble(value, p->value.doubleVal);
-            break;
-         case TYPE_BYTE:
-            rbusValue_SetByte(value, p->value.byteVal);
-            break;
-      }
+      value_to_rbus(value, p->type, &p->value);
       rbusProperty_SetValue(property, value);
       rbusValue_Release(value);
       free(tbl);
@@ -498,199 +973,199 @@ rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHand
    }
 }
 
-rbusError_t setHandler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
    (void)handle; (void)options;
-   const char* name = rbusProperty_GetName(property);
+   model_lock();
+   rbusError_t rc = get_stored_value(property);
+   model_unlock();
+   return rc;
+}
 
-   rbusValue_t value = rbusProperty_GetValue(property);
+bool value_type_matches(ValueType type, rbusValue_t value) {
+   rbusValueType_t vt = rbusValue_GetType(value);
+   switch (type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64: return vt == RBUS_STRING;
+      case TYPE_INT: return vt == RBUS_INT32;
+      case TYPE_UINT: return vt == RBUS_UINT32;
+      case TYPE_BOOL: return vt == RBUS_BOOLEAN;
+      case TYPE_LONG: return vt == RBUS_INT64;
+      case TYPE_ULONG: return vt == RBUS_UINT64;
+      case TYPE_FLOAT: return vt == RBUS_SINGLE;
+      case TYPE_DOUBLE: return vt == RBUS_DOUBLE;
+      case TYPE_BYTE: return vt == RBUS_BYTE;
+   }
+   return false;
+}
+
+rbusError_t value_from_rbus(ValueType type, rbusValue_t value, ElementValue* out) {
+   switch (type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64:
+         out->strVal = strdup(rbusValue_GetString(value, NULL));
+         return out->strVal ? RBUS_ERROR_SUCCESS : RBUS_ERROR_OUT_OF_RESOURCES;
+      case TYPE_INT:
+         out->intVal = rbusValue_GetInt32(value);
+         break;
+      case TYPE_UINT:
+         out->uintVal = rbusValue_GetUInt32(value);
+         break;
+      case TYPE_BOOL:
+         out->boolVal = rbusValue_GetBoolean(value);
+         break;
+      case TYPE_LONG:
+         out->longVal = rbusValue_GetInt64(value);
+         break;
+      case TYPE_ULONG:
+         out->ulongVal = rbusValue_GetUInt64(value);
+         break;
+      case TYPE_FLOAT:
+         out->floatVal = rbusValue_GetSingle(value);
+         break;
+      case TYPE_DOUBLE:
+         out->doubleVal = rbusValue_GetDouble(value);
+         break;
+      case TYPE_BYTE:
+         out->byteVal = rbusValue_GetByte(value);
+         break;
+   }
+   return RBUS_ERROR_SUCCESS;
+}
+
+// Find where a set of name lands and check the value's type. A row property that has
+// not been set yet is created from its wildcard definition only when create is true,
+// so set sessions can validate without touching the model.
+rbusError_t set_resolve(const char* name, rbusValue_t value, bool create, SetTarget* target) {
+   memset(target, 0, sizeof(*target));
    uint32_t inst;
    char* prop;
    char* tbl = get_table_name(name, &inst, &prop);
    if (tbl == NULL) {
       // Normal property
       DataElement* de = lookup_element(name);
-      if(!de || de->elementType != RBUS_ELEMENT_TYPE_PROPERTY)
+      if (!de || de->elementType != RBUS_ELEMENT_TYPE_PROPERTY)
          return RBUS_ERROR_INVALID_INPUT;
-      ValueType type = de->type;
-      rbusValueType_t vt = rbusValue_GetType(value);
-      if ((type == TYPE_STRING && vt != RBUS_STRING) ||
-         (type == TYPE_INT && vt != RBUS_INT32) ||
-         (type == TYPE_UINT && vt != RBUS_UINT32) ||
-         (type == TYPE_BOOL && vt != RBUS_BOOLEAN) ||
-         (type == TYPE_DATETIME && vt != RBUS_STRING) ||
-         (type == TYPE_BASE64 && vt != RBUS_STRING) ||
-         (type == TYPE_LONG && vt != RBUS_INT64) ||
-         (type == TYPE_ULONG && vt != RBUS_UINT64) ||
-         (type == TYPE_FLOAT && vt != RBUS_SINGLE) ||
-         (type == TYPE_DOUBLE && vt != RBUS_DOUBLE) ||
-         (type == TYPE_BYTE && vt != RBUS_BYTE)) {
+      if (!value_type_matches(de->type, value))
          return RBUS_ERROR_INVALID_INPUT;
-      }
-      if (IS_STRING_TYPE(type)) {
-         free(de->value.strVal);
-         de->value.strVal = strdup(rbusValue_GetString(value, NULL));
-         if (!de->value.strVal) {
-            return RBUS_ERROR_OUT_OF_RESOURCES;
-         }
-      } else {
-         switch (type) {
-            case TYPE_INT:
-               de->value.intVal = rbusValue_GetInt32(value);
-               break;
-            case TYPE_UINT:
-               de->value.uintVal = rbusValue_GetUInt32(value);
-               break;
-            case TYPE_BOOL:
-               de->value.boolVal = rbusValue_GetBoolean(value);
-               break;
-            case TYPE_LONG:
-               de->value.longVal = rbusValue_GetInt64(value);
-               break;
-            case TYPE_ULONG:
-               de->value.ulongVal = rbusValue_GetUInt64(value);
-               break;
-            case TYPE_FLOAT:
-               de->value.floatVal = rbusValue_GetSingle(value);
-               break;
-            case TYPE_DOUBLE:
-               de->value.doubleVal = rbusValue_GetDouble(value);
-               break;
-            case TYPE_BYTE:
-               de->value.byteVal = rbusValue_GetByte(value);
-               break;
-            default:
-               break;
-         }
-      }
+      target->de = de;
+      target->type = de->type;
       return RBUS_ERROR_SUCCESS;
-   } else {
-      // Row property
-      TableDef* table = NULL;
-      for (int i = 0; i < g_num_tables; i++) {
-         if (strcmp(g_tables[i].name, tbl) == 0) {
-            table = &g_tables[i];
-            break;
-         }
-      }
-      if (!table) {
-         free(tbl);
-         free(prop);
-         return RBUS_ERROR_BUS_ERROR;
-      }
+   }
 
-      TableRow* row = NULL;
-      for (int i = 0; i < table->num_rows; i++) {
-         if (table->rows[i].instNum == inst) {
-            row = &table->rows[i];
-            break;
-         }
-      }
-      if (!row) {
-         free(tbl);
-         free(prop);
-         return RBUS_ERROR_BUS_ERROR;
-      }
+   // Row property
+   rbusError_t rc = RBUS_ERROR_BUS_ERROR;
+   TableDef* table = find_table(tbl);
+   TableRow* row = table ? find_row(table, inst) : NULL;
+   RowProperty* p = NULL;
+   RowProperty* prev = NULL;
+   if (!row) {
+      goto out;
+   }
 
-      RowProperty* p = row->props;
-      RowProperty* prev = NULL;
-      while (p) {
-         if (strcmp(p->name, prop) == 0) {
-            break;
-         }
-         prev = p;
-         p = p->next;
+   for (p = row->props; p; prev = p, p = p->next) {
+      if (strcmp(p->name, prop) == 0) {
+         break;
       }
+   }
 
-      ValueType type;
-      if (!p) {
-         char* wildcard = create_wildcard(name);
-         DataElement* de = lookup_element(wildcard);
-         if (!de) {
-            free(tbl);
-            free(prop);
-            free(wildcard);
-            return RBUS_ERROR_BUS_ERROR;
-         }
-
-         p = (RowProperty*)malloc(sizeof(RowProperty));
+   if (p) {
+      target->type = p->type;
+   } else {
+      char* wildcard = create_wildcard(name);
+      DataElement* de = wildcard ? lookup_element(wildcard) : NULL;
+      free(wildcard);
+      if (!de) {
+         goto out;
+      }
+      target->type = de->type;
+      if (value_type_matches(de->type, value) && create) {
+         p = (RowProperty*)calloc(1, sizeof(RowProperty));
          if (!p) {
-            free(tbl);
-            free(prop);
-            free(wildcard);
-            return RBUS_ERROR_BUS_ERROR;
+            goto out;
          }
-
          strcpy(p->name, prop);
          p->type = de->type;
-         memset(&p->value, 0, sizeof(p->value));
-         p->next = NULL;
-
+         if (IS_STRING_TYPE(p->type) && !(p->value.strVal = strdup(""))) {
+            free(p);
+            rc = RBUS_ERROR_OUT_OF_RESOURCES;
+            goto out;
+         }
+         alarm_bind(&p->alarms, &de->alarms);
+         history_bind(&p->history, de->history);
          if (prev) {
             prev->next = p;
          } else {
             row->props = p;
          }
-         free(wildcard);
-      }
-
-      type = p->type;
-      rbusValueType_t vt = rbusValue_GetType(value);
-      if ((type == TYPE_STRING && vt != RBUS_STRING) ||
-         (type == TYPE_INT && vt != RBUS_INT32) ||
-         (type == TYPE_UINT && vt != RBUS_UINT32) ||
-         (type == TYPE_BOOL && vt != RBUS_BOOLEAN) ||
-         (type == TYPE_DATETIME && vt != RBUS_STRING) ||
-         (type == TYPE_BASE64 && vt != RBUS_STRING) ||
-         (type == TYPE_LONG && vt != RBUS_INT64) ||
-         (type == TYPE_ULONG && vt != RBUS_UINT64) ||
-         (type == TYPE_FLOAT && vt != RBUS_SINGLE) ||
-         (type == TYPE_DOUBLE && vt != RBUS_DOUBLE) ||
-         (type == TYPE_BYTE && vt != RBUS_BYTE)) {
-         free(tbl);
-         free(prop);
-         return RBUS_ERROR_INVALID_INPUT;
       }
+   }
 
-      if (IS_STRING_TYPE(type)) {
-         free(p->value.strVal);
-         p->value.strVal = strdup(rbusValue_GetString(value, NULL));
-         if (!p->value.strVal) {
-            free(tbl);
-            free(prop);
-            return RBUS_ERROR_OUT_OF_RESOURCES;
-         }
-      } else {
-         switch (type) {
-            case TYPE_INT:
-               p->value.intVal = rbusValue_GetInt32(value);
-               break;
-            case TYPE_UINT:
-               p->value.uintVal = rbusValue_GetUInt32(value);
-               break;
-            case TYPE_BOOL:
-               p->value.boolVal = rbusValue_GetBoolean(value);
-               break;
-            case TYPE_LONG:
-               p->value.longVal = rbusValue_GetInt64(value);
-               break;
-            case TYPE_ULONG:
-               p->value.ulongVal = rbusValue_GetUInt64(value);
-               break;
-            case TYPE_FLOAT:
-               p->value.floatVal = rbusValue_GetSingle(value);
-               break;
-            case TYPE_DOUBLE:
-               p->value.doubleVal = rbusValue_GetDouble(value);
-               break;
-            case TYPE_BYTE:
-               p->value.byteVal = rbusValue_GetByte(value);
-               break;
-            default:
-               break;
-         }
-      }
-      free(tbl);
-      free(prop);
-      return RBUS_ERROR_SUCCESS;
+   if (!value_type_matches(target->type, value)) {
+      rc = RBUS_ERROR_INVALID_INPUT;
+      goto out;
+   }
+   target->row = row;
+   target->prop = p;
+   rc = RBUS_ERROR_SUCCESS;
+
+out:
+   free(tbl);
+   free(prop);
+   return rc;
+}
+
+// Store an already converted value (ownership of any string moves to the model)
+void set_apply(const char* name, const SetTarget* target, const ElementValue* v, rbusValue_t value) {
+   if (target->de) {
+      DataElement* de = target->de;
+      if (IS_STRING_TYPE(de->type)) free(de->value.strVal);
+      de->value = *v;
+      de->version = changelog_record(name, CHANGE_VALUE);
+      de->persisted |= persist_log_set(name, de->type, v);
+      history_record(de->history, value);
+      alarm_evaluate(name, &de->alarms, value);
+      return;
+   }
+
+   RowProperty* p = target->prop;
+   if (IS_STRING_TYPE(p->type)) free(p->value.strVal);
+   p->value = *v;
+   p->version = changelog_record(name, CHANGE_VALUE);
+   p->persisted |= persist_log_set(name, p->type, v);
+   target->row->version = p->version;
+   history_record(p->history, value);
+   alarm_evaluate(name, &p->alarms, value);
+}
+
+rbusError_t setHandler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+   const char* name = rbusProperty_GetName(property);
+   rbusValue_t value = rbusProperty_GetValue(property);
+
+   model_lock();
+   // Part of a multi-parameter set: staged until the commit
+   if (set_session_pending(options)) {
+      rbusError_t rc = set_session_stage(handle, options, name, value);
+      model_unlock();
+      return rc;
    }
+
+   SetTarget target;
+   ElementValue v;
+   rbusError_t rc = set_resolve(name, value, true, &target);
+   if (rc == RBUS_ERROR_SUCCESS) {
+      rc = value_from_rbus(target.type, value, &v);
+   }
+   if (rc == RBUS_ERROR_SUCCESS) {
+      set_apply(name, &target, &v, value);
+   }
+   model_unlock();
+   return rc;
+}
+
+// Rows of the alarm and process tables are written by their providers only
+rbusError_t readOnlySetHandler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+   (void)property;
+   return set_session_end(handle, options, RBUS_ERROR_ACCESS_NOT_ALLOWED);
 }
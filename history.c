@@ -0,0 +1,432 @@
+#include "rbus_elements.h"
+
+extern rbusHandle_t g_rbusHandle;
+
+/* Samples are kept as (value, time) pairs. The oldest sample is held in first_*,
+ * every later one is a record of zigzag varint deltas (value, then time) against
+ * its predecessor, stored in a circular byte buffer. */
+struct HistorySeries {
+   uint32_t max_samples;
+   uint32_t interval;      // seconds between timer samples, 0 records on every set
+   time_t next_due;
+   uint8_t* buf;           // NULL for wildcard templates
+   uint32_t cap;
+   uint32_t start;         // offset of the oldest delta record
+   uint32_t used;
+   uint32_t count;         // samples held, including first_*
+   int64_t first_value;
+   int64_t first_time;
+   int64_t last_value;
+   int64_t last_time;
+};
+
+typedef struct {
+   char target[MAX_NAME_LEN];
+   uint32_t samples;
+   uint32_t interval;
+} HistoryRule;
+
+static HistoryRule* g_history_rules = NULL;
+static int g_num_history_rules = 0;
+static DataElement** g_sampled = NULL;
+static int g_num_sampled = 0;
+
+static uint64_t zigzag(int64_t v) {
+   return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+   return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static int put_varint(uint8_t* out, uint64_t v) {
+   int n = 0;
+   while (v >= 0x80) {
+      out[n++] = (uint8_t)(v | 0x80);
+      v >>= 7;
+   }
+   out[n++] = (uint8_t)v;
+   return n;
+}
+
+// Reads one varint starting at *pos in the circular buffer, advancing *pos
+static uint64_t get_varint(const HistorySeries* s, uint32_t* pos, uint32_t* len) {
+   uint64_t v = 0;
+   int shift = 0;
+   uint8_t b;
+   do {
+      b = s->buf[*pos];
+      *pos = (*pos + 1) % s->cap;
+      (*len)++;
+      v |= (uint64_t)(b & 0x7F) << shift;
+      shift += 7;
+   } while ((b & 0x80) && shift < 64);
+   return v;
+}
+
+static uint32_t read_record(const HistorySeries* s, uint32_t pos, int64_t* dv, int64_t* dt) {
+   uint32_t len = 0;
+   *dv = unzigzag(get_varint(s, &pos, &len));
+   *dt = unzigzag(get_varint(s, &pos, &len));
+   return len;
+}
+
+static void evict_oldest(HistorySeries* s) {
+   if (s->count <= 1) {
+      s->count = 0;
+      s->used = 0;
+      return;
+   }
+   int64_t dv, dt;
+   uint32_t len = read_record(s, s->start, &dv, &dt);
+   s->first_value += dv;
+   s->first_time += dt;
+   s->start = (s->start + len) % s->cap;
+   s->used -= len;
+   s->count--;
+}
+
+static void history_append(HistorySeries* s, int64_t t, int64_t v) {
+   if (s->count == 0) {
+      s->first_value = s->last_value = v;
+      s->first_time = s->last_time = t;
+      s->start = 0;
+      s->used = 0;
+      s->count = 1;
+      return;
+   }
+
+   uint8_t rec[20];
+   int n = put_varint(rec, zigzag(v - s->last_value));
+   n += put_varint(rec + n, zigzag(t - s->last_time));
+
+   while (s->count > 0 && (s->count >= s->max_samples || s->cap - s->used < (uint32_t)n)) {
+      evict_oldest(s);
+   }
+   if (s->count == 0) {
+      history_append(s, t, v);
+      return;
+   }
+
+   uint32_t pos = (s->start + s->used) % s->cap;
+   for (int i = 0; i < n; i++) {
+      s->buf[pos] = rec[i];
+      pos = (pos + 1) % s->cap;
+   }
+   s->used += n;
+   s->count++;
+   s->last_value = v;
+   s->last_time = t;
+}
+
+static HistorySeries* history_new(uint32_t samples, uint32_t interval, bool with_buffer) {
+   HistorySeries* s = calloc(1, sizeof(HistorySeries));
+   if (!s) return NULL;
+   s->max_samples = samples;
+   s->interval = interval;
+   if (with_buffer) {
+      s->cap = samples * HISTORY_BYTES_PER_SAMPLE;
+      if (s->cap < 20) s->cap = 20;
+      s->buf = malloc(s->cap);
+      if (!s->buf) {
+         free(s);
+         return NULL;
+      }
+   }
+   return s;
+}
+
+void history_free(HistorySeries* series) {
+   if (!series) return;
+   free(series->buf);
+   free(series);
+}
+
+static bool value_as_int64(rbusValue_t value, int64_t* out) {
+   switch (value ? rbusValue_GetType(value) : RBUS_NONE) {
+      case RBUS_INT32: *out = rbusValue_GetInt32(value); return true;
+      case RBUS_UINT32: *out = rbusValue_GetUInt32(value); return true;
+      case RBUS_INT64: *out = rbusValue_GetInt64(value); return true;
+      case RBUS_UINT64: *out = (int64_t)rbusValue_GetUInt64(value); return true;
+      case RBUS_BYTE: *out = rbusValue_GetByte(value); return true;
+      case RBUS_BOOLEAN: *out = rbusValue_GetBoolean(value) ? 1 : 0; return true;
+      default: return false;
+   }
+}
+
+void history_record(HistorySeries* series, rbusValue_t value) {
+   if (!series || !series->buf || series->interval != 0) return;
+   int64_t v;
+   if (value_as_int64(value, &v)) {
+      history_append(series, (int64_t)time(NULL), v);
+   }
+}
+
+void history_bind(HistorySeries** series, const HistorySeries* tmpl) {
+   *series = NULL;
+   if (!tmpl) return;
+   *series = history_new(tmpl->max_samples, 0, true);
+}
+
+bool history_add_rule(cJSON* item, int index) {
+   cJSON* target_obj = cJSON_GetObjectItem(item, "target");
+   cJSON* samples_obj = cJSON_GetObjectItem(item, "samples");
+   cJSON* interval_obj = cJSON_GetObjectItem(item, "interval");
+
+   if (!cJSON_IsString(target_obj)) {
+      fprintf(stderr, "History item %d needs a target\n", index);
+      return false;
+   }
+
+   HistoryRule* rules = realloc(g_history_rules, (g_num_history_rules + 1) * sizeof(HistoryRule));
+   if (!rules) {
+      fprintf(stderr, "Failed to allocate memory for history rules\n");
+      return false;
+   }
+   g_history_rules = rules;
+   HistoryRule* r = &g_history_rules[g_num_history_rules++];
+   snprintf(r->target, MAX_NAME_LEN, "%s", cJSON_GetStringValue(target_obj));
+   r->samples = cJSON_IsNumber(samples_obj) && samples_obj->valuedouble >= 2 ? (uint32_t)samples_obj->valuedouble : HISTORY_DEFAULT_SAMPLES;
+   r->interval = cJSON_IsNumber(interval_obj) && interval_obj->valuedouble >= 1 ? (uint32_t)interval_obj->valuedouble : 0;
+   return true;
+}
+
+static void history_sample_tick(void* ctx) {
+   (void)ctx;
+   time_t now = time(NULL);
+   model_lock();
+   for (int i = 0; i < g_num_sampled; i++) {
+      DataElement* de = g_sampled[i];
+      HistorySeries* s = de->history;
+      if (now < s->next_due) continue;
+      s->next_due = now + s->interval;
+
+      rbusProperty_t prop = rbusProperty_Init(NULL, de->name, NULL);
+      int64_t v;
+      if (de->getHandler(g_rbusHandle, prop, NULL) == RBUS_ERROR_SUCCESS &&
+         value_as_int64(rbusProperty_GetValue(prop), &v)) {
+         history_append(s, (int64_t)now, v);
+      }
+      rbusProperty_Release(prop);
+   }
+   model_unlock();
+}
+
+void history_bind_rules(void) {
+   for (int i = 0; i < g_num_history_rules; i++) {
+      HistoryRule* r = &g_history_rules[i];
+      DataElement* de = lookup_element(r->target);
+      if (!de || de->elementType != RBUS_ELEMENT_TYPE_PROPERTY) {
+         fprintf(stderr, "History for unknown property %s\n", r->target);
+         continue;
+      }
+      if (IS_STRING_TYPE(de->type) || de->type == TYPE_FLOAT || de->type == TYPE_DOUBLE) {
+         fprintf(stderr, "History for %s: only integer and boolean properties are supported\n", r->target);
+         continue;
+      }
+      if (de->history) {
+         continue;
+      }
+
+      bool wildcard = strstr(de->name, "{i}") != NULL;
+      if (r->interval > 0) {
+         // Timer sampling is for live getters; stored values are already recorded on set
+         if (wildcard || !de->getHandler || de->getHandler == getHandler) {
+            fprintf(stderr, "History for %s: interval sampling needs a property with its own getter\n", r->target);
+            continue;
+         }
+         DataElement** sampled = realloc(g_sampled, (g_num_sampled + 1) * sizeof(DataElement*));
+         if (!sampled) continue;
+         g_sampled = sampled;
+         g_sampled[g_num_sampled++] = de;
+      }
+      de->history = history_new(r->samples, r->interval, !wildcard);
+   }
+
+   free(g_history_rules);
+   g_history_rules = NULL;
+   g_num_history_rules = 0;
+
+   if (g_num_sampled > 0 && event_loop_add_timer(1000, history_sample_tick, NULL) < 0) {
+      fprintf(stderr, "Failed to schedule history sampling\n");
+   }
+}
+
+static HistorySeries* find_series(const char* name) {
+   uint32_t inst;
+   char* prop = NULL;
+   char* tbl = get_table_name(name, &inst, &prop);
+   if (!tbl) {
+      DataElement* de = lookup_element(name);
+      return de && de->history && de->history->buf ? de->history : NULL;
+   }
+
+   HistorySeries* series = NULL;
+   TableRow* row = find_row(find_table(tbl), inst);
+   for (RowProperty* p = row ? row->props : NULL; p; p = p->next) {
+      if (strcmp(p->name, prop) == 0) {
+         series = p->history;
+         break;
+      }
+   }
+   free(tbl);
+   free(prop);
+   return series;
+}
+
+// Called with the model locked: the series is appended to by sets and the sampler
+static rbusError_t read_history(const char* name, rbusObject_t inParams, rbusObject_t outParams) {
+   HistorySeries* s = find_series(name);
+   if (!s) {
+      rbusValue_t errorVal;
+      rbusValue_Init(&errorVal);
+      rbusValue_SetString(errorVal, "No history recorded for Name");
+      rbusObject_SetValue(outParams, "error", errorVal);
+      rbusValue_Release(errorVal);
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   int64_t start = 0;
+   uint32_t max = 0;
+   bool csv = false;
+   rbusValue_t startVal = rbusObject_GetValue(inParams, "Start");
+   if (startVal) value_as_int64(startVal, &start);
+   rbusValue_t maxVal = rbusObject_GetValue(inParams, "MaxSamples");
+   int64_t max64;
+   if (maxVal && value_as_int64(maxVal, &max64) && max64 > 0) max = (uint32_t)max64;
+   rbusValue_t formatVal = rbusObject_GetValue(inParams, "Format");
+   if (formatVal && rbusValue_GetType(formatVal) == RBUS_STRING) {
+      csv = strcmp(rbusValue_GetString(formatVal, NULL), "csv") == 0;
+   }
+
+   // Skip samples older than Start
+   int64_t t = s->first_time, v = s->first_value;
+   uint32_t idx = 0, pos = s->start;
+   while (idx < s->count && t < start) {
+      if (idx + 1 == s->count) {
+         idx++;
+         break;
+      }
+      int64_t dv, dt;
+      pos = (pos + read_record(s, pos, &dv, &dt)) % s->cap;
+      v += dv;
+      t += dt;
+      idx++;
+   }
+
+   uint32_t count = s->count - idx;
+   bool more = false;
+   if (max && count > max) {
+      count = max;
+      more = true;
+   }
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, name);
+   rbusObject_SetValue(outParams, "Name", val);
+   rbusValue_Release(val);
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, count);
+   rbusObject_SetValue(outParams, "Count", val);
+   rbusValue_Release(val);
+   rbusValue_Init(&val);
+   rbusValue_SetBoolean(val, more);
+   rbusObject_SetValue(outParams, "More", val);
+   rbusValue_Release(val);
+
+   if (count == 0) {
+      return RBUS_ERROR_SUCCESS;
+   }
+
+   if (csv) {
+      size_t cap = (size_t)count * 24 + 1;
+      char* times = malloc(cap);
+      char* values = malloc(cap);
+      if (!times || !values) {
+         free(times);
+         free(values);
+         return RBUS_ERROR_OUT_OF_RESOURCES;
+      }
+      size_t tl = 0, vl = 0;
+      for (uint32_t k = 0; k < count; k++) {
+         if (k > 0) {
+            int64_t dv, dt;
+            pos = (pos + read_record(s, pos, &dv, &dt)) % s->cap;
+            v += dv;
+            t += dt;
+         }
+         tl += snprintf(times + tl, cap - tl, "%s%lld", k ? "," : "", (long long)t);
+         vl += snprintf(values + vl, cap - vl, "%s%lld", k ? "," : "", (long long)v);
+      }
+      rbusValue_Init(&val);
+      rbusValue_SetString(val, times);
+      rbusObject_SetValue(outParams, "Times", val);
+      rbusValue_Release(val);
+
+      rbusValue_Init(&val);
+      rbusValue_SetString(val, values);
+      rbusObject_SetValue(outParams, "Values", val);
+      rbusValue_Release(val);
+      free(times);
+      free(values);
+      return RBUS_ERROR_SUCCESS;
+   }
+
+   // Raw window: the selected delta records are copied as stored, relative to FirstTime/FirstValue
+   uint32_t len = 0, p = pos;
+   for (uint32_t k = 1; k < count; k++) {
+      int64_t dv, dt;
+      uint32_t n = read_record(s, p, &dv, &dt);
+      p = (p + n) % s->cap;
+      len += n;
+   }
+   uint8_t* data = malloc(len ? len : 1);
+   if (!data) {
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+   for (uint32_t k = 0; k < len; k++) {
+      data[k] = s->buf[(pos + k) % s->cap];
+   }
+
+   rbusValue_Init(&val);
+   rbusValue_SetInt64(val, t);
+   rbusObject_SetValue(outParams, "FirstTime", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetInt64(val, v);
+   rbusObject_SetValue(outParams, "FirstValue", val);
+   rbusValue_Release(val);
+   rbusValue_Init(&val);
+   rbusValue_SetBytes(val, data, (int)len);
+   rbusObject_SetValue(outParams, "Data", val);
+   rbusValue_Release(val);
+   free(data);
+
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t get_history_method(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
+   (void)handle; (void)methodName; (void)asyncHandle;
+
+   rbusValue_t nameVal = rbusObject_GetValue(inParams, "Name");
+   if (!nameVal || rbusValue_GetType(nameVal) != RBUS_STRING) {
+      rbusValue_t errorVal;
+      rbusValue_Init(&errorVal);
+      rbusValue_SetString(errorVal, "Name must be a string");
+      rbusObject_SetValue(outParams, "error", errorVal);
+      rbusValue_Release(errorVal);
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   model_lock();
+   rbusError_t rc = read_history(rbusValue_GetString(nameVal, NULL), inParams, outParams);
+   model_unlock();
+   return rc;
+}
+
+void history_cleanup(void) {
+   free(g_sampled);
+   g_sampled = NULL;
+   g_num_sampled = 0;
+}
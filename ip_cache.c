@@ -0,0 +1,282 @@
+#include "rbus_elements.h"
+#include <ifaddrs.h>
+#include <fnmatch.h>
+#include <netdb.h>
+#include <arpa/inet.h>
+#ifndef __APPLE__
+#include <linux/rtnetlink.h>
+#endif
+
+extern rbusHandle_t g_rbusHandle;
+extern DataElement* g_internalDataElements;
+extern int g_totalElements;
+
+typedef struct {
+   char target[MAX_NAME_LEN];
+   char** interfaces;          // fnmatch patterns in priority order; none means any interface
+   int num_interfaces;
+   int family;                 // AF_INET, AF_INET6 or AF_UNSPEC for IPv4 then IPv6
+} IpRoleRule;
+
+// One property served from the address cache. value is written by the resolver and
+// read by getters on rbus threads under the seq counter (odd while being written).
+typedef struct {
+   const char* name;
+   const IpRoleRule* rule;
+   char value[INET6_ADDRSTRLEN];
+   unsigned int seq;
+} IpRole;
+
+static IpRoleRule* g_ip_rules = NULL;
+static int g_num_ip_rules = 0;
+static IpRole* g_ip_roles = NULL;
+static int g_num_ip_roles = 0;
+static int g_resolving = 0;
+
+static const IpRoleRule g_default_rule = {.family = AF_INET};
+
+bool ip_role_add_rule(cJSON* item, int index) {
+   cJSON* target_obj = cJSON_GetObjectItem(item, "target");
+   cJSON* ifaces_obj = cJSON_GetObjectItem(item, "interfaces");
+   cJSON* family_obj = cJSON_GetObjectItem(item, "family");
+
+   if (!cJSON_IsString(target_obj)) {
+      fprintf(stderr, "IP role item %d needs a target\n", index);
+      return false;
+   }
+   if (ifaces_obj && !cJSON_IsArray(ifaces_obj)) {
+      fprintf(stderr, "IP role item %d: interfaces must be an array of names\n", index);
+      return false;
+   }
+
+   int family = AF_INET;
+   const char* family_str = cJSON_GetStringValue(family_obj);
+   if (family_str) {
+      if (strcmp(family_str, "ipv4") == 0) family = AF_INET;
+      else if (strcmp(family_str, "ipv6") == 0) family = AF_INET6;
+      else if (strcmp(family_str, "any") == 0) family = AF_UNSPEC;
+      else {
+         fprintf(stderr, "IP role item %d: unknown family %s\n", index, family_str);
+         return false;
+      }
+   }
+
+   IpRoleRule* rules = realloc(g_ip_rules, (g_num_ip_rules + 1) * sizeof(IpRoleRule));
+   if (!rules) {
+      fprintf(stderr, "Failed to allocate memory for IP role rules\n");
+      return false;
+   }
+   g_ip_rules = rules;
+   IpRoleRule* r = &g_ip_rules[g_num_ip_rules];
+   memset(r, 0, sizeof(IpRoleRule));
+   snprintf(r->target, MAX_NAME_LEN, "%s", cJSON_GetStringValue(target_obj));
+   r->family = family;
+
+   int n = ifaces_obj ? cJSON_GetArraySize(ifaces_obj) : 0;
+   if (n > 0) {
+      r->interfaces = calloc(n, sizeof(char*));
+      if (!r->interfaces) {
+         fprintf(stderr, "Failed to allocate memory for IP role rules\n");
+         return false;
+      }
+      cJSON* iface;
+      cJSON_ArrayForEach(iface, ifaces_obj) {
+         if (cJSON_IsString(iface) && (r->interfaces[r->num_interfaces] = strdup(iface->valuestring))) {
+            r->num_interfaces++;
+         }
+      }
+   }
+   g_num_ip_rules++;
+   return true;
+}
+
+static bool usable_address(const struct ifaddrs* ifa, int family) {
+   if (!ifa->ifa_addr || ifa->ifa_addr->sa_family != family) return false;
+   if (!(ifa->ifa_flags & IFF_UP) || (ifa->ifa_flags & IFF_LOOPBACK)) return false;
+
+   if (family == AF_INET) {
+      const struct sockaddr_in* sin = (const struct sockaddr_in*)ifa->ifa_addr;
+      return (ntohl(sin->sin_addr.s_addr) >> 24) != 127;
+   }
+   const struct sockaddr_in6* sin6 = (const struct sockaddr_in6*)ifa->ifa_addr;
+   return !IN6_IS_ADDR_LOOPBACK(&sin6->sin6_addr) && !IN6_IS_ADDR_LINKLOCAL(&sin6->sin6_addr);
+}
+
+static bool matches_interface(const IpRoleRule* rule, int pattern, const char* ifname) {
+   if (rule->num_interfaces == 0) return true;
+   return fnmatch(rule->interfaces[pattern], ifname, 0) == 0;
+}
+
+// Interface patterns take priority over family order, so "erouter0" with any family
+// beats an IPv4 address on a later pattern
+static void select_address(const IpRoleRule* rule, struct ifaddrs* ifas, char* out, size_t outlen) {
+   int families[2] = {rule->family == AF_UNSPEC ? AF_INET : rule->family, rule->family == AF_UNSPEC ? AF_INET6 : AF_UNSPEC};
+   int patterns = rule->num_interfaces > 0 ? rule->num_interfaces : 1;
+
+   out[0] = '\0';
+   for (int p = 0; p < patterns; p++) {
+      for (int f = 0; f < 2 && families[f] != AF_UNSPEC; f++) {
+         for (struct ifaddrs* ifa = ifas; ifa; ifa = ifa->ifa_next) {
+            if (!usable_address(ifa, families[f]) || !matches_interface(rule, p, ifa->ifa_name)) continue;
+            socklen_t len = families[f] == AF_INET ? sizeof(struct sockaddr_in) : sizeof(struct sockaddr_in6);
+            if (getnameinfo(ifa->ifa_addr, len, out, outlen, NULL, 0, NI_NUMERICHOST) == 0) {
+               return;
+            }
+            out[0] = '\0';
+         }
+      }
+   }
+}
+
+static void read_role(IpRole* role, char* out, size_t outlen) {
+   unsigned int seq;
+   do {
+      seq = __atomic_load_n(&role->seq, __ATOMIC_ACQUIRE);
+      snprintf(out, outlen, "%s", role->value);
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+   } while ((seq & 1) || seq != __atomic_load_n(&role->seq, __ATOMIC_RELAXED));
+}
+
+static void publish_role_change(const IpRole* role, const char* old_value, const char* new_value) {
+   rbusObject_t data;
+   rbusObject_Init(&data, NULL);
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, new_value);
+   rbusObject_SetValue(data, "value", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, old_value);
+   rbusObject_SetValue(data, "oldValue", val);
+   rbusValue_Release(val);
+
+   rbusEvent_t event = {.name = role->name, .type = RBUS_EVENT_VALUE_CHANGED, .data = data};
+   rbusError_t rc = rbusEvent_Publish(g_rbusHandle, &event);
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish value change for %s: %d\n", role->name, rc);
+   }
+   rbusObject_Release(data);
+}
+
+// Walk the interface addresses once and update every role; only runs when an address
+// or link notification arrives (or on each get when notifications are unavailable)
+static bool ip_cache_resolve(bool publish) {
+   if (__atomic_exchange_n(&g_resolving, 1, __ATOMIC_ACQUIRE)) {
+      return false;
+   }
+
+   struct ifaddrs* ifas = NULL;
+   if (getifaddrs(&ifas) != 0) {
+      __atomic_store_n(&g_resolving, 0, __ATOMIC_RELEASE);
+      return false;
+   }
+
+   for (int i = 0; i < g_num_ip_roles; i++) {
+      IpRole* role = &g_ip_roles[i];
+      char addr[INET6_ADDRSTRLEN];
+      select_address(role->rule, ifas, addr, sizeof(addr));
+      if (strcmp(addr, role->value) == 0) continue;
+
+      char old_value[INET6_ADDRSTRLEN];
+      memcpy(old_value, role->value, sizeof(old_value));
+      __atomic_fetch_add(&role->seq, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_RELEASE);
+      memcpy(role->value, addr, sizeof(role->value));
+      __atomic_fetch_add(&role->seq, 1, __ATOMIC_RELEASE);
+
+      if (publish) {
+         publish_role_change(role, old_value, addr);
+      }
+   }
+
+   freeifaddrs(ifas);
+   __atomic_store_n(&g_resolving, 0, __ATOMIC_RELEASE);
+   return true;
+}
+
+#ifndef __APPLE__
+static void ip_cache_notify(const struct nlmsghdr* nh, void* ctx) {
+   (void)ctx;
+   // Host-scope addresses are loopback and never selected
+   if (nh && (nh->nlmsg_type == RTM_NEWADDR || nh->nlmsg_type == RTM_DELADDR)) {
+      const struct ifaddrmsg* ifa = NLMSG_DATA(nh);
+      if (nh->nlmsg_len >= NLMSG_LENGTH(sizeof(*ifa)) && ifa->ifa_scope == RT_SCOPE_HOST) {
+         return;
+      }
+   }
+   ip_cache_resolve(true);
+}
+#endif
+
+bool ip_cache_get(const char* name, char* out, size_t outlen) {
+   for (int i = 0; i < g_num_ip_roles; i++) {
+      if (strcmp(g_ip_roles[i].name, name) == 0) {
+         if (!netlink_monitor_active()) {
+            ip_cache_resolve(false);
+         }
+         read_role(&g_ip_roles[i], out, outlen);
+         return true;
+      }
+   }
+   return false;
+}
+
+rbusError_t ip_cache_sub_handler(rbusHandle_t handle, rbusEventSubAction_t action, const char* eventName, rbusFilter_t filter, int32_t interval, bool* autoPublish) {
+   (void)handle; (void)action; (void)eventName; (void)filter; (void)interval;
+   // Changes are pushed from address notifications; rbus only needs to poll without them
+   *autoPublish = !netlink_monitor_active();
+   return RBUS_ERROR_SUCCESS;
+}
+
+void ip_cache_init(void) {
+   for (int i = 0; i < g_totalElements; i++) {
+      DataElement* de = &g_internalDataElements[i];
+      if (de->getHandler != get_first_ip) continue;
+
+      IpRole* roles = realloc(g_ip_roles, (g_num_ip_roles + 1) * sizeof(IpRole));
+      if (!roles) {
+         fprintf(stderr, "Failed to allocate memory for IP roles\n");
+         return;
+      }
+      g_ip_roles = roles;
+      IpRole* role = &g_ip_roles[g_num_ip_roles++];
+      memset(role, 0, sizeof(IpRole));
+      role->name = de->name;
+      role->rule = &g_default_rule;
+   }
+
+   for (int i = 0; i < g_num_ip_rules; i++) {
+      bool bound = false;
+      for (int j = 0; j < g_num_ip_roles; j++) {
+         if (strcmp(g_ip_roles[j].name, g_ip_rules[i].target) == 0) {
+            g_ip_roles[j].rule = &g_ip_rules[i];
+            bound = true;
+         }
+      }
+      if (!bound) {
+         fprintf(stderr, "IP role for unknown address property %s\n", g_ip_rules[i].target);
+      }
+   }
+
+#ifndef __APPLE__
+   netlink_add_listener(RTMGRP_LINK | RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR, ip_cache_notify, NULL);
+#endif
+   ip_cache_resolve(false);
+}
+
+void ip_cache_cleanup(void) {
+   for (int i = 0; i < g_num_ip_rules; i++) {
+      for (int j = 0; j < g_ip_rules[i].num_interfaces; j++) {
+         free(g_ip_rules[i].interfaces[j]);
+      }
+      free(g_ip_rules[i].interfaces);
+   }
+   free(g_ip_rules);
+   g_ip_rules = NULL;
+   g_num_ip_rules = 0;
+   free(g_ip_roles);
+   g_ip_roles = NULL;
+   g_num_ip_roles = 0;
+}
@@ -0,0 +1,148 @@
+#include "rbus_elements.h"
+
+// Single pass, non-allocating JSON well-formedness check. Nesting is tracked in a bit
+// stack (1 = object, 0 = array), which caps depth at JSON_SCAN_MAX_DEPTH.
+
+static const char* skip_ws(const char* p, const char* end) {
+   while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+   return p;
+}
+
+static bool is_hex(char c) {
+   return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+// p is at the opening quote; returns the position after the closing quote
+static const char* scan_string(const char* p, const char* end) {
+   for (p++; p < end; p++) {
+      unsigned char c = *p;
+      if (c == '"') {
+         return p + 1;
+      }
+      if (c < 0x20) {
+         return NULL;
+      }
+      if (c == '\\') {
+         if (++p >= end) return NULL;
+         switch (*p) {
+            case '"': case '\\': case '/': case 'b': case 'f': case 'n': case 'r': case 't':
+               break;
+            case 'u':
+               if (end - p < 5 || !is_hex(p[1]) || !is_hex(p[2]) || !is_hex(p[3]) || !is_hex(p[4])) {
+                  return NULL;
+               }
+               p += 4;
+               break;
+            default:
+               return NULL;
+         }
+      }
+   }
+   return NULL;
+}
+
+static const char* scan_digits(const char* p, const char* end) {
+   const char* start = p;
+   while (p < end && *p >= '0' && *p <= '9') p++;
+   return p > start ? p : NULL;
+}
+
+static const char* scan_number(const char* p, const char* end) {
+   if (p < end && *p == '-') p++;
+   if (p < end && *p == '0') {
+      p++;
+   } else if (!(p = scan_digits(p, end))) {
+      return NULL;
+   }
+   if (p < end && *p == '.' && !(p = scan_digits(p + 1, end))) {
+      return NULL;
+   }
+   if (p < end && (*p == 'e' || *p == 'E')) {
+      p++;
+      if (p < end && (*p == '+' || *p == '-')) p++;
+      p = scan_digits(p, end);
+   }
+   return p;
+}
+
+static const char* scan_literal(const char* p, const char* end, const char* lit, size_t len) {
+   return (size_t)(end - p) >= len && memcmp(p, lit, len) == 0 ? p + len : NULL;
+}
+
+// After '{' or ',' inside an object: "key" ws ':' ws
+static const char* scan_key(const char* p, const char* end) {
+   if (p >= end || *p != '"' || !(p = scan_string(p, end))) {
+      return NULL;
+   }
+   p = skip_ws(p, end);
+   if (p >= end || *p != ':') {
+      return NULL;
+   }
+   return skip_ws(p + 1, end);
+}
+
+bool json_scan(const char* json, size_t len) {
+   const char* p = json;
+   const char* end = json + len;
+   uint64_t objects = 0;
+   int depth = 0;
+
+   p = skip_ws(p, end);
+   for (;;) {
+      // A value is expected at p
+      if (p >= end) return false;
+      switch (*p) {
+         case '{':
+         case '[':
+            if (depth == JSON_SCAN_MAX_DEPTH) return false;
+            objects = (objects << 1) | (*p == '{');
+            depth++;
+            p = skip_ws(p + 1, end);
+            if (p < end && *p == ((objects & 1) ? '}' : ']')) {
+               // Empty container is a complete value, handled below
+               break;
+            }
+            if ((objects & 1) && !(p = scan_key(p, end))) return false;
+            continue;
+         case '"':
+            p = scan_string(p, end);
+            break;
+         case 't':
+            p = scan_literal(p, end, "true", 4);
+            break;
+         case 'f':
+            p = scan_literal(p, end, "false", 5);
+            break;
+         case 'n':
+            p = scan_literal(p, end, "null", 4);
+            break;
+         default:
+            p = scan_number(p, end);
+            break;
+      }
+      if (!p) return false;
+
+      // A value just ended: close containers until a ',' opens the next value
+      for (;;) {
+         p = skip_ws(p, end);
+         if (depth == 0) {
+            return p == end;
+         }
+         if (p >= end) {
+            return false;
+         }
+         if (*p == ((objects & 1) ? '}' : ']')) {
+            objects >>= 1;
+            depth--;
+            p++;
+            continue;
+         }
+         if (*p != ',') {
+            return false;
+         }
+         p = skip_ws(p + 1, end);
+         if ((objects & 1) && !(p = scan_key(p, end))) return false;
+         break;
+      }
+   }
+}
@@ -0,0 +1,409 @@
+#include "rbus_elements.h"
+
+// Methods declared in elements.json with "handler". Input and output schemas are compiled
+// at load time into a name -> index hash, so a call validates its arguments in one pass
+// over inParams and the handler receives them as an array in schema order.
+
+typedef struct {
+   MethodArg* args;
+   int count;
+   uint32_t required;                 // bit per required argument
+   uint8_t slots[METHOD_ARG_SLOTS];   // open addressing on name hash, index + 1, 0 = empty
+} ArgSchema;
+
+struct DeclaredMethod {
+   char* name;
+   DeclaredMethodFn fn;
+   ArgSchema in;
+   ArgSchema out;
+   char** paths;                      // snapshot handler
+   int num_paths;
+   const RbeHandler* plugin;          // plugin:<plugin>/<handler>
+};
+
+static DeclaredMethod* g_methods = NULL;
+static int g_num_methods = 0;
+
+static const char* const g_arg_type_names[] = {
+   "string", "int", "uint", "bool", "datetime", "base64", "long", "ulong", "float", "double", "byte", "object"
+};
+
+static uint32_t name_hash(const char* s) {
+   uint32_t h = 2166136261u;
+   while (*s) {
+      h ^= (uint8_t)*s++;
+      h *= 16777619u;
+   }
+   return h;
+}
+
+static int schema_find(const ArgSchema* s, const char* name) {
+   for (uint32_t i = name_hash(name);; i++) {
+      uint8_t slot = s->slots[i & (METHOD_ARG_SLOTS - 1)];
+      if (slot == 0) return -1;
+      if (strcmp(s->args[slot - 1].name, name) == 0) return slot - 1;
+   }
+}
+
+static bool arg_type_matches(const MethodArg* arg, rbusValue_t value) {
+   if (arg->type == METHOD_ARG_OBJECT) {
+      return rbusValue_GetType(value) == RBUS_OBJECT;
+   }
+   return value_type_matches((ValueType)arg->type, value);
+}
+
+static void method_error(rbusObject_t outParams, const char* fmt, const char* name) {
+   char msg[MAX_NAME_LEN + 64];
+   snprintf(msg, sizeof(msg), fmt, name);
+   rbusValue_t val = rbusValue_InitString(msg);
+   rbusObject_SetValue(outParams, "error", val);
+   rbusValue_Release(val);
+}
+
+static void schema_free(ArgSchema* s) {
+   for (int i = 0; i < s->count; i++) {
+      free(s->args[i].name);
+      free(s->args[i].target);
+   }
+   free(s->args);
+   memset(s, 0, sizeof(*s));
+}
+
+// "input"/"output": [{"name": "Delay", "type": 1, "required": true}, ...]; type is a
+// property type number or "object"
+static bool schema_compile(cJSON* list, ArgSchema* s, const char* what, int index) {
+   memset(s, 0, sizeof(*s));
+   if (!list) {
+      return true;
+   }
+   int count = cJSON_IsArray(list) ? cJSON_GetArraySize(list) : -1;
+   if (count < 0 || count > METHOD_MAX_ARGS) {
+      fprintf(stderr, "Method item %d: %s must be an array of at most %d arguments\n", index, what, METHOD_MAX_ARGS);
+      return false;
+   }
+   s->args = calloc(count ? count : 1, sizeof(MethodArg));
+   if (!s->args) {
+      fprintf(stderr, "Failed to allocate memory for method arguments\n");
+      return false;
+   }
+
+   for (int i = 0; i < count; i++) {
+      cJSON* arg = cJSON_GetArrayItem(list, i);
+      cJSON* name_obj = cJSON_GetObjectItem(arg, "name");
+      cJSON* type_obj = cJSON_GetObjectItem(arg, "type");
+      cJSON* target_obj = cJSON_GetObjectItem(arg, "target");
+      MethodArg* a = &s->args[s->count];
+
+      if (!cJSON_IsString(name_obj) || !*cJSON_GetStringValue(name_obj)) {
+         fprintf(stderr, "Method item %d: %s argument %d needs a name\n", index, what, i);
+         goto fail;
+      }
+      if (cJSON_IsNumber(type_obj) && type_obj->valuedouble >= 0 && type_obj->valuedouble <= TYPE_BYTE) {
+         a->type = (int)type_obj->valuedouble;
+      } else if (cJSON_IsString(type_obj) && strcmp(cJSON_GetStringValue(type_obj), "object") == 0) {
+         a->type = METHOD_ARG_OBJECT;
+      } else {
+         fprintf(stderr, "Method item %d: invalid type for %s argument %s\n", index, what, cJSON_GetStringValue(name_obj));
+         goto fail;
+      }
+      if (schema_find(s, cJSON_GetStringValue(name_obj)) >= 0) {
+         fprintf(stderr, "Method item %d: duplicate %s argument %s\n", index, what, cJSON_GetStringValue(name_obj));
+         goto fail;
+      }
+
+      a->name = strdup(cJSON_GetStringValue(name_obj));
+      a->target = cJSON_IsString(target_obj) ? strdup(cJSON_GetStringValue(target_obj)) : NULL;
+      s->count++;
+      if (!a->name || (cJSON_IsString(target_obj) && !a->target)) {
+         fprintf(stderr, "Failed to allocate memory for method arguments\n");
+         goto fail;
+      }
+      a->required = cJSON_IsTrue(cJSON_GetObjectItem(arg, "required"));
+      if (a->required) {
+         s->required |= 1u << i;
+      }
+
+      uint32_t h = name_hash(a->name);
+      while (s->slots[h & (METHOD_ARG_SLOTS - 1)]) h++;
+      s->slots[h & (METHOD_ARG_SLOTS - 1)] = (uint8_t)(i + 1);
+   }
+   return true;
+
+fail:
+   schema_free(s);
+   return false;
+}
+
+// echo: every input that is also a declared output (or all inputs without an output schema)
+static rbusError_t method_echo(const DeclaredMethod* m, rbusValue_t const* args, rbusObject_t outParams) {
+   for (int i = 0; i < m->in.count; i++) {
+      if (args[i] && (m->out.count == 0 || schema_find(&m->out, m->in.args[i].name) >= 0)) {
+         rbusObject_SetValue(outParams, m->in.args[i].name, args[i]);
+      }
+   }
+   return RBUS_ERROR_SUCCESS;
+}
+
+// setMany: each input is written to its "target" property; all targets are resolved and
+// type checked before anything is written
+static rbusError_t method_set_many(const DeclaredMethod* m, rbusValue_t const* args, rbusObject_t outParams) {
+   SetTarget targets[METHOD_MAX_ARGS];
+   ElementValue values[METHOD_MAX_ARGS];
+   uint32_t count = 0;
+
+   model_lock();
+   // Resolve every target without creating anything, so a rejected call leaves the model untouched
+   for (int i = 0; i < m->in.count; i++) {
+      if (!args[i]) continue;
+      rbusError_t rc = set_resolve(m->in.args[i].target, args[i], false, &targets[i]);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         model_unlock();
+         method_error(outParams, "%s cannot be written to its target", m->in.args[i].name);
+         return rc;
+      }
+   }
+   // Then create the row properties written for the first time; only allocation can fail
+   for (int i = 0; i < m->in.count; i++) {
+      if (!args[i] || targets[i].de || targets[i].prop) continue;
+      rbusError_t rc = set_resolve(m->in.args[i].target, args[i], true, &targets[i]);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         model_unlock();
+         return rc;
+      }
+   }
+   for (int i = 0; i < m->in.count; i++) {
+      if (!args[i]) continue;
+      if (value_from_rbus(targets[i].type, args[i], &values[i]) != RBUS_ERROR_SUCCESS) {
+         for (int j = 0; j < i; j++) {
+            if (args[j] && IS_STRING_TYPE(targets[j].type)) free(values[j].strVal);
+         }
+         model_unlock();
+         return RBUS_ERROR_OUT_OF_RESOURCES;
+      }
+   }
+   for (int i = 0; i < m->in.count; i++) {
+      if (!args[i]) continue;
+      set_apply(m->in.args[i].target, &targets[i], &values[i], args[i]);
+      count++;
+   }
+   model_unlock();
+
+   rbusValue_t val = rbusValue_InitUInt32(count);
+   rbusObject_SetValue(outParams, "Count", val);
+   rbusValue_Release(val);
+   return RBUS_ERROR_SUCCESS;
+}
+
+typedef struct {
+   rbusObject_t values;
+   uint32_t count;
+} SnapshotCtx;
+
+static void snapshot_value(const ModelEntry* entry, void* ctx) {
+   SnapshotCtx* c = (SnapshotCtx*)ctx;
+   rbusValue_t value;
+   if (model_entry_value(entry, &value) != RBUS_ERROR_SUCCESS) {
+      return;
+   }
+   rbusObject_SetValue(c->values, entry->name, value);
+   rbusValue_Release(value);
+   c->count++;
+}
+
+// snapshot: current values of the configured "paths", in one model walk
+static rbusError_t method_snapshot(const DeclaredMethod* m, rbusValue_t const* args, rbusObject_t outParams) {
+   (void)args;
+   bool found[METHOD_MAX_ARGS];
+   SnapshotCtx ctx = {.count = 0};
+   rbusObject_Init(&ctx.values, NULL);
+   model_lock();
+   model_walk_paths((const char* const*)m->paths, m->num_paths, found, snapshot_value, &ctx);
+   model_unlock();
+
+   rbusValue_t val = rbusValue_InitUInt32(ctx.count);
+   rbusObject_SetValue(outParams, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, ctx.values);
+   rbusObject_SetValue(outParams, "Values", val);
+   rbusValue_Release(val);
+   rbusObject_Release(ctx.values);
+   return RBUS_ERROR_SUCCESS;
+}
+
+// plugin:<plugin>/<handler>: a method handler from a loaded plugin, outputs in schema order
+static rbusError_t method_plugin(const DeclaredMethod* m, rbusValue_t const* args, rbusObject_t outParams) {
+   return plugin_call_method(m->plugin, m->name, args, m->in.count, m->out.args, m->out.count, outParams);
+}
+
+static const struct {
+   const char* name;
+   DeclaredMethodFn fn;
+} g_method_handlers[] = {
+   {"echo", method_echo},
+   {"setMany", method_set_many},
+   {"snapshot", method_snapshot},
+};
+
+static DeclaredMethodFn resolve_handler(const char* name) {
+   for (size_t i = 0; i < sizeof(g_method_handlers) / sizeof(g_method_handlers[0]); i++) {
+      if (strcmp(g_method_handlers[i].name, name) == 0) {
+         return g_method_handlers[i].fn;
+      }
+   }
+   return NULL;
+}
+
+static void method_free(DeclaredMethod* m) {
+   free(m->name);
+   schema_free(&m->in);
+   schema_free(&m->out);
+   for (int i = 0; i < m->num_paths; i++) {
+      free(m->paths[i]);
+   }
+   free(m->paths);
+}
+
+bool method_add(cJSON* item, const char* name, int index) {
+   cJSON* handler_obj = cJSON_GetObjectItem(item, "handler");
+   cJSON* paths_obj = cJSON_GetObjectItem(item, "paths");
+   if (!cJSON_IsString(handler_obj)) {
+      fprintf(stderr, "Method item %d: handler must be a string\n", index);
+      return false;
+   }
+
+   DeclaredMethod m = {0};
+   const char* handler = cJSON_GetStringValue(handler_obj);
+   if (strncmp(handler, "plugin:", 7) == 0) {
+      m.plugin = plugin_find_handler(handler + 7);
+      m.fn = m.plugin && m.plugin->method ? method_plugin : NULL;
+   } else {
+      m.fn = resolve_handler(handler);
+   }
+   if (!m.fn) {
+      fprintf(stderr, "Method item %d: unknown handler '%s'\n", index, cJSON_GetStringValue(handler_obj));
+      return false;
+   }
+   if (!schema_compile(cJSON_GetObjectItem(item, "input"), &m.in, "input", index) ||
+      !schema_compile(cJSON_GetObjectItem(item, "output"), &m.out, "output", index)) {
+      method_free(&m);
+      return false;
+   }
+
+   if (m.fn == method_set_many) {
+      for (int i = 0; i < m.in.count; i++) {
+         if (!m.in.args[i].target) {
+            fprintf(stderr, "Method item %d: setMany input %s needs a target\n", index, m.in.args[i].name);
+            method_free(&m);
+            return false;
+         }
+      }
+   }
+   if (m.fn == method_snapshot) {
+      int count = cJSON_IsArray(paths_obj) ? cJSON_GetArraySize(paths_obj) : 0;
+      if (count == 0 || count > METHOD_MAX_ARGS) {
+         fprintf(stderr, "Method item %d: snapshot needs 1 to %d paths\n", index, METHOD_MAX_ARGS);
+         method_free(&m);
+         return false;
+      }
+      m.paths = calloc(count, sizeof(char*));
+      for (int i = 0; m.paths && i < count; i++) {
+         cJSON* path = cJSON_GetArrayItem(paths_obj, i);
+         if (!cJSON_IsString(path) || !(m.paths[m.num_paths++] = strdup(cJSON_GetStringValue(path)))) {
+            fprintf(stderr, "Method item %d: invalid path %d\n", index, i);
+            method_free(&m);
+            return false;
+         }
+      }
+      if (!m.paths) {
+         fprintf(stderr, "Failed to allocate memory for method paths\n");
+         method_free(&m);
+         return false;
+      }
+   }
+
+   DeclaredMethod* methods = realloc(g_methods, (g_num_methods + 1) * sizeof(DeclaredMethod));
+   if (!methods || !(m.name = strdup(name))) {
+      fprintf(stderr, "Failed to allocate memory for methods\n");
+      if (methods) g_methods = methods;
+      method_free(&m);
+      return false;
+   }
+   g_methods = methods;
+   g_methods[g_num_methods++] = m;
+   return true;
+}
+
+rbusError_t declared_method_handler(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
+   (void)handle; (void)asyncHandle;
+
+   const DeclaredMethod* m = NULL;
+   for (int i = 0; i < g_num_methods && !m; i++) {
+      if (strcmp(g_methods[i].name, methodName) == 0) m = &g_methods[i];
+   }
+   if (!m) {
+      return RBUS_ERROR_INVALID_METHOD;
+   }
+
+   // One pass over the supplied arguments: look each up in the compiled schema and type check it
+   rbusValue_t args[METHOD_MAX_ARGS] = {0};
+   uint32_t seen = 0;
+   for (rbusProperty_t prop = inParams ? rbusObject_GetProperties(inParams) : NULL; prop; prop = rbusProperty_GetNext(prop)) {
+      const char* name = rbusProperty_GetName(prop);
+      int i = schema_find(&m->in, name);
+      if (i < 0) {
+         method_error(outParams, "Unknown argument %s", name);
+         return RBUS_ERROR_INVALID_INPUT;
+      }
+      rbusValue_t value = rbusProperty_GetValue(prop);
+      if (!value || !arg_type_matches(&m->in.args[i], value)) {
+         char fmt[64];
+         snprintf(fmt, sizeof(fmt), "%%s must be of type %s", g_arg_type_names[m->in.args[i].type]);
+         method_error(outParams, fmt, name);
+         return RBUS_ERROR_INVALID_INPUT;
+      }
+      args[i] = value;
+      seen |= 1u << i;
+   }
+   if ((seen & m->in.required) != m->in.required) {
+      for (int i = 0; i < m->in.count; i++) {
+         if ((m->in.required & ~seen) & (1u << i)) {
+            method_error(outParams, "%s is required", m->in.args[i].name);
+            break;
+         }
+      }
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   rbusError_t rc = m->fn(m, args, outParams);
+   if (rc != RBUS_ERROR_SUCCESS || m->out.count == 0) {
+      return rc;
+   }
+
+   // Handlers (plugins included) must honour the declared output schema
+   seen = 0;
+   for (rbusProperty_t prop = rbusObject_GetProperties(outParams); prop; prop = rbusProperty_GetNext(prop)) {
+      int i = schema_find(&m->out, rbusProperty_GetName(prop));
+      if (i < 0) continue;
+      if (!arg_type_matches(&m->out.args[i], rbusProperty_GetValue(prop))) {
+         fprintf(stderr, "%s returned %s with the wrong type\n", methodName, m->out.args[i].name);
+         return RBUS_ERROR_BUS_ERROR;
+      }
+      seen |= 1u << i;
+   }
+   if ((seen & m->out.required) != m->out.required) {
+      fprintf(stderr, "%s did not return all required outputs\n", methodName);
+      return RBUS_ERROR_BUS_ERROR;
+   }
+   return RBUS_ERROR_SUCCESS;
+}
+
+void method_schema_cleanup(void) {
+   for (int i = 0; i < g_num_methods; i++) {
+      method_free(&g_methods[i]);
+   }
+   free(g_methods);
+   g_methods = NULL;
+   g_num_methods = 0;
+}
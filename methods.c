@@ -1,5 +1,12 @@
 #include "rbus_elements.h"
-#include <jansson.h>
+
+static void set_error(rbusObject_t outParams, const char* msg) {
+   rbusValue_t errorVal;
+   rbusValue_Init(&errorVal);
+   rbusValue_SetString(errorVal, msg);
+   rbusObject_SetValue(outParams, "error", errorVal);
+   rbusValue_Release(errorVal);
+}
 
 static bool is_check(rbusObject_t obj) {
    rbusProperty_t prop = rbusObject_GetProperties(obj);
@@ -13,6 +20,66 @@ static bool is_check(rbusObject_t obj) {
    return false;
 }
 
+typedef struct {
+   uint64_t since;
+   rbusObject_t values;
+   rbusObject_t versions;
+   uint32_t count;
+} IfModifiedCtx;
+
+static bool get_version_arg(rbusValue_t val, uint64_t* out) {
+   switch (val ? rbusValue_GetType(val) : RBUS_NONE) {
+      case RBUS_UINT64: *out = rbusValue_GetUInt64(val); return true;
+      case RBUS_INT64: *out = (uint64_t)rbusValue_GetInt64(val); return rbusValue_GetInt64(val) >= 0;
+      case RBUS_UINT32: *out = rbusValue_GetUInt32(val); return true;
+      case RBUS_INT32: *out = (uint64_t)rbusValue_GetInt32(val); return rbusValue_GetInt32(val) >= 0;
+      default: return false;
+   }
+}
+
+static void collect_if_modified(const ModelEntry* entry, void* ctx) {
+   IfModifiedCtx* c = (IfModifiedCtx*)ctx;
+   // Live properties and provider rows carry no version and are always reported
+   if (!entry->live && entry->version <= c->since) {
+      return;
+   }
+
+   rbusValue_t value;
+   if (model_entry_value(entry, &value) != RBUS_ERROR_SUCCESS) {
+      return;
+   }
+   rbusObject_SetValue(c->values, entry->name, value);
+   rbusValue_Release(value);
+
+   rbusValue_Init(&value);
+   rbusValue_SetUInt64(value, entry->version);
+   rbusObject_SetValue(c->versions, entry->name, value);
+   rbusValue_Release(value);
+   c->count++;
+}
+
+typedef struct {
+   rbusObject_t values;
+   rbusObject_t errors;
+   uint32_t count;
+} GetValuesCtx;
+
+static void collect_value(const ModelEntry* entry, void* ctx) {
+   GetValuesCtx* c = (GetValuesCtx*)ctx;
+   rbusValue_t value;
+   rbusError_t rc = model_entry_value(entry, &value);
+   if (rc != RBUS_ERROR_SUCCESS) {
+      rbusValue_Init(&value);
+      rbusValue_SetInt32(value, rc);
+      rbusObject_SetValue(c->errors, entry->name, value);
+      rbusValue_Release(value);
+      return;
+   }
+   rbusObject_SetValue(c->values, entry->name, value);
+   rbusValue_Release(value);
+   c->count++;
+}
+
 void registerMethod(rbusHandle_t handle, const DataElement* method) {
    rbusDataElement_t element = {(char*)method->name, RBUS_ELEMENT_TYPE_METHOD, {0}}; /* zero init cbTable */
    /* Assign method handler post-init to avoid pedantic warning in aggregate initializer */
@@ -68,37 +135,35 @@ rbusError_t system_reboot_method(rbusHandle_t handle, const char* methodName, rb
 }
 
 rbusError_t get_system_info_method(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
-   (void)methodName; (void)inParams; (void)asyncHandle;
-   rbusValue_t serialVal, timeVal, uptimeVal;
-   rbusValue_Init(&serialVal);
-   rbusValue_Init(&timeVal);
-   rbusValue_Init(&uptimeVal);
-
-   rbusProperty_t serialProp = rbusProperty_Init(NULL, "Device.DeviceInfo.SerialNumber", NULL);
-   rbusProperty_t timeProp = rbusProperty_Init(NULL, "Device.DeviceInfo.X_RDKCENTRAL-COM_SystemTime", NULL);
-   rbusProperty_t uptimeProp = rbusProperty_Init(NULL, "Device.DeviceInfo.UpTime", NULL);
-
-   rbusGetHandlerOptions_t opts = {.context = NULL, .requestingComponent = NULL};
-   get_system_serial_number(handle, serialProp, &opts);
-   get_system_time(handle, timeProp, &opts);
-   get_system_uptime(handle, uptimeProp, &opts);
-
-   rbusObject_SetValue(outParams, "SerialNumber", rbusProperty_GetValue(serialProp));
-   rbusObject_SetValue(outParams, "SystemTime", rbusProperty_GetValue(timeProp));
-   rbusObject_SetValue(outParams, "UpTime", rbusProperty_GetValue(uptimeProp));
-
-   rbusProperty_Release(serialProp);
-   rbusProperty_Release(timeProp);
-   rbusProperty_Release(uptimeProp);
-   rbusValue_Release(serialVal);
-   rbusValue_Release(timeVal);
-   rbusValue_Release(uptimeVal);
+   (void)handle; (void)methodName; (void)inParams; (void)asyncHandle;
+
+   // All three values come from one DeviceInfo snapshot, the same one the getters read
+   DeviceInfoSnapshot snap;
+   device_info_snapshot(&snap);
+
+   rbusValue_t value;
+   char time_str[32];
+   if (snap.valid & DEVICE_INFO_HAS_SERIAL) {
+      value = rbusValue_InitString(snap.serial);
+      rbusObject_SetValue(outParams, "SerialNumber", value);
+      rbusValue_Release(value);
+   }
+   if (device_info_system_time(&snap, time_str, sizeof(time_str)) > 0) {
+      value = rbusValue_InitString(time_str);
+      rbusObject_SetValue(outParams, "SystemTime", value);
+      rbusValue_Release(value);
+   }
+   if (snap.valid & DEVICE_INFO_HAS_UPTIME) {
+      value = rbusValue_InitUInt32(snap.uptime);
+      rbusObject_SetValue(outParams, "UpTime", value);
+      rbusValue_Release(value);
+   }
 
    return RBUS_ERROR_SUCCESS;
 }
 
 rbusError_t device_telemetry_collect(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
-   (void)handle; (void)asyncHandle;
+   (void)handle; (void)methodName; (void)asyncHandle;
 
    if (is_check(inParams)) {
       return RBUS_ERROR_SUCCESS;
@@ -159,117 +224,75 @@ rbusError_t device_telemetry_collect(rbusHandle_t handle, const char* methodName
       return RBUS_ERROR_INVALID_INPUT;
    }
 
-   // Extract optional parameters
-   const char* source = rbusValue_GetString(sourceVal, NULL);
-   const char* dest = rbusValue_GetString(destVal, NULL);
-   const char* content_type = NULL;
-   rbusValue_t contentTypeVal = rbusObject_GetValue(inParams, "content_type");
-   if (contentTypeVal && rbusValue_GetType(contentTypeVal) == RBUS_STRING) {
-      content_type = rbusValue_GetString(contentTypeVal, NULL);
-   }
-
-   rbusValue_t partnerIdsVal = rbusObject_GetValue(inParams, "partner_ids");
-   rbusValue_t headersVal = rbusObject_GetValue(inParams, "headers");
-   rbusValue_t metadataVal = rbusObject_GetValue(inParams, "metadata");
-   rbusValue_t payloadVal = rbusObject_GetValue(inParams, "payload");
-   rbusValue_t sessionIdVal = rbusObject_GetValue(inParams, "session_id");
-   rbusValue_t transactionUuidVal = rbusObject_GetValue(inParams, "transaction_uuid");
    rbusValue_t qosVal = rbusObject_GetValue(inParams, "qos");
    rbusValue_t rdrVal = rbusObject_GetValue(inParams, "rdr");
+   bool has_qos = qosVal && rbusValue_GetType(qosVal) == RBUS_INT32;
+   int32_t qos = has_qos ? rbusValue_GetInt32(qosVal) : 0;
 
-   // Log the event (in a real implementation, this would forward to Xmidt)
-   fprintf(stderr, "\nEvent Received:\n");
-   fprintf(stderr, "  Method: %s\n", methodName);
-   fprintf(stderr, "  msg_type: %s\n", msg_type_str);
-   fprintf(stderr, "  source: %s\n", source);
-   fprintf(stderr, "  dest: %s\n", dest);
-   if (content_type) fprintf(stderr, "  content_type: %s\n", content_type);
-
-   if (partnerIdsVal && rbusValue_GetType(partnerIdsVal) == RBUS_OBJECT) {
-      rbusObject_t partnerIdsObj = rbusValue_GetObject(partnerIdsVal);
-      if (partnerIdsObj) {
-         fprintf(stderr, "  partner_ids: [");
-         rbusProperty_t prop = rbusObject_GetProperties(partnerIdsObj);
-         bool first = true;
-         while (prop) {
-            rbusValue_t val = rbusProperty_GetValue(prop);
-            if (val && rbusValue_GetType(val) == RBUS_STRING) {
-               fprintf(stderr, "%s%s", first ? "" : ", ", rbusValue_GetString(val, NULL));
-               first = false;
-            }
-            prop = rbusProperty_GetNext(prop);
-         }
-         fprintf(stderr, "]\n");
+   // Optional payload validation, a structural scan unless full decoding is configured
+   rbusValue_t payloadVal = rbusObject_GetValue(inParams, "payload");
+   bool payload_json = false;
+   if (payloadVal && rbusValue_GetType(payloadVal) == RBUS_STRING) {
+      const char* payload = rbusValue_GetString(payloadVal, NULL);
+      if (payload && !telemetry_payload_check(payload, strlen(payload), &payload_json)) {
+         set_error(outParams, "payload must be valid JSON");
+         return RBUS_ERROR_INVALID_INPUT;
       }
    }
 
-   if (headersVal && rbusValue_GetType(headersVal) == RBUS_OBJECT) {
-      rbusObject_t headersObj = rbusValue_GetObject(headersVal);
-      if (headersObj) {
-         fprintf(stderr, "  headers: [");
-         rbusProperty_t prop = rbusObject_GetProperties(headersObj);
-         bool first = true;
-         while (prop) {
-            rbusValue_t val = rbusProperty_GetValue(prop);
-            if (val && rbusValue_GetType(val) == RBUS_STRING) {
-               fprintf(stderr, "%s%s", first ? "" : ", ", rbusValue_GetString(val, NULL));
-               first = false;
-            }
-            prop = rbusProperty_GetNext(prop);
-         }
-         fprintf(stderr, "]\n");
-      }
+   // Copy the event into the telemetry ring; formatting and delivery happen on its consumer thread
+   TelemetryEvent* ev = telemetry_claim(qos);
+   if (!ev) {
+      set_error(outParams, "Telemetry queue full, event dropped");
+      return RBUS_ERROR_OUT_OF_RESOURCES;
    }
-
-   if (metadataVal && rbusValue_GetType(metadataVal) == RBUS_OBJECT) {
-      rbusObject_t metadataObj = rbusValue_GetObject(metadataVal);
-      if (metadataObj) {
-         fprintf(stderr, "  metadata: {");
-         rbusProperty_t prop = rbusObject_GetProperties(metadataObj);
-         bool first = true;
-         while (prop) {
-            const char* key = rbusProperty_GetName(prop);
-            rbusValue_t val = rbusProperty_GetValue(prop);
-            if (key && val && rbusValue_GetType(val) == RBUS_STRING) {
-               fprintf(stderr, "%s%s: %s", first ? "" : ", ", key, rbusValue_GetString(val, NULL));
-               first = false;
-            }
-            prop = rbusProperty_GetNext(prop);
-         }
-         fprintf(stderr, "}\n");
+   ev->simple_event = strcmp(msg_type_str, "event") == 0;
+   ev->payload_json = payload_json;
+   bool fits = telemetry_put(ev, TELEMETRY_SOURCE, rbusValue_GetString(sourceVal, NULL)) &&
+      telemetry_put(ev, TELEMETRY_DEST, rbusValue_GetString(destVal, NULL));
+
+   static const struct {
+      const char* name;
+      TelemetryField field;
+   } strings[] = {
+      {"content_type", TELEMETRY_CONTENT_TYPE},
+      {"session_id", TELEMETRY_SESSION_ID},
+      {"transaction_uuid", TELEMETRY_TRANSACTION_UUID},
+      {"payload", TELEMETRY_PAYLOAD},
+   };
+   for (size_t i = 0; fits && i < sizeof(strings) / sizeof(strings[0]); i++) {
+      rbusValue_t val = rbusObject_GetValue(inParams, strings[i].name);
+      if (val && rbusValue_GetType(val) == RBUS_STRING) {
+         fits = telemetry_put(ev, strings[i].field, rbusValue_GetString(val, NULL));
       }
    }
 
-   if (sessionIdVal && rbusValue_GetType(sessionIdVal) == RBUS_STRING) {
-      fprintf(stderr, "  session_id: %s\n", rbusValue_GetString(sessionIdVal, NULL));
-   }
-   if (transactionUuidVal && rbusValue_GetType(transactionUuidVal) == RBUS_STRING) {
-      fprintf(stderr, "  transaction_uuid: %s\n", rbusValue_GetString(transactionUuidVal, NULL));
-   }
-   if (qosVal && rbusValue_GetType(qosVal) == RBUS_INT32) {
-      int32_t qos = rbusValue_GetInt32(qosVal);
-      if (qos >= 0 && qos <= 99) {
-         fprintf(stderr, "  qos: %d\n", qos);
-      } else {
-         fprintf(stderr, "  qos: %d (invalid, must be 0-99)\n", qos);
+   static const struct {
+      const char* name;
+      TelemetryField field;
+      bool keys;
+   } objects[] = {
+      {"partner_ids", TELEMETRY_PARTNER_IDS, false},
+      {"headers", TELEMETRY_HEADERS, false},
+      {"metadata", TELEMETRY_METADATA, true},
+   };
+   for (size_t i = 0; fits && i < sizeof(objects) / sizeof(objects[0]); i++) {
+      rbusValue_t val = rbusObject_GetValue(inParams, objects[i].name);
+      if (val && rbusValue_GetType(val) == RBUS_OBJECT && rbusValue_GetObject(val)) {
+         fits = telemetry_put_object(ev, objects[i].field, rbusValue_GetObject(val), objects[i].keys);
       }
    }
-   if (rdrVal && rbusValue_GetType(rdrVal) == RBUS_INT32) {
-      fprintf(stderr, "  rdr: %d\n", rbusValue_GetInt32(rdrVal));
-   }
 
-   if (payloadVal && rbusValue_GetType(payloadVal) == RBUS_STRING) {
-      const char* payload = rbusValue_GetString(payloadVal, NULL);
-      json_error_t error;
-      json_t* obj = json_loads(payload, 0, &error);
-      if (obj) {
-         fprintf(stderr, "payload:\n");
-         json_dumpf(obj, stderr, JSON_INDENT(2));         
-         json_decref(obj);
-         fprintf(stderr, "\n\n");
-      } else {
-         fprintf(stderr, "  payload: %s\n\n", payload);
-      }
+   ev->has_qos = has_qos;
+   ev->qos = qos;
+   ev->has_rdr = rdrVal && rbusValue_GetType(rdrVal) == RBUS_INT32;
+   ev->rdr = ev->has_rdr ? rbusValue_GetInt32(rdrVal) : 0;
+   ev->valid = fits;
+   telemetry_commit(ev);
+
+   if (!fits) {
+      set_error(outParams, "Event too large");
+      return RBUS_ERROR_INVALID_INPUT;
    }
 
    // Set response
@@ -279,14 +302,217 @@ rbusError_t device_telemetry_collect(rbusHandle_t handle, const char* methodName
    rbusObject_SetValue(outParams, "status", resultVal);
    rbusValue_Release(resultVal);
 
-#if 0   
-   // Publish an RBUS event to simulate Xmidt event forwarding
-   rbusEvent_t event = {.name = dest, .type = RBUS_EVENT_GENERAL, .data = inParams};
-   rbusError_t rc = rbusEvent_Publish(handle, &event);
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t get_if_modified_method(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
+   (void)handle; (void)methodName; (void)asyncHandle;
+
+   uint64_t since = 0;
+   rbusValue_t sinceVal = rbusObject_GetValue(inParams, "Since");
+   if (sinceVal && !get_version_arg(sinceVal, &since)) {
+      set_error(outParams, "Since must be a non-negative integer");
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   rbusValue_t pathsVal = rbusObject_GetValue(inParams, "Paths");
+   rbusValueType_t paths_type = pathsVal ? rbusValue_GetType(pathsVal) : RBUS_NONE;
+   if (paths_type != RBUS_STRING && paths_type != RBUS_OBJECT) {
+      set_error(outParams, "Paths must be a comma separated string or an object of path:version");
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   IfModifiedCtx ctx = {.since = since, .count = 0};
+   rbusObject_Init(&ctx.values, NULL);
+   rbusObject_Init(&ctx.versions, NULL);
+
+   model_lock();
+   if (paths_type == RBUS_STRING) {
+      char* paths = strdup(rbusValue_GetString(pathsVal, NULL));
+      if (!paths) {
+         model_unlock();
+         rbusObject_Release(ctx.values);
+         rbusObject_Release(ctx.versions);
+         return RBUS_ERROR_OUT_OF_RESOURCES;
+      }
+      char* save = NULL;
+      for (char* path = strtok_r(paths, ",", &save); path; path = strtok_r(NULL, ",", &save)) {
+         while (*path == ' ') path++;
+         if (*path) model_walk(path, collect_if_modified, &ctx);
+      }
+      free(paths);
+   } else {
+      // Each property name is a path; a numeric value overrides Since for that path
+      rbusProperty_t prop = rbusObject_GetProperties(rbusValue_GetObject(pathsVal));
+      for (; prop; prop = rbusProperty_GetNext(prop)) {
+         ctx.since = since;
+         get_version_arg(rbusProperty_GetValue(prop), &ctx.since);
+         model_walk(rbusProperty_GetName(prop), collect_if_modified, &ctx);
+      }
+   }
+   uint64_t version = changelog_version();
+   model_unlock();
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetUInt64(val, version);
+   rbusObject_SetValue(outParams, "Version", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, ctx.count);
+   rbusObject_SetValue(outParams, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, ctx.values);
+   rbusObject_SetValue(outParams, "Values", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, ctx.versions);
+   rbusObject_SetValue(outParams, "Versions", val);
+   rbusValue_Release(val);
+
+   rbusObject_Release(ctx.values);
+   rbusObject_Release(ctx.versions);
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t get_values_method(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
+   (void)handle; (void)methodName; (void)asyncHandle;
+
+   rbusValue_t pathsVal = rbusObject_GetValue(inParams, "Paths");
+   rbusValueType_t paths_type = pathsVal ? rbusValue_GetType(pathsVal) : RBUS_NONE;
+   if (paths_type != RBUS_STRING && paths_type != RBUS_OBJECT) {
+      set_error(outParams, "Paths must be a comma separated string or an object keyed by path");
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   // Collect every requested path first so the model is walked once for all of them
+   char* buf = NULL;
+   int count = 0;
+   rbusProperty_t props = NULL;
+   if (paths_type == RBUS_STRING) {
+      buf = strdup(rbusValue_GetString(pathsVal, NULL));
+      if (!buf) return RBUS_ERROR_OUT_OF_RESOURCES;
+      count = 1;
+      for (const char* c = buf; *c; c++) {
+         if (*c == ',') count++;
+      }
+   } else {
+      props = rbusObject_GetProperties(rbusValue_GetObject(pathsVal));
+      for (rbusProperty_t prop = props; prop; prop = rbusProperty_GetNext(prop)) {
+         count++;
+      }
+   }
+
+   const char** paths = calloc(count ? count : 1, sizeof(char*));
+   bool* found = calloc(count ? count : 1, sizeof(bool));
+   if (!paths || !found) {
+      free(paths);
+      free(found);
+      free(buf);
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+
+   int n = 0;
+   if (buf) {
+      char* save = NULL;
+      for (char* path = strtok_r(buf, ",", &save); path; path = strtok_r(NULL, ",", &save)) {
+         while (*path == ' ') path++;
+         if (*path) paths[n++] = path;
+      }
+   } else {
+      for (rbusProperty_t prop = props; prop; prop = rbusProperty_GetNext(prop)) {
+         paths[n++] = rbusProperty_GetName(prop);
+      }
+   }
+
+   GetValuesCtx ctx = {.count = 0};
+   rbusObject_Init(&ctx.values, NULL);
+   rbusObject_Init(&ctx.errors, NULL);
+   model_lock();
+   model_walk_paths(paths, n, found, collect_value, &ctx);
+   model_unlock();
+
+   rbusValue_t val;
+   for (int i = 0; i < n; i++) {
+      if (found[i]) continue;
+      rbusValue_Init(&val);
+      rbusValue_SetInt32(val, RBUS_ERROR_ELEMENT_DOES_NOT_EXIST);
+      rbusObject_SetValue(ctx.errors, paths[i], val);
+      rbusValue_Release(val);
+   }
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, ctx.count);
+   rbusObject_SetValue(outParams, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, ctx.values);
+   rbusObject_SetValue(outParams, "Values", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, ctx.errors);
+   rbusObject_SetValue(outParams, "Errors", val);
+   rbusValue_Release(val);
+
+   rbusObject_Release(ctx.values);
+   rbusObject_Release(ctx.errors);
+   free(paths);
+   free(found);
+   free(buf);
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t add_rows_method(rbusHandle_t handle, const char* methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle) {
+   (void)methodName; (void)asyncHandle;
+
+   rbusValue_t tableVal = rbusObject_GetValue(inParams, "Table");
+   rbusValue_t rowsVal = rbusObject_GetValue(inParams, "Rows");
+   if (!tableVal || rbusValue_GetType(tableVal) != RBUS_STRING) {
+      set_error(outParams, "Table must be a table name string");
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   if (!rowsVal || rbusValue_GetType(rowsVal) != RBUS_OBJECT) {
+      set_error(outParams, "Rows must be an object of row objects");
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+
+   char err[MAX_NAME_LEN];
+   rbusObject_t created;
+   rbusObject_Init(&created, NULL);
+   model_lock();
+   rbusError_t rc = table_add_rows(handle, rbusValue_GetString(tableVal, NULL), rbusValue_GetObject(rowsVal), created, err, sizeof(err));
+   model_unlock();
    if (rc != RBUS_ERROR_SUCCESS) {
-      fprintf(stderr, "Failed to publish event to %s: %d\n", dest, rc);
+      rbusObject_Release(created);
+      if (rc == RBUS_ERROR_OUT_OF_RESOURCES) {
+         return rc;
+      }
+      set_error(outParams, err);
+      return rc;
+   }
+
+   uint32_t count = 0;
+   for (rbusProperty_t p = rbusObject_GetProperties(created); p; p = rbusProperty_GetNext(p)) {
+      count++;
    }
-#endif 
 
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, count);
+   rbusObject_SetValue(outParams, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, created);
+   rbusObject_SetValue(outParams, "Rows", val);
+   rbusValue_Release(val);
+
+   rbusObject_Release(created);
    return RBUS_ERROR_SUCCESS;
 }
@@ -0,0 +1,153 @@
+#include "rbus_elements.h"
+
+#ifdef __APPLE__
+int netlink_add_listener(uint32_t groups, NetlinkCb cb, void* ctx) {
+   (void)groups; (void)cb; (void)ctx;
+   return -1;
+}
+
+bool netlink_monitor_start(int fd) {
+   (void)fd;
+   return false;
+}
+
+bool netlink_monitor_active(void) {
+   return false;
+}
+
+void netlink_monitor_stop(void) {
+}
+#else
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+typedef struct {
+   uint32_t groups;
+   NetlinkCb cb;
+   void* ctx;
+} NetlinkListener;
+
+static NetlinkListener g_listeners[MAX_NETLINK_LISTENERS];
+static int g_num_listeners = 0;
+static int g_nl_fd = -1;
+static int g_nl_active = 0;
+
+int netlink_add_listener(uint32_t groups, NetlinkCb cb, void* ctx) {
+   if (!cb || g_num_listeners >= MAX_NETLINK_LISTENERS) {
+      return -1;
+   }
+   g_listeners[g_num_listeners].groups = groups;
+   g_listeners[g_num_listeners].cb = cb;
+   g_listeners[g_num_listeners].ctx = ctx;
+   return g_num_listeners++;
+}
+
+static uint32_t message_group(uint16_t type) {
+   switch (type) {
+      case RTM_NEWLINK:
+      case RTM_DELLINK:
+         return RTMGRP_LINK;
+      case RTM_NEWADDR:
+      case RTM_DELADDR:
+         return RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+      default:
+         return 0;
+   }
+}
+
+static void netlink_readable(int fd, void* ctx) {
+   (void)ctx;
+   char buf[8192] __attribute__((aligned(NLMSG_ALIGNTO)));
+
+   // Drain everything queued; one notification burst can span several datagrams
+   for (;;) {
+      ssize_t len = recv(fd, buf, sizeof(buf), MSG_DONTWAIT);
+      if (len < 0) {
+         if (errno == EINTR) continue;
+         if (errno == ENOBUFS) {
+            // Kernel dropped notifications; tell every listener to start over
+            for (int i = 0; i < g_num_listeners; i++) {
+               g_listeners[i].cb(NULL, g_listeners[i].ctx);
+            }
+            continue;
+         }
+         return;
+      }
+      if (len == 0) {
+         // Peer closed (injected test socket); caches fall back to direct reads
+         netlink_monitor_stop();
+         return;
+      }
+
+      for (struct nlmsghdr* nh = (struct nlmsghdr*)buf; NLMSG_OK(nh, (size_t)len); nh = NLMSG_NEXT(nh, len)) {
+         if (nh->nlmsg_type == NLMSG_DONE || nh->nlmsg_type == NLMSG_ERROR) continue;
+         uint32_t group = message_group(nh->nlmsg_type);
+         for (int i = 0; i < g_num_listeners; i++) {
+            if (g_listeners[i].groups & group) {
+               g_listeners[i].cb(nh, g_listeners[i].ctx);
+            }
+         }
+      }
+   }
+}
+
+bool netlink_monitor_start(int fd) {
+   if (g_nl_fd >= 0) {
+      return true;
+   }
+
+   // A caller-supplied fd (e.g. one end of a socketpair) replaces the kernel socket
+   // so link and address notifications can be injected
+   if (fd < 0) {
+      uint32_t groups = 0;
+      for (int i = 0; i < g_num_listeners; i++) {
+         groups |= g_listeners[i].groups;
+      }
+      if (groups == 0) {
+         return false;
+      }
+
+      fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+      if (fd < 0) {
+         fprintf(stderr, "Failed to open netlink socket: %s\n", strerror(errno));
+         return false;
+      }
+      struct sockaddr_nl addr;
+      memset(&addr, 0, sizeof(addr));
+      addr.nl_family = AF_NETLINK;
+      addr.nl_groups = groups;
+      if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+         fprintf(stderr, "Failed to bind netlink socket: %s\n", strerror(errno));
+         close(fd);
+         return false;
+      }
+   }
+
+   if (event_loop_add_fd(fd, netlink_readable, NULL) < 0) {
+      fprintf(stderr, "Failed to watch netlink socket\n");
+      close(fd);
+      return false;
+   }
+   g_nl_fd = fd;
+   __atomic_store_n(&g_nl_active, 1, __ATOMIC_RELEASE);
+   return true;
+}
+
+bool netlink_monitor_active(void) {
+   return __atomic_load_n(&g_nl_active, __ATOMIC_ACQUIRE) != 0;
+}
+
+void netlink_monitor_stop(void) {
+   if (g_nl_fd < 0) {
+      return;
+   }
+   __atomic_store_n(&g_nl_active, 0, __ATOMIC_RELEASE);
+   event_loop_remove_fd(g_nl_fd);
+   close(g_nl_fd);
+   g_nl_fd = -1;
+   // Without notifications nothing can be trusted any more
+   for (int i = 0; i < g_num_listeners; i++) {
+      g_listeners[i].cb(NULL, g_listeners[i].ctx);
+   }
+}
+#endif
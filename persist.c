@@ -0,0 +1,1353 @@
+#define _GNU_SOURCE // memfd_create
+#include "rbus_elements.h"
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+
+extern int g_totalElements;
+extern DataElement* g_internalDataElements;
+extern int g_num_tables;
+extern TableDef* g_tables;
+
+// Write-ahead log of runtime changes. Values stored by set_apply() and rows added or
+// removed at runtime in writable tables are appended as compact binary records and
+// replayed at startup, after elements.json has been loaded and before its values are
+// published. Records are buffered and written in groups, one frame and one fdatasync per
+// group, every syncMs or as soon as syncRecords are pending; a set superseded by a later
+// set of the same property in the same group is never written. Each frame carries a
+// CRC, so a frame torn by power loss ends replay and is cut off the log.
+//
+// Snapshots keep the log short: a forked child writes an image of every persisted value
+// and of the rows of writable tables from its copy-on-write view of the model, so gets
+// and sets carry on meanwhile, and renames it into place. The log is then cut down to
+// the records written since the fork, and startup loads the snapshot plus that tail.
+//
+// The same image, with the values that are not persisted as well, hands the live model
+// over to an upgraded daemon: it is written to a memfd that survives exec(), and the new
+// binary loads it instead of seeding elements.json values and replaying the log.
+
+#define WAL_MAGIC 0x4C574252  // "RBWL"
+#define WAL_VERSION 2
+#define SNAP_MAGIC 0x4E534252 // "RBSN"
+#define SNAP_VERSION 1
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t generation; // bumped each time a snapshot compacts the log
+   uint32_t reserved;
+} WalHeader;
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t generation; // of the log the snapshot was taken from
+   uint32_t frames;     // written last, so an incomplete file is recognized
+   uint64_t log_offset; // end of the log records the snapshot includes
+} SnapHeader;
+
+typedef struct {
+   uint32_t len;   // payload bytes
+   uint32_t crc;   // over the payload
+} WalFrame;
+
+/* Records, back to back in a frame payload (strings are varint length + bytes):
+ *   WAL_SET         name, type byte, value (varint, zigzag varint, raw float/double or one byte)
+ *   WAL_ROW_ADD     table name, varint instance, alias
+ *   WAL_ROW_REMOVE  row name
+ * Snapshots hold WAL_SET records for plain properties and, for each writable table:
+ *   SNAP_TABLE      table name, varint row count
+ *   SNAP_ROW        varint instance, alias
+ *   SNAP_PROP       property name, type byte, value (of the preceding row)
+ * Handoff images add the values that were never set, as SNAP_SET_VOLATILE and
+ * SNAP_PROP_VOLATILE records laid out like WAL_SET and SNAP_PROP. */
+enum { WAL_SET = 1, WAL_ROW_ADD = 2, WAL_ROW_REMOVE = 3, SNAP_TABLE = 4, SNAP_ROW = 5, SNAP_PROP = 6,
+   SNAP_SET_VOLATILE = 7, SNAP_PROP_VOLATILE = 8 };
+
+// A record in the group being collected
+typedef struct {
+   uint8_t op;
+   bool dead;       // superseded by a later record of the same group
+   uint32_t hash;   // name hash, sets only
+   uint32_t off;
+   uint32_t len;
+   uint32_t name;   // offset and length of the name in g_buf
+   uint32_t name_len;
+} WalPending;
+
+typedef struct {
+   const uint8_t* p;
+   size_t len;
+   size_t pos;
+   bool ok;
+} WalReader;
+
+// Snapshot output of the forked child, which only uses the buffer allocated before the fork
+typedef struct {
+   int fd;
+   uint8_t* buf;
+   size_t len;
+   uint32_t frames;
+   bool ok;
+} SnapWriter;
+
+typedef struct {
+   char* name;
+   DataElement* de;
+} SnapPropDef;
+
+// Loading state for the table whose rows are being read
+typedef struct {
+   int table;          // index in g_tables, -1 while a table is skipped
+   char* wild;         // table name with {i} for instances
+   int existing;       // rows that were there before the snapshot
+   uint32_t next_inst; // instances below this can belong to those rows
+   bool* seen;         // existing rows listed in the snapshot
+   int row;            // current row, -1 if skipped
+   bool new_row;
+   RowProperty* last;  // last property of a new row
+   SnapPropDef* defs;
+   int num_defs;
+   int capacity;       // rows the table has room for
+   uint32_t rows;
+} SnapLoad;
+
+static char g_path[MAX_NAME_LEN];
+static char g_tmp_path[MAX_NAME_LEN + 8];
+static char g_snap_path[MAX_NAME_LEN + 8];
+static char g_snap_tmp_path[MAX_NAME_LEN + 16];
+static char g_dir[MAX_NAME_LEN];
+static uint32_t g_sync_ms = PERSIST_SYNC_MS;
+static uint32_t g_sync_records = PERSIST_SYNC_RECORDS;
+static uint32_t g_snapshot_sec = PERSIST_SNAPSHOT_SEC;
+static uint32_t g_snapshot_bytes = PERSIST_SNAPSHOT_BYTES;
+static bool g_configured = false;
+static bool g_replaying = false;
+static int g_fd = -1;
+static bool g_logging = false;
+static uint32_t g_generation = 1;
+static off_t g_size = 0;     // end of the last complete frame
+static off_t g_covered = 0;  // end of the records a snapshot includes
+// g_lock guards the group being collected, g_io_lock the log file and the frame being
+// written; a flush takes g_io_lock first and holds g_lock only to move the group out.
+// Both come after the model lock, which sets hold while they log.
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t g_io_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint8_t* g_buf = NULL;
+static size_t g_len = 0;
+static size_t g_cap = 0;
+static uint8_t* g_out = NULL;  // frame being written, kept for the next flush if that fails
+static size_t g_out_len = 0;
+static size_t g_out_cap = 0;
+static WalPending* g_pending = NULL;
+static int g_num_pending = 0;
+static int g_pending_cap = 0;
+static uint8_t* g_snap_buf = NULL;
+static pid_t g_snap_pid = -1;
+static off_t g_snap_offset = 0;
+static uint64_t g_last_snapshot_ms = 0;
+static uint32_t g_crc_table[256];
+static bool g_crc_ready = false;
+
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void crc_init(void) {
+   for (uint32_t i = 0; i < 256 && !g_crc_ready; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      g_crc_table[i] = c;
+   }
+   g_crc_ready = true;
+}
+
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t n) {
+   uint32_t c = ~crc;
+   while (n--) {
+      c = g_crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+   }
+   return ~c;
+}
+
+static uint32_t crc32(const uint8_t* p, size_t n) {
+   return crc32_update(0, p, n);
+}
+
+static uint32_t hash_name(const char* s, size_t len) {
+   /* FNV-1a 32-bit */
+   uint32_t h = 2166136261u;
+   for (size_t i = 0; i < len; i++) {
+      h ^= (uint8_t)s[i];
+      h *= 16777619u;
+   }
+   return h;
+}
+
+static uint64_t zigzag(int64_t v) {
+   return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v) {
+   return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+static size_t put_varint(uint8_t* out, uint64_t v) {
+   size_t n = 0;
+   while (v >= 0x80) {
+      out[n++] = (uint8_t)(v | 0x80);
+      v >>= 7;
+   }
+   out[n++] = (uint8_t)v;
+   return n;
+}
+
+static size_t put_string(uint8_t* out, const char* s, size_t len) {
+   size_t n = put_varint(out, len);
+   if (len) memcpy(out + n, s, len);
+   return n + len;
+}
+
+// Encodes type and value, except a string's bytes, which are left to the caller in *tail
+static size_t put_value(uint8_t* out, ValueType type, const ElementValue* v, const char** tail, size_t* tail_len) {
+   size_t n = 0;
+   *tail = NULL;
+   *tail_len = 0;
+   out[n++] = (uint8_t)type;
+   switch (type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64:
+         *tail = v->strVal;
+         *tail_len = v->strVal ? strlen(v->strVal) : 0;
+         return n + put_varint(out + n, *tail_len);
+      case TYPE_INT: return n + put_varint(out + n, zigzag(v->intVal));
+      case TYPE_UINT: return n + put_varint(out + n, v->uintVal);
+      case TYPE_BOOL: out[n] = v->boolVal; return n + 1;
+      case TYPE_LONG: return n + put_varint(out + n, zigzag(v->longVal));
+      case TYPE_ULONG: return n + put_varint(out + n, v->ulongVal);
+      case TYPE_FLOAT: memcpy(out + n, &v->floatVal, sizeof(float)); return n + sizeof(float);
+      case TYPE_DOUBLE: memcpy(out + n, &v->doubleVal, sizeof(double)); return n + sizeof(double);
+      case TYPE_BYTE: out[n] = v->byteVal; return n + 1;
+   }
+   return n;
+}
+
+static const uint8_t* get_bytes(WalReader* r, uint64_t n) {
+   if (!r->ok || n > r->len - r->pos) {
+      r->ok = false;
+      return NULL;
+   }
+   const uint8_t* p = r->p + r->pos;
+   r->pos += n;
+   return p;
+}
+
+static uint64_t get_varint(WalReader* r) {
+   uint64_t v = 0;
+   for (int shift = 0; shift < 64; shift += 7) {
+      const uint8_t* b = get_bytes(r, 1);
+      if (!b) return 0;
+      v |= (uint64_t)(*b & 0x7F) << shift;
+      if (!(*b & 0x80)) return v;
+   }
+   r->ok = false;
+   return 0;
+}
+
+// Copies a string field into out, NUL terminated
+static bool get_string(WalReader* r, char* out, size_t outlen) {
+   uint64_t len = get_varint(r);
+   const uint8_t* p = len < outlen ? get_bytes(r, len) : NULL;
+   if (!p) {
+      r->ok = false;
+      return false;
+   }
+   memcpy(out, p, len);
+   out[len] = '\0';
+   return true;
+}
+
+// Decodes a value; strings are allocated and owned by the caller
+static bool get_element_value(WalReader* r, ValueType* type, ElementValue* v) {
+   const uint8_t* t = get_bytes(r, 1);
+   if (!t || *t > TYPE_BYTE) {
+      r->ok = false;
+      return false;
+   }
+   *type = (ValueType)*t;
+   memset(v, 0, sizeof(*v));
+   const uint8_t* p;
+   switch (*type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64: {
+         uint64_t len = get_varint(r);
+         p = get_bytes(r, len);
+         v->strVal = p ? strndup((const char*)p, len) : NULL;
+         if (!v->strVal) r->ok = false;
+         break;
+      }
+      case TYPE_INT: v->intVal = (int32_t)unzigzag(get_varint(r)); break;
+      case TYPE_UINT: v->uintVal = (uint32_t)get_varint(r); break;
+      case TYPE_BOOL: p = get_bytes(r, 1); v->boolVal = p && *p; break;
+      case TYPE_LONG: v->longVal = unzigzag(get_varint(r)); break;
+      case TYPE_ULONG: v->ulongVal = get_varint(r); break;
+      case TYPE_FLOAT: if ((p = get_bytes(r, sizeof(float)))) memcpy(&v->floatVal, p, sizeof(float)); break;
+      case TYPE_DOUBLE: if ((p = get_bytes(r, sizeof(double)))) memcpy(&v->doubleVal, p, sizeof(double)); break;
+      case TYPE_BYTE: p = get_bytes(r, 1); v->byteVal = p ? *p : 0; break;
+   }
+   if (!r->ok && IS_STRING_TYPE(*type)) {
+      free(v->strVal);
+   }
+   return r->ok;
+}
+
+static bool replay_set(WalReader* r) {
+   char name[MAX_NAME_LEN * 2];
+   ValueType type;
+   ElementValue v;
+   if (!get_string(r, name, sizeof(name)) || !get_element_value(r, &type, &v)) {
+      return false;
+   }
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   value_to_rbus(value, type, &v);
+   if (IS_STRING_TYPE(type)) free(v.strVal);
+
+   // Elements removed from elements.json or given another type since are skipped
+   SetTarget target;
+   if (set_resolve(name, value, true, &target) == RBUS_ERROR_SUCCESS &&
+      value_from_rbus(target.type, value, &v) == RBUS_ERROR_SUCCESS) {
+      set_apply(name, &target, &v, value);
+   } else {
+      fprintf(stderr, "Skipping persisted value for %s\n", name);
+   }
+   rbusValue_Release(value);
+   return true;
+}
+
+static bool replay_row_add(rbusHandle_t handle, WalReader* r) {
+   char table_name[MAX_NAME_LEN];
+   char alias[MAX_NAME_LEN];
+   if (!get_string(r, table_name, sizeof(table_name))) {
+      return false;
+   }
+   uint64_t inst = get_varint(r);
+   if (!get_string(r, alias, sizeof(alias)) || inst == 0 || inst > UINT32_MAX) {
+      return false;
+   }
+
+   TableDef* table = find_table(table_name);
+   if (!table && !(table = create_table(table_name))) {
+      return true;
+   }
+   if (inst < table->next_inst && find_row(table, (uint32_t)inst)) {
+      return true; // also an initial row from elements.json, or already in the snapshot
+   }
+   // The row gets its original instance number back
+   uint32_t next = table->next_inst;
+   uint32_t got;
+   table->next_inst = (uint32_t)inst;
+   rbusError_t rc = table_add_row(handle, table_name, alias, &got);
+   table->next_inst = next > inst ? next : (uint32_t)inst + 1;
+   if (rc != RBUS_ERROR_SUCCESS) {
+      fprintf(stderr, "Skipping persisted row %s%u.: %d\n", table_name, (uint32_t)inst, rc);
+      return true;
+   }
+   rc = rbusTable_registerRow(handle, table_name, got, alias[0] ? alias : NULL);
+   if (rc != RBUS_ERROR_SUCCESS) {
+      fprintf(stderr, "Failed to register persisted row %s%u.: %d\n", table_name, got, rc);
+   }
+   return true;
+}
+
+static bool replay_row_remove(rbusHandle_t handle, WalReader* r) {
+   char name[MAX_NAME_LEN];
+   if (!get_string(r, name, sizeof(name))) {
+      return false;
+   }
+   if (table_remove_row(handle, name) == RBUS_ERROR_SUCCESS) {
+      rbusTable_unregisterRow(handle, name);
+   }
+   return true;
+}
+
+// Applies one log frame; false if a record cannot be decoded
+static bool replay_frame(rbusHandle_t handle, const uint8_t* p, size_t len, int* count) {
+   WalReader r = {.p = p, .len = len, .ok = true};
+   while (r.ok && r.pos < r.len) {
+      const uint8_t* op = get_bytes(&r, 1);
+      bool ok = false;
+      switch (*op) {
+         case WAL_SET: ok = replay_set(&r); break;
+         case WAL_ROW_ADD: ok = replay_row_add(handle, &r); break;
+         case WAL_ROW_REMOVE: ok = replay_row_remove(handle, &r); break;
+      }
+      if (!ok) {
+         return false;
+      }
+      (*count)++;
+   }
+   return true;
+}
+
+static void sync_dir(void) {
+   int fd = open(g_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   if (fd >= 0) {
+      fsync(fd);
+      close(fd);
+   }
+}
+
+// Reads a whole file; NULL with *len 0 for a missing or empty one
+static uint8_t* read_file(int fd, size_t* len) {
+   struct stat st;
+   *len = 0;
+   if (fstat(fd, &st) < 0 || st.st_size == 0) {
+      return NULL;
+   }
+   uint8_t* data = malloc(st.st_size);
+   if (data && pread(fd, data, st.st_size, 0) != st.st_size) {
+      free(data);
+      data = NULL;
+   }
+   if (data) {
+      *len = st.st_size;
+   }
+   return data;
+}
+
+static DataElement* snap_prop_def(SnapLoad* s, const char* prop) {
+   for (int i = 0; i < s->num_defs; i++) {
+      if (strcmp(s->defs[i].name, prop) == 0) {
+         return s->defs[i].de;
+      }
+   }
+   char wild[MAX_NAME_LEN * 2];
+   snprintf(wild, sizeof(wild), "%s{i}.%s", s->wild, prop);
+   DataElement* de = lookup_element(wild);
+   if (!de || de->elementType != RBUS_ELEMENT_TYPE_PROPERTY) {
+      de = NULL;
+   }
+   SnapPropDef* grown = realloc(s->defs, (s->num_defs + 1) * sizeof(SnapPropDef));
+   char* name = strdup(prop);
+   if (grown && name) {
+      s->defs = grown;
+      s->defs[s->num_defs].name = name;
+      s->defs[s->num_defs++].de = de;
+   } else {
+      s->defs = grown ? grown : s->defs;
+      free(name);
+   }
+   return de;
+}
+
+// Rows from elements.json that were removed at runtime are not in the snapshot
+static void snap_table_end(rbusHandle_t handle, SnapLoad* s) {
+   if (s->table >= 0) {
+      TableDef* table = &g_tables[s->table];
+      char name[MAX_NAME_LEN * 2];
+      for (int i = s->existing - 1; i >= 0; i--) {
+         if (!s->seen[i]) {
+            snprintf(name, sizeof(name), "%s%u.", table->name, table->rows[i].instNum);
+            if (table_remove_row(handle, name) == RBUS_ERROR_SUCCESS) {
+               rbusTable_unregisterRow(handle, name);
+            }
+         }
+      }
+   }
+   for (int i = 0; i < s->num_defs; i++) {
+      free(s->defs[i].name);
+   }
+   free(s->defs);
+   free(s->seen);
+   free(s->wild);
+   uint32_t rows = s->rows;
+   memset(s, 0, sizeof(*s));
+   s->table = s->row = -1;
+   s->rows = rows;
+}
+
+static bool snap_table(rbusHandle_t handle, SnapLoad* s, WalReader* r) {
+   char name[MAX_NAME_LEN];
+   if (!get_string(r, name, sizeof(name))) {
+      return false;
+   }
+   uint64_t count = get_varint(r);
+   snap_table_end(handle, s);
+   if (!r->ok || count > INT32_MAX) {
+      return false;
+   }
+   if (!table_is_writable(name)) {
+      fprintf(stderr, "Skipping persisted rows of %s\n", name);
+      return true;
+   }
+   TableDef* table = find_table(name);
+   if (!table && !(table = create_table(name))) {
+      return true;
+   }
+   // All rows arrive in one growth of the array
+   TableRow* grown = count ? realloc(table->rows, (table->num_rows + count) * sizeof(TableRow)) : table->rows;
+   s->wild = create_wildcard(name);
+   s->seen = calloc(table->num_rows + 1, sizeof(bool));
+   if ((count && !grown) || !s->wild || !s->seen) {
+      return true;
+   }
+   table->rows = grown;
+   s->capacity = table->num_rows + (int)count;
+   s->table = (int)(table - g_tables);
+   s->existing = table->num_rows;
+   s->next_inst = table->next_inst;
+   return true;
+}
+
+static bool snap_row(rbusHandle_t handle, SnapLoad* s, WalReader* r) {
+   char alias[MAX_NAME_LEN];
+   uint64_t inst = get_varint(r);
+   if (!get_string(r, alias, sizeof(alias)) || inst == 0 || inst > UINT32_MAX) {
+      return false;
+   }
+   s->row = -1;
+   if (s->table < 0) {
+      return true;
+   }
+   TableDef* table = &g_tables[s->table];
+   TableRow* row = inst < s->next_inst ? find_row(table, (uint32_t)inst) : NULL;
+   if (row) {
+      int index = (int)(row - table->rows);
+      if (index < s->existing) s->seen[index] = true;
+      snprintf(row->alias, MAX_NAME_LEN, "%s", alias);
+      s->row = index;
+      s->new_row = false;
+      return true;
+   }
+
+   if (table->num_rows >= s->capacity) {
+      return false; // more rows than the table record announced
+   }
+   row = &table->rows[table->num_rows];
+   memset(row, 0, sizeof(TableRow));
+   snprintf(row->name, MAX_NAME_LEN, "%s%u.", table->name, (uint32_t)inst);
+   row->instNum = (uint32_t)inst;
+   snprintf(row->alias, MAX_NAME_LEN, "%s", alias);
+   row->version = changelog_record(row->name, CHANGE_ROW_ADDED);
+   s->row = table->num_rows++;
+   s->new_row = true;
+   s->last = NULL;
+   s->rows++;
+   table->num_inst++;
+   if (inst >= table->next_inst) {
+      table->next_inst = (uint32_t)inst + 1;
+   }
+   rbusError_t rc = rbusTable_registerRow(handle, table->name, row->instNum, alias[0] ? alias : NULL);
+   if (rc != RBUS_ERROR_SUCCESS) {
+      fprintf(stderr, "Failed to register persisted row %s: %d\n", row->name, rc);
+   }
+   return true;
+}
+
+static bool snap_prop(SnapLoad* s, WalReader* r, bool persisted) {
+   char name[MAX_NAME_LEN];
+   ValueType type;
+   ElementValue v;
+   if (!get_string(r, name, sizeof(name)) || !get_element_value(r, &type, &v)) {
+      return false;
+   }
+   DataElement* de = s->row >= 0 ? snap_prop_def(s, name) : NULL;
+   if (!de || de->type != type) {
+      if (IS_STRING_TYPE(type)) free(v.strVal);
+      return true;
+   }
+
+   TableRow* row = &g_tables[s->table].rows[s->row];
+   RowProperty* p = NULL;
+   for (p = s->new_row ? NULL : row->props; p; p = p->next) {
+      if (strcmp(p->name, name) == 0) break;
+   }
+   if (!p) {
+      if (!(p = calloc(1, sizeof(RowProperty)))) {
+         if (IS_STRING_TYPE(type)) free(v.strVal);
+         return true;
+      }
+      snprintf(p->name, MAX_NAME_LEN, "%s", name);
+      p->type = type;
+      alarm_bind(&p->alarms, &de->alarms);
+      history_bind(&p->history, de->history);
+      // New rows keep the snapshot's property order
+      if (s->new_row && s->last) {
+         s->last->next = p;
+      } else {
+         p->next = row->props;
+         row->props = p;
+      }
+      if (s->new_row) s->last = p;
+   } else if (IS_STRING_TYPE(p->type)) {
+      free(p->value.strVal);
+   }
+   p->value = v;
+   p->version = row->version;
+   p->persisted = persisted;
+   return true;
+}
+
+// Applies a complete snapshot or handoff image; header receives its log position
+static bool load_image(rbusHandle_t handle, const uint8_t* data, size_t size, const char* what, SnapHeader* header) {
+   // Every frame is checked before anything is applied
+   uint32_t frames = 0;
+   size_t off = sizeof(SnapHeader);
+   if (data && size >= sizeof(SnapHeader)) {
+      memcpy(header, data, sizeof(SnapHeader));
+      while (off + sizeof(WalFrame) <= size) {
+         WalFrame frame;
+         memcpy(&frame, data + off, sizeof(frame));
+         if (frame.len > size - off - sizeof(frame) || crc32(data + off + sizeof(frame), frame.len) != frame.crc) {
+            break;
+         }
+         off += sizeof(frame) + frame.len;
+         frames++;
+      }
+   }
+   if (!data || size < sizeof(SnapHeader) || header->magic != SNAP_MAGIC || header->version != SNAP_VERSION ||
+      frames != header->frames || off != size) {
+      fprintf(stderr, "Ignoring incomplete image %s\n", what);
+      return false;
+   }
+
+   SnapLoad s;
+   memset(&s, 0, sizeof(s));
+   s.table = s.row = -1;
+   int values = 0;
+   bool ok = true;
+   for (off = sizeof(SnapHeader); ok && off < size;) {
+      WalFrame frame;
+      memcpy(&frame, data + off, sizeof(frame));
+      WalReader r = {.p = data + off + sizeof(frame), .len = frame.len, .ok = true};
+      while (ok && r.pos < r.len) {
+         const uint8_t* op = get_bytes(&r, 1);
+         switch (*op) {
+            case WAL_SET: ok = replay_set(&r); values++; break;
+            case SNAP_SET_VOLATILE:
+               // Applied like a persisted value, without being marked as one
+               g_replaying = false;
+               ok = replay_set(&r);
+               g_replaying = true;
+               values++;
+               break;
+            case SNAP_TABLE: ok = snap_table(handle, &s, &r); break;
+            case SNAP_ROW: ok = snap_row(handle, &s, &r); break;
+            case SNAP_PROP: ok = snap_prop(&s, &r, true); values++; break;
+            case SNAP_PROP_VOLATILE: ok = snap_prop(&s, &r, false); values++; break;
+            default: ok = false;
+         }
+      }
+      off += sizeof(frame) + frame.len;
+   }
+   snap_table_end(handle, &s);
+   if (!ok) {
+      fprintf(stderr, "Image %s has undecodable records, the rest of it is skipped\n", what);
+   }
+   fprintf(stderr, "Loaded %u rows and %d values from %s\n", s.rows, values, what);
+   return true;
+}
+
+// Loads the snapshot, if there is a complete one
+static bool load_snapshot(rbusHandle_t handle, SnapHeader* header) {
+   int fd = open(g_snap_path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) {
+      return false;
+   }
+   size_t size;
+   uint8_t* data = read_file(fd, &size);
+   close(fd);
+   bool loaded = load_image(handle, data, size, g_snap_path, header);
+   free(data);
+   return loaded;
+}
+
+static bool write_header(uint32_t generation) {
+   WalHeader h = {.magic = WAL_MAGIC, .version = WAL_VERSION, .generation = generation};
+   if (ftruncate(g_fd, 0) < 0 || pwrite(g_fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || fdatasync(g_fd) < 0) {
+      fprintf(stderr, "Failed to initialize %s: %s\n", g_path, strerror(errno));
+      return false;
+   }
+   g_generation = generation;
+   g_size = g_covered = sizeof(h);
+   return true;
+}
+
+// Replays the log records that are not in the snapshot (all of them without one)
+static void replay_log(rbusHandle_t handle, const SnapHeader* snap) {
+   uint32_t fresh = snap ? snap->generation + 1 : 1;
+   g_fd = open(g_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   if (g_fd < 0) {
+      fprintf(stderr, "Failed to open %s, runtime changes will not persist: %s\n", g_path, strerror(errno));
+      return;
+   }
+   size_t size;
+   uint8_t* data = read_file(g_fd, &size);
+   WalHeader h;
+   if (data) {
+      memcpy(&h, data, size < sizeof(h) ? size : sizeof(h));
+   }
+   if (!data || size < sizeof(WalHeader) || h.magic != WAL_MAGIC || h.version != WAL_VERSION) {
+      if (size > 0) {
+         // Kept for inspection rather than silently overwritten
+         char bad[MAX_NAME_LEN + 8];
+         snprintf(bad, sizeof(bad), "%s.bad", g_path);
+         fprintf(stderr, "%s is not a value log, moved to %s\n", g_path, bad);
+         rename(g_path, bad);
+         close(g_fd);
+         g_fd = open(g_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+      }
+      free(data);
+      if (g_fd < 0 || !write_header(fresh)) {
+         persist_close();
+      }
+      return;
+   }
+
+   size_t off = sizeof(WalHeader);
+   if (snap && snap->log_offset == 0) {
+      // Handed over by a daemon that kept no log, so this one is stale
+      fprintf(stderr, "%s predates the handed over model, discarding it\n", g_path);
+      free(data);
+      if (!write_header(fresh)) {
+         persist_close();
+      }
+      return;
+   } else if (snap && h.generation == snap->generation) {
+      // Compaction did not finish: the snapshot covers this log up to its offset
+      off = snap->log_offset < size ? snap->log_offset : size;
+      off = off > sizeof(WalHeader) ? off : sizeof(WalHeader);
+   } else if (snap && h.generation < snap->generation) {
+      fprintf(stderr, "%s is older than %s, discarding it\n", g_path, g_snap_path);
+      free(data);
+      if (!write_header(fresh)) {
+         persist_close();
+      }
+      return;
+   } else if (snap && h.generation > fresh) {
+      fprintf(stderr, "%s is older than %s, replaying all of the log\n", g_snap_path, g_path);
+   }
+   g_generation = h.generation;
+   g_covered = off;
+
+   int frames = 0, records = 0;
+   while (off + sizeof(WalFrame) <= size) {
+      WalFrame frame;
+      memcpy(&frame, data + off, sizeof(frame));
+      const uint8_t* payload = data + off + sizeof(frame);
+      if (frame.len > size - off - sizeof(frame) || crc32(payload, frame.len) != frame.crc ||
+         !replay_frame(handle, payload, frame.len, &records)) {
+         break;
+      }
+      off += sizeof(frame) + frame.len;
+      frames++;
+   }
+   free(data);
+   g_size = off;
+   if (off < size) {
+      fprintf(stderr, "Discarding %zu bytes of torn records at the end of %s\n", size - off, g_path);
+      if (ftruncate(g_fd, off) < 0) {
+         fprintf(stderr, "Failed to truncate %s: %s\n", g_path, strerror(errno));
+      }
+   }
+   if (records) {
+      fprintf(stderr, "Replayed %d persisted changes in %d groups from %s\n", records, frames, g_path);
+   }
+}
+
+bool persist_add_rule(cJSON* item, int index) {
+   cJSON* path_obj = cJSON_GetObjectItem(item, "path");
+   cJSON* ms_obj = cJSON_GetObjectItem(item, "syncMs");
+   cJSON* records_obj = cJSON_GetObjectItem(item, "syncRecords");
+   cJSON* sec_obj = cJSON_GetObjectItem(item, "snapshotSec");
+   cJSON* bytes_obj = cJSON_GetObjectItem(item, "snapshotBytes");
+
+   if (g_configured) {
+      fprintf(stderr, "Persistence item %d: only one log can be configured\n", index);
+      return false;
+   }
+   if (!cJSON_IsString(path_obj)) {
+      fprintf(stderr, "Persistence item %d: path is required\n", index);
+      return false;
+   }
+   snprintf(g_path, sizeof(g_path), "%s", cJSON_GetStringValue(path_obj));
+   snprintf(g_tmp_path, sizeof(g_tmp_path), "%s.tmp", g_path);
+   snprintf(g_snap_path, sizeof(g_snap_path), "%s.snap", g_path);
+   snprintf(g_snap_tmp_path, sizeof(g_snap_tmp_path), "%s.snap.tmp", g_path);
+   const char* slash = strrchr(g_path, '/');
+   snprintf(g_dir, sizeof(g_dir), "%.*s", slash ? (int)(slash - g_path) + 1 : 1, slash ? g_path : ".");
+   if (cJSON_IsNumber(ms_obj) && ms_obj->valuedouble >= 0) {
+      g_sync_ms = (uint32_t)ms_obj->valuedouble;
+   }
+   if (cJSON_IsNumber(records_obj) && records_obj->valuedouble >= 1) {
+      g_sync_records = (uint32_t)records_obj->valuedouble;
+   }
+   if (cJSON_IsNumber(sec_obj) && sec_obj->valuedouble >= 0) {
+      g_snapshot_sec = (uint32_t)sec_obj->valuedouble;
+   }
+   if (cJSON_IsNumber(bytes_obj) && bytes_obj->valuedouble >= 0) {
+      g_snapshot_bytes = (uint32_t)bytes_obj->valuedouble;
+   }
+   g_configured = true;
+   return true;
+}
+
+void persist_replay(rbusHandle_t handle) {
+   if (!g_configured) {
+      return;
+   }
+   crc_init();
+   uint64_t started = monotonic_ms();
+   g_replaying = true;
+   SnapHeader snap;
+   bool have_snap = load_snapshot(handle, &snap);
+   replay_log(handle, have_snap ? &snap : NULL);
+   g_replaying = false;
+   if (have_snap || g_size > g_covered) {
+      fprintf(stderr, "Restored persisted state in %llu ms\n", (unsigned long long)(monotonic_ms() - started));
+   }
+}
+
+// Moves the collected group behind any frame left over from a failed write; called with
+// g_lock held. A group that cannot be moved stays where it is for the next flush.
+static void take_group_locked(void) {
+   size_t len = 0;
+   for (int i = 0; i < g_num_pending; i++) {
+      WalPending* e = &g_pending[i];
+      if (!e->dead) {
+         memmove(g_buf + len, g_buf + e->off, e->len);
+         len += e->len;
+      }
+   }
+   g_len = len;
+   g_num_pending = 0;
+   if (len == 0) {
+      return;
+   }
+
+   if (g_out_len == 0) {
+      // Swap the buffers, the next group is collected into the old frame's storage
+      uint8_t* buf = g_out;
+      size_t cap = g_out_cap;
+      g_out = g_buf;
+      g_out_cap = g_cap;
+      g_out_len = len;
+      g_buf = buf;
+      g_cap = cap;
+      g_len = 0;
+      return;
+   }
+   if (g_out_len + len > g_out_cap) {
+      size_t cap = g_out_cap * 2;
+      while (cap < g_out_len + len) cap *= 2;
+      uint8_t* grown = realloc(g_out, cap);
+      if (!grown) {
+         g_pending[0] = (WalPending){.off = 0, .len = (uint32_t)len};
+         g_num_pending = 1;
+         return;
+      }
+      g_out = grown;
+      g_out_cap = cap;
+   }
+   memcpy(g_out + g_out_len, g_buf, len);
+   g_out_len += len;
+   g_len = 0;
+}
+
+// Writes the collected group as one frame. Only moving the group out happens under
+// g_lock, so sets keep being collected while the frame is written and synced; called
+// with g_io_lock held.
+static void flush_io_locked(void) {
+   pthread_mutex_lock(&g_lock);
+   take_group_locked();
+   pthread_mutex_unlock(&g_lock);
+   if (g_out_len == 0) {
+      return;
+   }
+
+   WalFrame frame = {.len = (uint32_t)g_out_len, .crc = crc32(g_out, g_out_len)};
+   struct iovec iov[2] = {{.iov_base = &frame, .iov_len = sizeof(frame)}, {.iov_base = g_out, .iov_len = g_out_len}};
+   ssize_t n = pwritev(g_fd, iov, 2, g_size);
+   if (n == (ssize_t)(sizeof(frame) + g_out_len) && fdatasync(g_fd) == 0) {
+      g_size += n;
+      g_out_len = 0;
+      return;
+   }
+
+   // The log keeps ending at a complete frame, and the records go out with the next group
+   fprintf(stderr, "Failed to write %s: %s\n", g_path, n < 0 ? strerror(errno) : "short write");
+   if (ftruncate(g_fd, g_size) < 0) {
+      fprintf(stderr, "Failed to truncate %s: %s\n", g_path, strerror(errno));
+   }
+}
+
+// Room for one more record of up to n bytes; called with g_lock held
+static bool reserve_locked(size_t n) {
+   if (g_len + n > g_cap) {
+      size_t cap = g_cap ? g_cap : 4096;
+      while (cap < g_len + n) cap *= 2;
+      uint8_t* grown = realloc(g_buf, cap);
+      if (!grown) return false;
+      g_buf = grown;
+      g_cap = cap;
+   }
+   if (g_num_pending == g_pending_cap) {
+      int cap = g_pending_cap ? g_pending_cap * 2 : 64;
+      WalPending* grown = realloc(g_pending, cap * sizeof(WalPending));
+      if (!grown) return false;
+      g_pending = grown;
+      g_pending_cap = cap;
+   }
+   return true;
+}
+
+// Returns whether the group is due to be flushed
+static bool commit_locked(uint8_t op, size_t len, size_t name_off, size_t name_len) {
+   WalPending* e = &g_pending[g_num_pending++];
+   *e = (WalPending){.op = op, .off = (uint32_t)g_len, .len = (uint32_t)len,
+      .name = (uint32_t)(g_len + name_off), .name_len = (uint32_t)name_len};
+   if (op == WAL_SET) {
+      e->hash = hash_name((const char*)g_buf + e->name, name_len);
+   }
+   g_len += len;
+   return (uint32_t)g_num_pending >= g_sync_records || g_sync_ms == 0;
+}
+
+bool persist_log_set(const char* name, ValueType type, const ElementValue* v) {
+   if (!__atomic_load_n(&g_logging, __ATOMIC_ACQUIRE)) {
+      return g_replaying;
+   }
+   size_t name_len = strlen(name);
+   size_t vlen = IS_STRING_TYPE(type) && v->strVal ? strlen(v->strVal) : 0;
+   pthread_mutex_lock(&g_lock);
+   if (!reserve_locked(1 + 10 + name_len + 1 + 10 + vlen + sizeof(double))) {
+      pthread_mutex_unlock(&g_lock);
+      fprintf(stderr, "Out of memory, %s will not persist\n", name);
+      return false;
+   }
+   // Only the last value of a property in a group reaches storage
+   uint32_t hash = hash_name(name, name_len);
+   for (int i = 0; i < g_num_pending; i++) {
+      WalPending* e = &g_pending[i];
+      if (e->op == WAL_SET && !e->dead && e->hash == hash && e->name_len == name_len &&
+         memcmp(g_buf + e->name, name, name_len) == 0) {
+         e->dead = true;
+      }
+   }
+   uint8_t* out = g_buf + g_len;
+   const char* tail;
+   size_t tail_len;
+   out[0] = WAL_SET;
+   size_t n = 1 + put_varint(out + 1, name_len);
+   size_t name_off = n;
+   memcpy(out + n, name, name_len);
+   n += name_len;
+   n += put_value(out + n, type, v, &tail, &tail_len);
+   if (tail_len) memcpy(out + n, tail, tail_len);
+   bool due = commit_locked(WAL_SET, n + tail_len, name_off, name_len);
+   pthread_mutex_unlock(&g_lock);
+   if (due) {
+      persist_flush();
+   }
+   return true;
+}
+
+void persist_log_row_add(const char* table, uint32_t inst, const char* alias) {
+   // Rows of provider-owned tables (alarms, processes) are rebuilt at runtime
+   if (!__atomic_load_n(&g_logging, __ATOMIC_ACQUIRE) || !table_is_writable(table)) {
+      return;
+   }
+   size_t table_len = strlen(table);
+   size_t alias_len = alias ? strlen(alias) : 0;
+   pthread_mutex_lock(&g_lock);
+   if (!reserve_locked(1 + 10 + table_len + 10 + 10 + alias_len)) {
+      pthread_mutex_unlock(&g_lock);
+      fprintf(stderr, "Out of memory, row %s%u. will not persist\n", table, inst);
+      return;
+   }
+   uint8_t* out = g_buf + g_len;
+   out[0] = WAL_ROW_ADD;
+   size_t n = 1 + put_string(out + 1, table, table_len);
+   n += put_varint(out + n, inst);
+   n += put_string(out + n, alias, alias_len);
+   bool due = commit_locked(WAL_ROW_ADD, n, 0, 0);
+   pthread_mutex_unlock(&g_lock);
+   if (due) {
+      persist_flush();
+   }
+}
+
+void persist_log_row_remove(const char* table, uint32_t inst) {
+   if (!__atomic_load_n(&g_logging, __ATOMIC_ACQUIRE) || !table_is_writable(table)) {
+      return;
+   }
+   // Logged under the instance number, which replay resolves whatever the alias
+   char row[MAX_NAME_LEN * 2];
+   size_t row_len = (size_t)snprintf(row, sizeof(row), "%s%u.", table, inst);
+   pthread_mutex_lock(&g_lock);
+   if (!reserve_locked(1 + 10 + row_len)) {
+      pthread_mutex_unlock(&g_lock);
+      fprintf(stderr, "Out of memory, removal of %s will not persist\n", row);
+      return;
+   }
+   // Sets of the row's properties collected in this group are moot
+   for (int i = 0; i < g_num_pending; i++) {
+      WalPending* e = &g_pending[i];
+      if (e->op == WAL_SET && e->name_len > row_len && memcmp(g_buf + e->name, row, row_len) == 0) {
+         e->dead = true;
+      }
+   }
+   uint8_t* out = g_buf + g_len;
+   out[0] = WAL_ROW_REMOVE;
+   size_t n = 1 + put_string(out + 1, row, row_len);
+   bool due = commit_locked(WAL_ROW_REMOVE, n, 0, 0);
+   pthread_mutex_unlock(&g_lock);
+   if (due) {
+      persist_flush();
+   }
+}
+
+void persist_flush(void) {
+   pthread_mutex_lock(&g_io_lock);
+   if (g_fd >= 0) {
+      flush_io_locked();
+   }
+   pthread_mutex_unlock(&g_io_lock);
+}
+
+static void snap_write(SnapWriter* w, const void* p, size_t n) {
+   while (w->ok && n > 0) {
+      ssize_t k = write(w->fd, p, n);
+      if (k < 0 && errno == EINTR) continue;
+      if (k <= 0) {
+         w->ok = false;
+         return;
+      }
+      p = (const uint8_t*)p + k;
+      n -= k;
+   }
+}
+
+static void snap_frame(SnapWriter* w, const uint8_t* head, size_t head_len, const char* tail, size_t tail_len) {
+   WalFrame frame = {.len = (uint32_t)(head_len + tail_len),
+      .crc = crc32_update(crc32(head, head_len), (const uint8_t*)tail, tail_len)};
+   snap_write(w, &frame, sizeof(frame));
+   snap_write(w, head, head_len);
+   snap_write(w, tail, tail_len);
+   w->frames++;
+}
+
+static void snap_flush(SnapWriter* w) {
+   if (w->len) {
+      snap_frame(w, w->buf, w->len, NULL, 0);
+      w->len = 0;
+   }
+}
+
+static void snap_record(SnapWriter* w, const uint8_t* head, size_t head_len, const char* tail, size_t tail_len) {
+   size_t n = head_len + tail_len;
+   if (w->len + n > PERSIST_SNAPSHOT_FRAME) {
+      snap_flush(w);
+   }
+   if (n > PERSIST_SNAPSHOT_FRAME) {
+      snap_frame(w, head, head_len, tail, tail_len); // a long string gets a frame of its own
+      return;
+   }
+   memcpy(w->buf + w->len, head, head_len);
+   if (tail_len) memcpy(w->buf + w->len + head_len, tail, tail_len);
+   w->len += n;
+}
+
+// Writes the model image to fd with plain write() calls into buf, so the forked child
+// can use it: persisted values only, or every stored value for a handoff
+static bool write_image(int fd, uint8_t* buf, const bool* writable, off_t log_offset, bool all) {
+   SnapWriter w = {.fd = fd, .buf = buf, .ok = true};
+   SnapHeader h = {.magic = SNAP_MAGIC, .version = SNAP_VERSION, .generation = g_generation, .log_offset = (uint64_t)log_offset};
+   snap_write(&w, &h, sizeof(h));
+
+   uint8_t head[MAX_NAME_LEN * 2 + 64];
+   const char* tail;
+   size_t tail_len, n;
+   for (int i = 0; i < g_totalElements; i++) {
+      const DataElement* de = &g_internalDataElements[i];
+      // Values of properties with their own getter are not the model's
+      if (de->elementType != RBUS_ELEMENT_TYPE_PROPERTY || (!de->persisted &&
+         (!all || de->getHandler || strstr(de->name, "{i}")))) continue;
+      head[0] = de->persisted ? WAL_SET : SNAP_SET_VOLATILE;
+      n = 1 + put_string(head + 1, de->name, strlen(de->name));
+      n += put_value(head + n, de->type, &de->value, &tail, &tail_len);
+      snap_record(&w, head, n, tail, tail_len);
+   }
+   for (int t = 0; t < g_num_tables; t++) {
+      const TableDef* table = &g_tables[t];
+      if (!writable[t]) continue;
+      head[0] = SNAP_TABLE;
+      n = 1 + put_string(head + 1, table->name, strlen(table->name));
+      n += put_varint(head + n, (uint64_t)table->num_rows);
+      snap_record(&w, head, n, NULL, 0);
+      for (int i = 0; i < table->num_rows; i++) {
+         const TableRow* row = &table->rows[i];
+         head[0] = SNAP_ROW;
+         n = 1 + put_varint(head + 1, row->instNum);
+         n += put_string(head + n, row->alias, strlen(row->alias));
+         snap_record(&w, head, n, NULL, 0);
+         for (const RowProperty* p = row->props; p; p = p->next) {
+            if (!p->persisted && !all) continue;
+            head[0] = p->persisted ? SNAP_PROP : SNAP_PROP_VOLATILE;
+            n = 1 + put_string(head + 1, p->name, strlen(p->name));
+            n += put_value(head + n, p->type, &p->value, &tail, &tail_len);
+            snap_record(&w, head, n, tail, tail_len);
+         }
+      }
+   }
+   snap_flush(&w);
+
+   h.frames = w.frames;
+   return w.ok && pwrite(w.fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h);
+}
+
+// Runs in the forked child: no allocation, locks or stdio, only the copy-on-write view
+static void write_snapshot(const bool* writable, off_t log_offset) {
+   int fd = open(g_snap_tmp_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd < 0 || !write_image(fd, g_snap_buf, writable, log_offset, false) || fdatasync(fd) < 0 ||
+      close(fd) < 0 || rename(g_snap_tmp_path, g_snap_path) < 0) {
+      unlink(g_snap_tmp_path);
+      _exit(1);
+   }
+   sync_dir();
+   _exit(0);
+}
+
+// Tables whose rows go into images, decided before the child is forked
+static bool* writable_tables(void) {
+   bool* writable = calloc(g_num_tables + 1, sizeof(bool));
+   for (int t = 0; writable && t < g_num_tables; t++) {
+      writable[t] = table_is_writable(g_tables[t].name);
+   }
+   return writable;
+}
+
+static void start_snapshot(void) {
+   bool* writable = writable_tables();
+   if (!writable) {
+      return;
+   }
+
+   // Everything logged after log_offset is replayed on top of the image, and replaying a
+   // record the image already holds is harmless, so the log is flushed without the model
+   // lock and only the fork holds it, to give the child a consistent model
+   pthread_mutex_lock(&g_io_lock);
+   flush_io_locked();
+   off_t log_offset = g_size;
+   pthread_mutex_unlock(&g_io_lock);
+   model_lock();
+   pid_t pid = fork();
+   if (pid == 0) {
+      write_snapshot(writable, log_offset);
+   }
+   model_unlock();
+   free(writable);
+   if (pid < 0) {
+      fprintf(stderr, "Failed to start a snapshot of %s: %s\n", g_path, strerror(errno));
+      g_last_snapshot_ms = monotonic_ms();
+      return;
+   }
+   g_snap_pid = pid;
+   g_snap_offset = log_offset;
+}
+
+static bool copy_range(int from_fd, int to_fd, off_t from, off_t to, off_t dest) {
+   while (from < to) {
+      size_t chunk = to - from < PERSIST_SNAPSHOT_FRAME ? (size_t)(to - from) : PERSIST_SNAPSHOT_FRAME;
+      ssize_t n = pread(from_fd, g_snap_buf, chunk, from);
+      if (n <= 0 || pwrite(to_fd, g_snap_buf, n, dest) != n) {
+         return false;
+      }
+      from += n;
+      dest += n;
+   }
+   return true;
+}
+
+// Replaces the log with the records the snapshot does not include
+static void compact_log(off_t from) {
+   int fd = open(g_tmp_path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+   if (fd < 0) {
+      fprintf(stderr, "Failed to compact %s: %s\n", g_path, strerror(errno));
+      return;
+   }
+   WalHeader h = {.magic = WAL_MAGIC, .version = WAL_VERSION, .generation = g_generation + 1};
+   pthread_mutex_lock(&g_io_lock);
+   off_t end = g_size;
+   pthread_mutex_unlock(&g_io_lock);
+
+   // Frames up to end are complete and never rewritten, so the bulk is copied unlocked
+   bool ok = pwrite(fd, &h, sizeof(h), 0) == (ssize_t)sizeof(h) &&
+      copy_range(g_fd, fd, from, end, sizeof(h)) && fdatasync(fd) == 0;
+   pthread_mutex_lock(&g_io_lock);
+   ok = ok && copy_range(g_fd, fd, end, g_size, sizeof(h) + end - from) &&
+      (g_size == end || fdatasync(fd) == 0) && rename(g_tmp_path, g_path) == 0;
+   if (ok) {
+      close(g_fd);
+      g_fd = fd;
+      g_size = sizeof(h) + g_size - from;
+      g_covered = sizeof(h);
+      g_generation++;
+   }
+   pthread_mutex_unlock(&g_io_lock);
+   if (!ok) {
+      fprintf(stderr, "Failed to compact %s: %s\n", g_path, strerror(errno));
+      close(fd);
+      unlink(g_tmp_path);
+      g_covered = from;
+      return;
+   }
+   sync_dir();
+}
+
+static void reap_snapshot(void) {
+   int status;
+   pid_t pid = waitpid(g_snap_pid, &status, WNOHANG);
+   if (pid == 0) {
+      return;
+   }
+   g_snap_pid = -1;
+   g_last_snapshot_ms = monotonic_ms();
+   if (pid < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      fprintf(stderr, "Snapshot of %s failed, the log is kept whole\n", g_path);
+      return;
+   }
+   compact_log(g_snap_offset);
+}
+
+static void persist_tick(void* ctx) {
+   (void)ctx;
+   if (g_sync_ms > 0) {
+      persist_flush();
+   }
+   if (g_snap_pid > 0) {
+      reap_snapshot();
+      return;
+   }
+   pthread_mutex_lock(&g_io_lock);
+   off_t uncovered = g_size - g_covered;
+   pthread_mutex_unlock(&g_io_lock);
+   uint64_t now = monotonic_ms();
+   if (uncovered > 0 && g_snap_buf && ((g_snapshot_bytes && uncovered >= (off_t)g_snapshot_bytes) ||
+      (g_snapshot_sec && now - g_last_snapshot_ms >= g_snapshot_sec * 1000ull))) {
+      start_snapshot();
+   }
+}
+
+// Changes are logged from here on; values published at startup are not changes
+void persist_start(void) {
+   if (g_fd < 0) {
+      return;
+   }
+   g_snap_buf = malloc(PERSIST_SNAPSHOT_FRAME);
+   if (!g_snap_buf) {
+      fprintf(stderr, "Out of memory, %s will not be compacted\n", g_path);
+   }
+   g_last_snapshot_ms = monotonic_ms();
+   if (event_loop_add_timer(g_sync_ms ? g_sync_ms : PERSIST_SYNC_MS, persist_tick, NULL) < 0) {
+      fprintf(stderr, "No timer for the value log, flushing every %u records only\n", g_sync_records);
+   }
+   __atomic_store_n(&g_logging, true, __ATOMIC_RELEASE);
+}
+
+void persist_close(void) {
+   __atomic_store_n(&g_logging, false, __ATOMIC_RELEASE);
+   // A snapshot in progress is still valid; the log is compacted on the next one
+   if (g_snap_pid > 0) {
+      waitpid(g_snap_pid, NULL, 0);
+      g_snap_pid = -1;
+   }
+   persist_flush();
+   pthread_mutex_lock(&g_io_lock);
+   pthread_mutex_lock(&g_lock);
+   if (g_fd >= 0) {
+      close(g_fd);
+      g_fd = -1;
+   }
+   free(g_buf);
+   free(g_out);
+   free(g_pending);
+   free(g_snap_buf);
+   g_buf = NULL;
+   g_out = NULL;
+   g_pending = NULL;
+   g_snap_buf = NULL;
+   g_len = g_cap = 0;
+   g_out_len = g_out_cap = 0;
+   g_num_pending = g_pending_cap = 0;
+   pthread_mutex_unlock(&g_lock);
+   pthread_mutex_unlock(&g_io_lock);
+}
+
+// Writes the live model to a sealed memfd for the daemon that replaces this one with
+// exec(); returns the descriptor, which is inherited, or -1
+int persist_handoff_save(void) {
+   crc_init();
+   bool* writable = writable_tables();
+   uint8_t* buf = malloc(PERSIST_SNAPSHOT_FRAME);
+   int fd = memfd_create("rbus-elements-handoff", MFD_ALLOW_SEALING);
+   bool ok = false;
+   if (writable && buf && fd >= 0) {
+      // Sets racing with the image are logged behind log_offset and replayed after it
+      pthread_mutex_lock(&g_io_lock);
+      if (g_fd >= 0) {
+         flush_io_locked();
+      }
+      ok = write_image(fd, buf, writable, g_size, true);
+      pthread_mutex_unlock(&g_io_lock);
+   }
+   free(writable);
+   free(buf);
+   if (!ok || fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE) < 0) {
+      fprintf(stderr, "Failed to write the handoff image: %s\n", strerror(errno));
+      if (fd >= 0) close(fd);
+      return -1;
+   }
+   return fd;
+}
+
+// Takes over the model handed over by the previous daemon, if it passed one
+bool persist_handoff_load(rbusHandle_t handle) {
+   const char* env = getenv(PERSIST_HANDOFF_ENV);
+   if (!env) {
+      return false;
+   }
+   int fd = atoi(env);
+   unsetenv(PERSIST_HANDOFF_ENV);
+   struct stat st;
+   void* data = fstat(fd, &st) == 0 && st.st_size > 0 ?
+      mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+   close(fd);
+   if (data == MAP_FAILED) {
+      fprintf(stderr, "Failed to map the handoff image, seeding the model again\n");
+      return false;
+   }
+
+   crc_init();
+   uint64_t started = monotonic_ms();
+   g_replaying = true;
+   SnapHeader header;
+   bool loaded = load_image(handle, data, st.st_size, "the previous daemon", &header);
+   // Changes logged after the image was written
+   if (loaded && g_configured) {
+      replay_log(handle, &header);
+   }
+   g_replaying = false;
+   munmap(data, st.st_size);
+   if (loaded) {
+      fprintf(stderr, "Took over the model in %llu ms\n", (unsigned long long)(monotonic_ms() - started));
+   }
+   return loaded;
+}
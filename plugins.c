@@ -0,0 +1,399 @@
+#include "rbus_elements.h"
+#include <dlfcn.h>
+#include <dirent.h>
+#include <errno.h>
+
+// Native handlers loaded from shared objects (ABI in rbus_elements_plugin.h). Plugins are
+// loaded before elements.json so "<plugin>/<handler>" references resolve while loading.
+
+struct RbeValueOut {
+   RbeValueType type;
+   union {
+      bool b;
+      int32_t i32;
+      uint32_t u32;
+      int64_t i64;
+      uint64_t u64;
+      double d;
+   } v;
+   char* str;     // buf, or heap for long strings
+   size_t len;
+   size_t cap;
+   char* heap;
+   char buf[PLUGIN_STRING_BYTES];
+};
+
+typedef struct {
+   void* dl;
+   const RbePlugin* desc;
+   char path[MAX_NAME_LEN];
+} LoadedPlugin;
+
+typedef struct {
+   char name[MAX_NAME_LEN];
+   ValueType type;
+   const RbeHandler* handler;
+} PluginBinding;
+
+static LoadedPlugin g_plugins[MAX_PLUGINS];
+static int g_num_plugins = 0;
+static PluginBinding* g_plugin_bindings = NULL;
+static int g_num_plugin_bindings = 0;
+
+static void out_set_bool(RbeValueOut* out, bool v) { out->type = RBE_BOOL; out->v.b = v; }
+static void out_set_int32(RbeValueOut* out, int32_t v) { out->type = RBE_INT32; out->v.i32 = v; }
+static void out_set_uint32(RbeValueOut* out, uint32_t v) { out->type = RBE_UINT32; out->v.u32 = v; }
+static void out_set_int64(RbeValueOut* out, int64_t v) { out->type = RBE_INT64; out->v.i64 = v; }
+static void out_set_uint64(RbeValueOut* out, uint64_t v) { out->type = RBE_UINT64; out->v.u64 = v; }
+static void out_set_double(RbeValueOut* out, double v) { out->type = RBE_DOUBLE; out->v.d = v; }
+
+static char* out_string_buffer(RbeValueOut* out, size_t len) {
+   if (len < sizeof(out->buf)) {
+      out->str = out->buf;
+      out->cap = sizeof(out->buf) - 1;
+      return out->str;
+   }
+   char* heap = realloc(out->heap, len + 1);
+   if (!heap) {
+      return NULL;
+   }
+   out->heap = out->str = heap;
+   out->cap = len;
+   return out->str;
+}
+
+static void out_commit_string(RbeValueOut* out, size_t len) {
+   if (!out->str) return;
+   out->len = len < out->cap ? len : out->cap;
+   out->str[out->len] = '\0';
+   out->type = RBE_STRING;
+}
+
+static void out_set_string(RbeValueOut* out, const char* s, size_t len) {
+   char* p = out_string_buffer(out, len);
+   if (p) {
+      memcpy(p, s, len);
+      out_commit_string(out, len);
+   }
+}
+
+static void host_log(const char* plugin, const char* msg) {
+   fprintf(stderr, "[%s] %s\n", plugin ? plugin : "plugin", msg);
+}
+
+static const RbeHostApi g_host = {
+   .abi_version = RBE_PLUGIN_ABI_VERSION,
+   .size = sizeof(RbeHostApi),
+   .set_bool = out_set_bool,
+   .set_int32 = out_set_int32,
+   .set_uint32 = out_set_uint32,
+   .set_int64 = out_set_int64,
+   .set_uint64 = out_set_uint64,
+   .set_double = out_set_double,
+   .set_string = out_set_string,
+   .string_buffer = out_string_buffer,
+   .commit_string = out_commit_string,
+   .log = host_log,
+};
+
+static void out_init(RbeValueOut* out) {
+   out->type = RBE_NONE;
+   out->str = NULL;
+   out->heap = NULL;
+   out->len = out->cap = 0;
+}
+
+// Convert what the plugin wrote to the element's declared type; strings are not copied
+static bool out_to_element(const RbeValueOut* out, ValueType type, ElementValue* v) {
+   switch (type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64:
+         if (out->type != RBE_STRING) return false;
+         v->strVal = out->str;
+         return true;
+      case TYPE_INT:
+         if (out->type != RBE_INT32) return false;
+         v->intVal = out->v.i32;
+         return true;
+      case TYPE_UINT:
+         if (out->type != RBE_UINT32) return false;
+         v->uintVal = out->v.u32;
+         return true;
+      case TYPE_BOOL:
+         if (out->type != RBE_BOOL) return false;
+         v->boolVal = out->v.b;
+         return true;
+      case TYPE_LONG:
+         if (out->type != RBE_INT64 && out->type != RBE_INT32) return false;
+         v->longVal = out->type == RBE_INT64 ? out->v.i64 : out->v.i32;
+         return true;
+      case TYPE_ULONG:
+         if (out->type != RBE_UINT64 && out->type != RBE_UINT32) return false;
+         v->ulongVal = out->type == RBE_UINT64 ? out->v.u64 : out->v.u32;
+         return true;
+      case TYPE_FLOAT:
+         if (out->type != RBE_DOUBLE) return false;
+         v->floatVal = (float)out->v.d;
+         return true;
+      case TYPE_DOUBLE:
+         if (out->type != RBE_DOUBLE) return false;
+         v->doubleVal = out->v.d;
+         return true;
+      case TYPE_BYTE:
+         if (out->type != RBE_UINT32 || out->v.u32 > UINT8_MAX) return false;
+         v->byteVal = (uint8_t)out->v.u32;
+         return true;
+   }
+   return false;
+}
+
+// Inputs are passed by reference: strings point into the rbus value
+static bool value_in(rbusValue_t value, RbeValue* in) {
+   switch (value ? rbusValue_GetType(value) : RBUS_NONE) {
+      case RBUS_BOOLEAN: in->type = RBE_BOOL; in->v.b = rbusValue_GetBoolean(value); return true;
+      case RBUS_INT32: in->type = RBE_INT32; in->v.i32 = rbusValue_GetInt32(value); return true;
+      case RBUS_UINT32: in->type = RBE_UINT32; in->v.u32 = rbusValue_GetUInt32(value); return true;
+      case RBUS_INT64: in->type = RBE_INT64; in->v.i64 = rbusValue_GetInt64(value); return true;
+      case RBUS_UINT64: in->type = RBE_UINT64; in->v.u64 = rbusValue_GetUInt64(value); return true;
+      case RBUS_BYTE: in->type = RBE_UINT32; in->v.u32 = rbusValue_GetByte(value); return true;
+      case RBUS_SINGLE: in->type = RBE_DOUBLE; in->v.d = rbusValue_GetSingle(value); return true;
+      case RBUS_DOUBLE: in->type = RBE_DOUBLE; in->v.d = rbusValue_GetDouble(value); return true;
+      case RBUS_STRING:
+         in->type = RBE_STRING;
+         in->v.s.ptr = rbusValue_GetString(value, NULL);
+         in->v.s.len = in->v.s.ptr ? strlen(in->v.s.ptr) : 0;
+         return true;
+      default:
+         in->type = RBE_NONE;
+         return false;
+   }
+}
+
+static rbusError_t plugin_error(int rc) {
+   switch (rc) {
+      case RBE_OK: return RBUS_ERROR_SUCCESS;
+      case RBE_INVALID_INPUT: return RBUS_ERROR_INVALID_INPUT;
+      case RBE_ACCESS_NOT_ALLOWED: return RBUS_ERROR_ACCESS_NOT_ALLOWED;
+      default: return RBUS_ERROR_BUS_ERROR;
+   }
+}
+
+static bool load_plugin(const char* path) {
+   void* dl = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+   if (!dl) {
+      fprintf(stderr, "Failed to load plugin %s: %s\n", path, dlerror());
+      return false;
+   }
+   RbePluginInitFn init;
+   *(void**)&init = dlsym(dl, RBE_PLUGIN_ENTRY);
+   const RbePlugin* desc = init ? init(&g_host) : NULL;
+   if (!desc || desc->abi_version != RBE_PLUGIN_ABI_VERSION || !desc->name || desc->num_handlers < 0) {
+      fprintf(stderr, "Plugin %s has no compatible %s (ABI %d)\n", path, RBE_PLUGIN_ENTRY, RBE_PLUGIN_ABI_VERSION);
+      dlclose(dl);
+      return false;
+   }
+   for (int i = 0; i < g_num_plugins; i++) {
+      if (strcmp(g_plugins[i].desc->name, desc->name) == 0) {
+         fprintf(stderr, "Plugin %s: name %s already loaded from %s\n", path, desc->name, g_plugins[i].path);
+         if (desc->shutdown) desc->shutdown();
+         dlclose(dl);
+         return false;
+      }
+   }
+
+   LoadedPlugin* p = &g_plugins[g_num_plugins++];
+   p->dl = dl;
+   p->desc = desc;
+   snprintf(p->path, sizeof(p->path), "%s", path);
+   printf("Loaded plugin %s (%d handlers) from %s\n", desc->name, desc->num_handlers, path);
+   return true;
+}
+
+static int plugin_file(const struct dirent* d) {
+   size_t len = strlen(d->d_name);
+   return len > 3 && strcmp(d->d_name + len - 3, ".so") == 0;
+}
+
+int plugin_load_dir(const char* dir) {
+   struct dirent** names = NULL;
+   int n = scandir(dir, &names, plugin_file, alphasort);
+   if (n < 0) {
+      if (errno != ENOENT) {
+         fprintf(stderr, "Failed to read plugin directory %s: %s\n", dir, strerror(errno));
+      }
+      return 0;
+   }
+   int loaded = 0;
+   for (int i = 0; i < n; i++) {
+      char path[MAX_NAME_LEN];
+      if (g_num_plugins == MAX_PLUGINS) {
+         fprintf(stderr, "Plugin limit %d reached, skipping %s\n", MAX_PLUGINS, names[i]->d_name);
+      } else if (snprintf(path, sizeof(path), "%s/%s", dir, names[i]->d_name) < (int)sizeof(path) && load_plugin(path)) {
+         loaded++;
+      }
+      free(names[i]);
+   }
+   free(names);
+   return loaded;
+}
+
+const RbeHandler* plugin_find_handler(const char* ref) {
+   const char* slash = strchr(ref, '/');
+   if (!slash) {
+      return NULL;
+   }
+   size_t plen = (size_t)(slash - ref);
+   for (int i = 0; i < g_num_plugins; i++) {
+      const RbePlugin* desc = g_plugins[i].desc;
+      if (strlen(desc->name) != plen || strncmp(desc->name, ref, plen) != 0) continue;
+      for (int j = 0; j < desc->num_handlers; j++) {
+         if (desc->handlers[j].name && strcmp(desc->handlers[j].name, slash + 1) == 0) {
+            return &desc->handlers[j];
+         }
+      }
+   }
+   return NULL;
+}
+
+bool plugin_bind_property(const char* name, ValueType type, const char* ref, int index) {
+   const RbeHandler* h = plugin_find_handler(ref);
+   if (!h || !h->get) {
+      fprintf(stderr, "No plugin getter %s for item %d\n", ref, index);
+      return false;
+   }
+   PluginBinding* bindings = realloc(g_plugin_bindings, (g_num_plugin_bindings + 1) * sizeof(PluginBinding));
+   if (!bindings) {
+      fprintf(stderr, "Failed to allocate memory for plugin bindings\n");
+      return false;
+   }
+   g_plugin_bindings = bindings;
+   PluginBinding* b = &g_plugin_bindings[g_num_plugin_bindings++];
+   snprintf(b->name, MAX_NAME_LEN, "%s", name);
+   b->type = type;
+   b->handler = h;
+   return true;
+}
+
+static int compare_plugin_bindings(const void* a, const void* b) {
+   return strcmp(((const PluginBinding*)a)->name, ((const PluginBinding*)b)->name);
+}
+
+// Bindings are searched from rbus threads without a lock, so they are sorted once
+// after elements.json is loaded and never move afterwards
+void plugin_finish_load(void) {
+   qsort(g_plugin_bindings, g_num_plugin_bindings, sizeof(PluginBinding), compare_plugin_bindings);
+}
+
+static PluginBinding* find_plugin_binding(const char* name) {
+   PluginBinding key;
+   snprintf(key.name, MAX_NAME_LEN, "%s", name);
+   return bsearch(&key, g_plugin_bindings, g_num_plugin_bindings, sizeof(PluginBinding), compare_plugin_bindings);
+}
+
+rbusError_t plugin_get_handler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+   const char* name = rbusProperty_GetName(property);
+   PluginBinding* b = find_plugin_binding(name);
+   if (!b) {
+      return RBUS_ERROR_ELEMENT_DOES_NOT_EXIST;
+   }
+
+   RbeValueOut out;
+   out_init(&out);
+   rbusError_t rc = plugin_error(b->handler->get(b->handler->ctx, name, &out));
+   ElementValue v;
+   if (rc == RBUS_ERROR_SUCCESS && !out_to_element(&out, b->type, &v)) {
+      fprintf(stderr, "Plugin getter for %s returned the wrong type\n", name);
+      rc = RBUS_ERROR_BUS_ERROR;
+   }
+   if (rc == RBUS_ERROR_SUCCESS) {
+      rbusValue_t value;
+      rbusValue_Init(&value);
+      value_to_rbus(value, b->type, &v);
+      rbusProperty_SetValue(property, value);
+      rbusValue_Release(value);
+   }
+   free(out.heap);
+   return rc;
+}
+
+static rbusError_t plugin_set(const char* name, rbusValue_t value) {
+   PluginBinding* b = find_plugin_binding(name);
+   if (!b) {
+      return RBUS_ERROR_ELEMENT_DOES_NOT_EXIST;
+   }
+   if (!b->handler->set) {
+      return RBUS_ERROR_ACCESS_NOT_ALLOWED;
+   }
+   RbeValue in;
+   if (!value || !value_type_matches(b->type, value) || !value_in(value, &in)) {
+      return RBUS_ERROR_INVALID_INPUT;
+   }
+   return plugin_error(b->handler->set(b->handler->ctx, name, &in));
+}
+
+rbusError_t plugin_set_handler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+   rbusError_t rc = plugin_set(rbusProperty_GetName(property), rbusProperty_GetValue(property));
+   return set_session_end(handle, options, rc);
+}
+
+rbusError_t plugin_call_method(const RbeHandler* h, const char* method, rbusValue_t const* args, int num_args, const MethodArg* outs, int num_outs, rbusObject_t outParams) {
+   RbeValue in[METHOD_MAX_ARGS];
+   RbeValueOut out[METHOD_MAX_ARGS];
+   RbeValueOut* outp[METHOD_MAX_ARGS];
+   for (int i = 0; i < num_args; i++) {
+      value_in(args[i], &in[i]); // objects are not representable and arrive as RBE_NONE
+   }
+   for (int i = 0; i < num_outs; i++) {
+      out_init(&out[i]);
+      outp[i] = &out[i];
+   }
+
+   rbusError_t rc = plugin_error(h->method(h->ctx, method, in, num_args, outp, num_outs));
+   for (int i = 0; i < num_outs; i++) {
+      ElementValue v;
+      if (rc == RBUS_ERROR_SUCCESS && out[i].type != RBE_NONE) {
+         if (outs[i].type == METHOD_ARG_OBJECT || !out_to_element(&out[i], (ValueType)outs[i].type, &v)) {
+            fprintf(stderr, "%s returned %s with the wrong type\n", method, outs[i].name);
+            rc = RBUS_ERROR_BUS_ERROR;
+         } else {
+            rbusValue_t value;
+            rbusValue_Init(&value);
+            value_to_rbus(value, (ValueType)outs[i].type, &v);
+            rbusObject_SetValue(outParams, outs[i].name, value);
+            rbusValue_Release(value);
+         }
+      }
+      free(out[i].heap);
+   }
+   return rc;
+}
+
+static void plugin_sample_tick(void* ctx) {
+   const RbePlugin* desc = (const RbePlugin*)ctx;
+   desc->sample(desc->sample_ctx);
+}
+
+void plugin_start(void) {
+   for (int i = 0; i < g_num_plugins; i++) {
+      const RbePlugin* desc = g_plugins[i].desc;
+      if (!desc->sample || desc->sample_interval_ms == 0) continue;
+      if (event_loop_add_timer(desc->sample_interval_ms, plugin_sample_tick, (void*)desc) < 0) {
+         fprintf(stderr, "Failed to schedule the %s plugin sampler\n", desc->name);
+      }
+   }
+}
+
+void plugin_cleanup(void) {
+   free(g_plugin_bindings);
+   g_plugin_bindings = NULL;
+   g_num_plugin_bindings = 0;
+   for (int i = g_num_plugins - 1; i >= 0; i--) {
+      if (g_plugins[i].desc->shutdown) {
+         g_plugins[i].desc->shutdown();
+      }
+      dlclose(g_plugins[i].dl);
+   }
+   g_num_plugins = 0;
+}
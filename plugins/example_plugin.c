@@ -0,0 +1,98 @@
+// Example plugin: build as a shared object, drop it into the plugin directory and bind
+// elements to "example/<handler>":
+//
+//   {"name": "Device.X_Example.LoadAverage", "type": 0, "plugin": "example/loadavg"}
+//   {"name": "Device.X_Example.Counter", "type": 2, "plugin": "example/counter"}
+//   {"name": "Device.X_Example.Add()", "elementType": "method", "handler": "plugin:example/add",
+//    "input": [{"name": "A", "type": 1, "required": true}, {"name": "B", "type": 1, "required": true}],
+//    "output": [{"name": "Sum", "type": 6}]}
+#include "rbus_elements_plugin.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+
+static const RbeHostApi* g_host;
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static char g_loadavg[64];
+static size_t g_loadavg_len;
+static uint32_t g_counter;
+
+// Sampler: refresh the cached value on the main loop so gets never touch /proc
+static void sample(void* ctx) {
+   (void)ctx;
+   char buf[sizeof(g_loadavg)];
+   int fd = open("/proc/loadavg", O_RDONLY | O_CLOEXEC);
+   ssize_t n = fd >= 0 ? read(fd, buf, sizeof(buf) - 1) : -1;
+   if (fd >= 0) close(fd);
+   if (n <= 0) return;
+
+   // First three fields only
+   size_t len = 0;
+   for (int fields = 0; len < (size_t)n; len++) {
+      if (buf[len] == ' ' && ++fields == 3) break;
+   }
+   pthread_mutex_lock(&g_lock);
+   memcpy(g_loadavg, buf, len);
+   g_loadavg_len = len;
+   pthread_mutex_unlock(&g_lock);
+}
+
+static int get_loadavg(void* ctx, const char* name, RbeValueOut* out) {
+   (void)ctx; (void)name;
+   // Written straight into the host's buffer, no intermediate copy
+   char* p = g_host->string_buffer(out, sizeof(g_loadavg));
+   if (!p) return RBE_ERROR;
+   pthread_mutex_lock(&g_lock);
+   size_t len = g_loadavg_len;
+   memcpy(p, g_loadavg, len);
+   pthread_mutex_unlock(&g_lock);
+   g_host->commit_string(out, len);
+   return RBE_OK;
+}
+
+static int get_counter(void* ctx, const char* name, RbeValueOut* out) {
+   (void)ctx; (void)name;
+   g_host->set_uint32(out, __atomic_load_n(&g_counter, __ATOMIC_RELAXED));
+   return RBE_OK;
+}
+
+static int set_counter(void* ctx, const char* name, const RbeValue* value) {
+   (void)ctx; (void)name;
+   if (value->type != RBE_UINT32) return RBE_INVALID_INPUT;
+   __atomic_store_n(&g_counter, value->v.u32, __ATOMIC_RELAXED);
+   return RBE_OK;
+}
+
+static int add(void* ctx, const char* method, const RbeValue* args, int num_args, RbeValueOut* const* outs, int num_outs) {
+   (void)ctx; (void)method;
+   if (num_args < 2 || num_outs < 1 || args[0].type != RBE_INT32 || args[1].type != RBE_INT32) {
+      return RBE_INVALID_INPUT;
+   }
+   g_host->set_int64(outs[0], (int64_t)args[0].v.i32 + args[1].v.i32);
+   return RBE_OK;
+}
+
+static const RbeHandler g_handlers[] = {
+   {.name = "loadavg", .get = get_loadavg},
+   {.name = "counter", .get = get_counter, .set = set_counter},
+   {.name = "add", .method = add},
+};
+
+static const RbePlugin g_plugin = {
+   .abi_version = RBE_PLUGIN_ABI_VERSION,
+   .name = "example",
+   .handlers = g_handlers,
+   .num_handlers = sizeof(g_handlers) / sizeof(g_handlers[0]),
+   .sample_interval_ms = 1000,
+   .sample = sample,
+};
+
+const RbePlugin* rbe_plugin_init(const RbeHostApi* host) {
+   if (host->abi_version != RBE_PLUGIN_ABI_VERSION) {
+      return NULL;
+   }
+   g_host = host;
+   sample(NULL);
+   return &g_plugin;
+}
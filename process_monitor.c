@@ -0,0 +1,366 @@
+#include "rbus_elements.h"
+
+extern rbusHandle_t g_rbusHandle;
+
+static uint32_t g_cpu_usage = 0;
+
+rbusError_t get_cpu_usage(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   rbusValue_SetUInt32(value, __atomic_load_n(&g_cpu_usage, __ATOMIC_RELAXED));
+   rbusProperty_SetValue(property, value);
+   rbusValue_Release(value);
+   return RBUS_ERROR_SUCCESS;
+}
+
+#ifdef __APPLE__
+void process_monitor_init(void) {
+}
+
+void process_monitor_stop(void) {
+}
+#else
+#include <pthread.h>
+#include <sys/syscall.h>
+
+typedef struct {
+   uint32_t pid;
+   char command[PROCESS_COMMAND_LEN];
+   char state;
+   uint32_t size_kb;
+   uint32_t priority;
+   uint32_t cpu_time_ms;
+} ProcessSample;
+
+typedef struct {
+   uint64_t generation;
+   int count;
+   ProcessSample procs[PROCESS_MAX_ENTRIES];
+} ProcessSnapshot;
+
+// The sampler thread fills the back buffer and publishes it by flipping g_published.
+// The main thread marks the buffer it is reading in g_reading; the sampler skips a
+// cycle rather than overwrite it.
+static ProcessSnapshot g_snapshots[2];
+static int g_published = 0;
+static int g_reading = -1;
+static uint64_t g_applied = 0;
+
+static pthread_t g_sampler;
+static bool g_sampler_started = false;
+static bool g_sampler_stop = false;
+static pthread_mutex_t g_sampler_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_sampler_cond = PTHREAD_COND_INITIALIZER;
+
+// Sampler-thread state, reused across samples
+static int g_proc_fd = -1;
+static int g_stat_fd = -1;
+static uint64_t g_prev_total = 0, g_prev_idle = 0;
+static long g_clk_tck = 100;
+static long g_page_kb = 4;
+
+// Row mapping used only by the main thread, sorted by pid
+static uint32_t g_row_pid[PROCESS_MAX_ENTRIES];
+static uint32_t g_row_inst[PROCESS_MAX_ENTRIES];
+static int g_num_rows = 0;
+
+struct linux_dirent64 {
+   uint64_t d_ino;
+   int64_t d_off;
+   unsigned short d_reclen;
+   unsigned char d_type;
+   char d_name[];
+};
+
+static const char* parse_u64(const char* p, uint64_t* out) {
+   while (*p == ' ') p++;
+   bool neg = *p == '-';
+   if (neg) p++;
+   uint64_t v = 0;
+   while (*p >= '0' && *p <= '9') v = v * 10 + (uint64_t)(*p++ - '0');
+   *out = neg ? (uint64_t)-(int64_t)v : v;
+   return p;
+}
+
+static ssize_t pread_all(int fd, char* buf, size_t size) {
+   ssize_t n;
+   do {
+      n = pread(fd, buf, size - 1, 0);
+   } while (n < 0 && errno == EINTR);
+   if (n >= 0) buf[n] = '\0';
+   return n;
+}
+
+static void sample_cpu(void) {
+   char buf[512];
+   if (g_stat_fd < 0 || pread_all(g_stat_fd, buf, sizeof(buf)) <= 0 || strncmp(buf, "cpu ", 4) != 0) {
+      return;
+   }
+
+   // cpu  user nice system idle iowait irq softirq steal
+   uint64_t v[8] = {0};
+   const char* p = buf + 4;
+   for (int i = 0; i < 8; i++) p = parse_u64(p, &v[i]);
+   uint64_t idle = v[3] + v[4];
+   uint64_t total = 0;
+   for (int i = 0; i < 8; i++) total += v[i];
+
+   if (g_prev_total != 0 && total > g_prev_total) {
+      uint64_t dt = total - g_prev_total;
+      uint64_t di = idle - g_prev_idle;
+      __atomic_store_n(&g_cpu_usage, (uint32_t)(di < dt ? (dt - di) * 100 / dt : 0), __ATOMIC_RELAXED);
+   }
+   g_prev_total = total;
+   g_prev_idle = idle;
+}
+
+static bool sample_process(uint32_t pid, const char* dir, ProcessSample* out) {
+   char path[32];
+   snprintf(path, sizeof(path), "%s/stat", dir);
+   int fd = openat(g_proc_fd, path, O_RDONLY | O_CLOEXEC);
+   if (fd < 0) return false;
+   char buf[1024];
+   ssize_t n = pread_all(fd, buf, sizeof(buf));
+   close(fd);
+   if (n <= 0) return false;
+
+   // The command can contain spaces and parentheses, so it ends at the last ')'
+   char* open = strchr(buf, '(');
+   char* close_paren = strrchr(buf, ')');
+   if (!open || !close_paren || close_paren < open || close_paren[1] != ' ') return false;
+   size_t clen = (size_t)(close_paren - open - 1);
+   if (clen >= sizeof(out->command)) clen = sizeof(out->command) - 1;
+   memcpy(out->command, open + 1, clen);
+   out->command[clen] = '\0';
+
+   // Fields after the command, starting at field 3 (state)
+   const char* p = close_paren + 2;
+   out->state = *p++;
+   uint64_t f[21] = {0}; // f[k] is field k + 4
+   for (int k = 0; k < 21; k++) p = parse_u64(p, &f[k]);
+
+   uint64_t ticks = f[10] + f[11];                 // utime + stime
+   int64_t prio = (int64_t)f[14];                  // priority
+   out->pid = pid;
+   out->cpu_time_ms = (uint32_t)(ticks * 1000 / (uint64_t)g_clk_tck);
+   out->priority = prio < 0 ? 0 : (prio > 99 ? 99 : (uint32_t)prio);
+   out->size_kb = (uint32_t)(f[20] * (uint64_t)g_page_kb); // rss pages
+   return true;
+}
+
+static void sample_processes(ProcessSnapshot* snap) {
+   snap->count = 0;
+   if (g_proc_fd < 0 || lseek(g_proc_fd, 0, SEEK_SET) < 0) return;
+
+   char buf[8192] __attribute__((aligned(8)));
+   for (;;) {
+      long n = syscall(SYS_getdents64, g_proc_fd, buf, sizeof(buf));
+      if (n <= 0) break;
+      for (long off = 0; off < n;) {
+         struct linux_dirent64* d = (struct linux_dirent64*)(buf + off);
+         off += d->d_reclen;
+         if (d->d_name[0] < '1' || d->d_name[0] > '9') continue;
+
+         uint64_t pid;
+         if (*parse_u64(d->d_name, &pid) != '\0') continue;
+         if (snap->count >= PROCESS_MAX_ENTRIES) return;
+
+         if (sample_process((uint32_t)pid, d->d_name, &snap->procs[snap->count])) {
+            // /proc is listed in pid order almost always; insertion keeps it sorted without allocating
+            int k = snap->count++;
+            while (k > 0 && snap->procs[k - 1].pid > snap->procs[k].pid) {
+               ProcessSample t = snap->procs[k];
+               snap->procs[k] = snap->procs[k - 1];
+               snap->procs[k - 1] = t;
+               k--;
+            }
+         }
+      }
+   }
+}
+
+static void* sampler_main(void* arg) {
+   (void)arg;
+   uint64_t generation = 0;
+
+   pthread_mutex_lock(&g_sampler_lock);
+   while (!g_sampler_stop) {
+      pthread_mutex_unlock(&g_sampler_lock);
+
+      sample_cpu();
+      int back = __atomic_load_n(&g_published, __ATOMIC_SEQ_CST) ^ 1;
+      if (__atomic_load_n(&g_reading, __ATOMIC_SEQ_CST) != back) {
+         sample_processes(&g_snapshots[back]);
+         g_snapshots[back].generation = ++generation;
+         __atomic_store_n(&g_published, back, __ATOMIC_SEQ_CST);
+      }
+
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_sec += PROCESS_SAMPLE_INTERVAL;
+      pthread_mutex_lock(&g_sampler_lock);
+      while (!g_sampler_stop && pthread_cond_timedwait(&g_sampler_cond, &g_sampler_lock, &deadline) == 0) {
+      }
+   }
+   pthread_mutex_unlock(&g_sampler_lock);
+   return NULL;
+}
+
+static const char* state_name(char state) {
+   switch (state) {
+      case 'R': return "Running";
+      case 'D': return "Uninterruptible";
+      case 'T':
+      case 't': return "Stopped";
+      case 'Z': return "Zombie";
+      case 'I': return "Idle";
+      default: return "Sleeping";
+   }
+}
+
+// The process table is provider-owned, so its values stay out of the change log and
+// GetIfModified always reports them
+static void update_uint(TableRow* row, const char* prop, uint32_t v) {
+   RowProperty* p = row_property(row, prop, TYPE_UINT);
+   if (p) p->value.uintVal = v;
+}
+
+static void update_string(TableRow* row, const char* prop, const char* v) {
+   RowProperty* p = row_property(row, prop, TYPE_STRING);
+   if (!p || (p->value.strVal && strcmp(p->value.strVal, v) == 0)) return;
+   char* str = strdup(v);
+   if (!str) return;
+   free(p->value.strVal);
+   p->value.strVal = str;
+}
+
+static void apply_sample(TableRow* row, const ProcessSample* s) {
+   update_uint(row, "PID", s->pid);
+   update_string(row, "Command", s->command);
+   update_uint(row, "Size", s->size_kb);
+   update_uint(row, "Priority", s->priority);
+   update_uint(row, "CPUTime", s->cpu_time_ms);
+   update_string(row, "State", state_name(s->state));
+}
+
+static void remove_process_row(uint32_t inst) {
+   char row_name[MAX_NAME_LEN];
+   snprintf(row_name, sizeof(row_name), "%s%u.", PROCESS_TABLE, inst);
+   rbusTable_unregisterRow(g_rbusHandle, row_name);
+   table_remove_row(g_rbusHandle, row_name);
+}
+
+static uint32_t add_process_row(const ProcessSample* s) {
+   uint32_t inst = 0;
+   if (table_add_row(g_rbusHandle, PROCESS_TABLE, NULL, &inst) != RBUS_ERROR_SUCCESS) {
+      return 0;
+   }
+   TableRow* row = find_row(find_table(PROCESS_TABLE), inst);
+   if (row) {
+      apply_sample(row, s);
+   }
+   rbusError_t rc = rbusTable_registerRow(g_rbusHandle, PROCESS_TABLE, inst, NULL);
+   if (rc != RBUS_ERROR_SUCCESS) {
+      fprintf(stderr, "Failed to register process row %s%u.: %d\n", PROCESS_TABLE, inst, rc);
+   }
+   return inst;
+}
+
+// Merge the snapshot into the table: rows for exited pids are removed, new pids get a
+// row, and existing rows only have their changed properties rewritten
+static void apply_snapshot(const ProcessSnapshot* snap) {
+   static uint32_t new_pid[PROCESS_MAX_ENTRIES];
+   static uint32_t new_inst[PROCESS_MAX_ENTRIES];
+   int n = 0, i = 0, j = 0;
+   TableDef* table = find_table(PROCESS_TABLE);
+
+   while (i < g_num_rows || j < snap->count) {
+      if (j >= snap->count || (i < g_num_rows && g_row_pid[i] < snap->procs[j].pid)) {
+         remove_process_row(g_row_inst[i++]);
+      } else if (i >= g_num_rows || g_row_pid[i] > snap->procs[j].pid) {
+         uint32_t inst = add_process_row(&snap->procs[j]);
+         if (inst) {
+            new_pid[n] = snap->procs[j].pid;
+            new_inst[n++] = inst;
+         }
+         j++;
+         table = find_table(PROCESS_TABLE);
+      } else {
+         TableRow* row = table ? find_row(table, g_row_inst[i]) : NULL;
+         if (row) {
+            apply_sample(row, &snap->procs[j]);
+         }
+         new_pid[n] = g_row_pid[i];
+         new_inst[n++] = g_row_inst[i];
+         i++;
+         j++;
+      }
+   }
+
+   memcpy(g_row_pid, new_pid, n * sizeof(uint32_t));
+   memcpy(g_row_inst, new_inst, n * sizeof(uint32_t));
+   g_num_rows = n;
+}
+
+static void process_monitor_tick(void* ctx) {
+   (void)ctx;
+   int idx = __atomic_load_n(&g_published, __ATOMIC_SEQ_CST);
+   __atomic_store_n(&g_reading, idx, __ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&g_published, __ATOMIC_SEQ_CST) == idx && g_snapshots[idx].generation > g_applied) {
+      model_lock();
+      apply_snapshot(&g_snapshots[idx]);
+      model_unlock();
+      g_applied = g_snapshots[idx].generation;
+   }
+   __atomic_store_n(&g_reading, -1, __ATOMIC_SEQ_CST);
+}
+
+void process_monitor_init(void) {
+   g_clk_tck = sysconf(_SC_CLK_TCK);
+   if (g_clk_tck <= 0) g_clk_tck = 100;
+   long page = sysconf(_SC_PAGESIZE);
+   g_page_kb = page > 0 ? page / 1024 : 4;
+
+   g_proc_fd = open("/proc", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   g_stat_fd = open("/proc/stat", O_RDONLY | O_CLOEXEC);
+   if (g_proc_fd < 0 || g_stat_fd < 0) {
+      fprintf(stderr, "Process monitor disabled: /proc unavailable\n");
+      process_monitor_stop();
+      return;
+   }
+
+   if (!find_table(PROCESS_TABLE)) {
+      create_table(PROCESS_TABLE);
+   }
+
+   // Pending snapshots are merged on the main thread under the model lock, since rbus
+   // threads read the same rows
+   if (event_loop_add_timer(1000, process_monitor_tick, NULL) < 0) {
+      fprintf(stderr, "Failed to schedule process table updates\n");
+      process_monitor_stop();
+      return;
+   }
+   if (pthread_create(&g_sampler, NULL, sampler_main, NULL) != 0) {
+      fprintf(stderr, "Failed to start process sampler\n");
+      process_monitor_stop();
+      return;
+   }
+   g_sampler_started = true;
+}
+
+void process_monitor_stop(void) {
+   if (g_sampler_started) {
+      pthread_mutex_lock(&g_sampler_lock);
+      g_sampler_stop = true;
+      pthread_cond_signal(&g_sampler_cond);
+      pthread_mutex_unlock(&g_sampler_lock);
+      pthread_join(g_sampler, NULL);
+      g_sampler_started = false;
+   }
+   if (g_proc_fd >= 0) close(g_proc_fd);
+   if (g_stat_fd >= 0) close(g_stat_fd);
+   g_proc_fd = g_stat_fd = -1;
+   g_num_rows = 0;
+}
+#endif
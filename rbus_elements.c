@@ -21,6 +21,7 @@ typedef struct {
 static char* get_parent_table(const char* table_wild);
 static char* get_parent_concrete(const char* c_table, uint32_t* p_inst);
 static void ensure_table(const char* table_wild);
+static bool add_version_element(const char* target);
 static int count_indices(const char* name);
 
 // Signal handler for SIGINT and SIGTERM
@@ -29,6 +30,16 @@ static void signal_handler(int sig) {
    g_running = 0;
 }
 
+// SIGUSR2: stop and exec the (upgraded) binary, handing the model over
+static volatile sig_atomic_t g_handoff = 0;
+static char g_self_path[MAX_NAME_LEN];
+
+static void handoff_handler(int sig) {
+   (void)sig;
+   g_handoff = 1;
+   g_running = 0;
+}
+
 static bool is_digit_str(const char* str) {
    if (*str == '\0') return false;
    char* end;
@@ -53,6 +64,7 @@ static const DataElement gDataElements[] = {
       .value.strVal = "unknown",
       .getHandler = get_first_ip,
       .setHandler = NULL,
+      .eventSubHandler = ip_cache_sub_handler,
    },
    {
       .name = "Device.DeviceInfo.X_COMCAST-COM_WAN_IP",
@@ -61,6 +73,7 @@ static const DataElement gDataElements[] = {
       .value.strVal = "unknown",
       .getHandler = get_first_ip,
       .setHandler = NULL,
+      .eventSubHandler = ip_cache_sub_handler,
    },
    {
       .name = "Device.DeviceInfo.X_COMCAST-COM_CM_IP",
@@ -69,6 +82,7 @@ static const DataElement gDataElements[] = {
       .value.strVal = "unknown",
       .getHandler = get_first_ip,
       .setHandler = NULL,
+      .eventSubHandler = ip_cache_sub_handler,
    },
    {
       .name = "Device.DeviceInfo.X_RDKCENTRAL-COM_SystemTime",
@@ -134,6 +148,14 @@ static const DataElement gDataElements[] = {
       .getHandler = get_memory_free,
       .setHandler = NULL,
    },
+   {
+      .name = "Device.X_RbusElements.MemoryRefreshInterval",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = MEMORY_CACHE_TIMEOUT * 1000,
+      .getHandler = get_memory_refresh_interval,
+      .setHandler = set_memory_refresh_interval,
+   },
    {
       .name = "Device.DeviceInfo.ManufacturerOUI",
       .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
@@ -151,11 +173,198 @@ static const DataElement gDataElements[] = {
       .setHandler = NULL,
    },
    {
-      .name = "Device.SystemStatusChanged!",
+      .name = SYSTEM_STATUS_EVENT,
+      .elementType = RBUS_ELEMENT_TYPE_EVENT,
+      .type = TYPE_STRING, // Not used for events
+      .value.strVal = "",
+      .eventSubHandler = status_monitor_sub_handler,
+   },
+   {
+      .name = ALARM_EVENT,
+      .elementType = RBUS_ELEMENT_TYPE_EVENT,
+      .type = TYPE_STRING, // Not used for events
+      .value.strVal = "",
+      .eventSubHandler = NULL,
+   },
+   {
+      .name = SET_COMMIT_EVENT,
       .elementType = RBUS_ELEMENT_TYPE_EVENT,
       .type = TYPE_STRING, // Not used for events
       .value.strVal = "",
       .eventSubHandler = NULL,
+   },
+   {
+      .name = TELEMETRY_BATCH_EVENT,
+      .elementType = RBUS_ELEMENT_TYPE_EVENT,
+      .type = TYPE_STRING, // Not used for events
+      .value.strVal = "",
+      .eventSubHandler = NULL,
+   },
+   {
+      .name = ALARM_TABLE "{i}.",
+      .elementType = RBUS_ELEMENT_TYPE_TABLE,
+      .type = TYPE_STRING, // Not used for tables
+      .value.strVal = "",
+      .tableAddRowHandler = NULL, // rows are owned by the alarm engine
+      .tableRemoveRowHandler = NULL,
+   },
+   {
+      .name = "Device.Telemetry.Stats.EventsPerSecond",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .getHandler = get_telemetry_stat,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.Telemetry.Stats.Received",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_ULONG,
+      .value.ulongVal = 0,
+      .getHandler = get_telemetry_stat,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.Telemetry.Stats.Delivered",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_ULONG,
+      .value.ulongVal = 0,
+      .getHandler = get_telemetry_stat,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.Telemetry.Stats.Dropped",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_ULONG,
+      .value.ulongVal = 0,
+      .getHandler = get_telemetry_stat,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.Telemetry.Stats.Spooled",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .getHandler = get_telemetry_stat,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.Telemetry.Stats.QueueDepth",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .getHandler = get_telemetry_stat,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.DeviceInfo.ProcessStatus.CPUUsage",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .getHandler = get_cpu_usage,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.DeviceInfo.ProcessStatus.ProcessNumberOfEntries",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .getHandler = getTableHandler,
+      .setHandler = NULL,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.",
+      .elementType = RBUS_ELEMENT_TYPE_TABLE,
+      .type = TYPE_STRING, // Not used for tables
+      .value.strVal = "",
+      .tableAddRowHandler = NULL, // rows are owned by the process monitor
+      .tableRemoveRowHandler = NULL,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.PID",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.Command",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_STRING,
+      .value.strVal = "",
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.Size",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.Priority",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.CPUTime",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = PROCESS_TABLE "{i}.State",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_STRING,
+      .value.strVal = "",
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = "Device.X_RbusElements.ModelVersion",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_ULONG,
+      .value.ulongVal = 0,
+      .getHandler = get_model_version,
+      .setHandler = NULL,
+   },
+   {
+      .name = "Device.X_RbusElements.AlarmNumberOfEntries",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_UINT,
+      .value.uintVal = 0,
+      .getHandler = getTableHandler,
+      .setHandler = NULL,
+   },
+   {
+      .name = ALARM_TABLE "{i}.RuleName",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_STRING,
+      .value.strVal = "",
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = ALARM_TABLE "{i}.Target",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_STRING,
+      .value.strVal = "",
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = ALARM_TABLE "{i}.Value",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_DOUBLE,
+      .value.doubleVal = 0,
+      .setHandler = readOnlySetHandler,
+   },
+   {
+      .name = ALARM_TABLE "{i}.RaisedTime",
+      .elementType = RBUS_ELEMENT_TYPE_PROPERTY,
+      .type = TYPE_DATETIME,
+      .value.strVal = "",
+      .setHandler = readOnlySetHandler,
    }
 };
 
@@ -193,11 +402,76 @@ static const DataElement gMethodElements[] = {
       .value.strVal = "",
       .methodHandler = device_telemetry_collect,
       .methodArgs = {
-         .numInputArgs = 2,
+         .numInputArgs = 3,
          .inputArgs = (char* []){"msg_type", "source", "dest"},
          .numOutputArgs = 1,
          .outputArgs = (char* []){"outparams"}
       }
+   },
+   {
+      .name = "Device.X_RbusElements.GetChangesSince()",
+      .elementType = RBUS_ELEMENT_TYPE_METHOD,
+      .type = TYPE_STRING, // Not used for methods
+      .value.strVal = "",
+      .methodHandler = get_changes_since_method,
+      .methodArgs = {
+         .numInputArgs = 2,
+         .inputArgs = (char* []){"Cursor", "Epoch"},
+         .numOutputArgs = 6,
+         .outputArgs = (char* []){"Cursor", "Epoch", "ResyncRequired", "Values", "RowsAdded", "RowsRemoved"}
+      }
+   },
+   {
+      .name = "Device.X_RbusElements.GetHistory()",
+      .elementType = RBUS_ELEMENT_TYPE_METHOD,
+      .type = TYPE_STRING, // Not used for methods
+      .value.strVal = "",
+      .methodHandler = get_history_method,
+      .methodArgs = {
+         .numInputArgs = 4,
+         .inputArgs = (char* []){"Name", "Start", "MaxSamples", "Format"},
+         .numOutputArgs = 8,
+         .outputArgs = (char* []){"Name", "Count", "More", "FirstTime", "FirstValue", "Data", "Times", "Values"}
+      }
+   },
+   {
+      .name = "Device.X_RbusElements.GetValues()",
+      .elementType = RBUS_ELEMENT_TYPE_METHOD,
+      .type = TYPE_STRING, // Not used for methods
+      .value.strVal = "",
+      .methodHandler = get_values_method,
+      .methodArgs = {
+         .numInputArgs = 1,
+         .inputArgs = (char* []){"Paths"},
+         .numOutputArgs = 3,
+         .outputArgs = (char* []){"Count", "Values", "Errors"}
+      }
+   },
+   {
+      .name = "Device.X_RbusElements.AddRows()",
+      .elementType = RBUS_ELEMENT_TYPE_METHOD,
+      .type = TYPE_STRING, // Not used for methods
+      .value.strVal = "",
+      .methodHandler = add_rows_method,
+      .methodArgs = {
+         .numInputArgs = 2,
+         .inputArgs = (char* []){"Table", "Rows"},
+         .numOutputArgs = 2,
+         .outputArgs = (char* []){"Count", "Rows"}
+      }
+   },
+   {
+      .name = "Device.X_RbusElements.GetIfModified()",
+      .elementType = RBUS_ELEMENT_TYPE_METHOD,
+      .type = TYPE_STRING, // Not used for methods
+      .value.strVal = "",
+      .methodHandler = get_if_modified_method,
+      .methodArgs = {
+         .numInputArgs = 2,
+         .inputArgs = (char* []){"Paths", "Since"},
+         .numOutputArgs = 4,
+         .outputArgs = (char* []){"Version", "Count", "Values", "Versions"}
+      }
    }
 };
 
@@ -413,6 +687,38 @@ bool loadDataElementsFromJson(const char* json_path) {
          element_type_str = "property";
       }
 
+      // Alarm, history and IP role rules are not rbus elements, they attach to a property once all elements are known
+      if (strcmp(element_type_str, "telemetrySink") == 0) {
+         if (!telemetry_sink_add_rule(item, i)) {
+            goto load_fail;
+         }
+         continue;
+      }
+      if (strcmp(element_type_str, "persistence") == 0) {
+         if (!persist_add_rule(item, i)) {
+            goto load_fail;
+         }
+         continue;
+      }
+      if (strcmp(element_type_str, "alarm") == 0) {
+         if (!alarm_add_rule(item, i)) {
+            goto load_fail;
+         }
+         continue;
+      }
+      if (strcmp(element_type_str, "history") == 0) {
+         if (!history_add_rule(item, i)) {
+            goto load_fail;
+         }
+         continue;
+      }
+      if (strcmp(element_type_str, "ipRole") == 0) {
+         if (!ip_role_add_rule(item, i)) {
+            goto load_fail;
+         }
+         continue;
+      }
+
       const char* name = cJSON_GetStringValue(name_obj);
       rbusElementType_t element_type;
 
@@ -440,6 +746,12 @@ bool loadDataElementsFromJson(const char* json_path) {
          char* prop = NULL;
          char* tbl = get_table_name(name, &inst, &prop);
          if (tbl) {
+            if (cJSON_GetObjectItem(item, "source") || cJSON_GetObjectItem(item, "plugin")) {
+               fprintf(stderr, "Source and plugin bindings are not supported for row property at item %d\n", i);
+               free(tbl);
+               free(prop);
+               goto load_fail;
+            }
             // Row property
             InitialRowValue iv;
             strcpy(iv.table, tbl);
@@ -575,6 +887,7 @@ bool loadDataElementsFromJson(const char* json_path) {
                }
 
                DataElement* de = &g_internalDataElements[g_numElements];
+               memset(de, 0, sizeof(DataElement));
                strncpy(de->name, prop_wild, MAX_NAME_LEN - 1);
                de->name[MAX_NAME_LEN - 1] = '\0';
                de->elementType = RBUS_ELEMENT_TYPE_PROPERTY;
@@ -604,6 +917,7 @@ bool loadDataElementsFromJson(const char* json_path) {
       }
 
       DataElement* de = &g_internalDataElements[g_numElements];
+      memset(de, 0, sizeof(DataElement));
       strncpy(de->name, name, MAX_NAME_LEN - 1);
       de->name[MAX_NAME_LEN - 1] = '\0';
       de->elementType = element_type;
@@ -702,6 +1016,28 @@ bool loadDataElementsFromJson(const char* json_path) {
                }
                break;
          }
+
+         // Live properties read from a file or command instead of the stored value
+         cJSON* source_obj = cJSON_GetObjectItem(item, "source");
+         if (source_obj) {
+            if (!cJSON_IsObject(source_obj) || !source_add_binding(name, de->type, source_obj, i)) {
+               goto load_fail;
+            }
+            de->getHandler = source_get_handler;
+            de->setHandler = source_set_handler;
+            de->eventSubHandler = source_sub_handler;
+         }
+
+         // Native getter/setter from a loaded plugin, referenced as "<plugin>/<handler>"
+         cJSON* plugin_obj = cJSON_GetObjectItem(item, "plugin");
+         if (plugin_obj) {
+            if (!cJSON_IsString(plugin_obj) || source_obj || !plugin_bind_property(name, de->type, cJSON_GetStringValue(plugin_obj), i)) {
+               fprintf(stderr, "Invalid plugin binding for item %d\n", i);
+               goto load_fail;
+            }
+            de->getHandler = plugin_get_handler;
+            de->setHandler = plugin_set_handler;
+         }
       } else {
          de->type = TYPE_STRING;
          de->value.strVal = strdup("");
@@ -709,11 +1045,36 @@ bool loadDataElementsFromJson(const char* json_path) {
             fprintf(stderr, "Failed to allocate memory for string value at item %d\n", i);
             goto load_fail;
          }
+         // Methods with a handler get a compiled argument schema; without one they are only registered
+         if (element_type == RBUS_ELEMENT_TYPE_METHOD && cJSON_GetObjectItem(item, "handler")) {
+            if (!method_add(item, name, i)) {
+               goto load_fail;
+            }
+            de->methodHandler = declared_method_handler;
+         }
       }
 
       g_numElements++;
    }
 
+   // Companion version reads, added once the elements they describe are in place
+   for (int i = 0; i < json_num; i++) {
+      cJSON* item = cJSON_GetArrayItem(root, i);
+      cJSON* type_str = cJSON_GetObjectItem(item, "elementType");
+      if (!cJSON_IsTrue(cJSON_GetObjectItem(item, "versioned")) ||
+         (cJSON_IsString(type_str) && strcmp(cJSON_GetStringValue(type_str), "property") != 0)) {
+         continue;
+      }
+      char* wild = create_wildcard(cJSON_GetStringValue(cJSON_GetObjectItem(item, "name")));
+      if (!wild || !add_version_element(wild)) {
+         free(wild);
+         goto load_fail;
+      }
+      free(wild);
+   }
+   source_finish_load();
+   plugin_finish_load();
+
    // Add hard coded
    int hard_num = sizeof(gDataElements) / sizeof(DataElement);
    g_totalElements = g_numElements + hard_num;
@@ -726,6 +1087,7 @@ bool loadDataElementsFromJson(const char* json_path) {
 
    for (int j = 0; j < hard_num; j++, g_numElements++) {
       DataElement* de = &g_internalDataElements[g_numElements];
+      memset(de, 0, sizeof(DataElement));
       strncpy(de->name, gDataElements[j].name, MAX_NAME_LEN - 1);
       de->name[MAX_NAME_LEN - 1] = '\0';
       de->elementType = gDataElements[j].elementType;
@@ -778,6 +1140,8 @@ load_fail:
 }
 
 static void cleanup(void) {
+   telemetry_stop();
+   process_monitor_stop();
    free_element_index();
    if (g_rbusHandle && g_dataElements && g_internalDataElements) {
       rbus_unregDataElements(g_rbusHandle, g_totalElements, g_dataElements);
@@ -789,12 +1153,16 @@ static void cleanup(void) {
          if (IS_STRING_TYPE(g_internalDataElements[i].type)) {
             free(g_internalDataElements[i].value.strVal);
          }
+         history_free(g_internalDataElements[i].history);
          free(g_dataElements[i].name);
       }
       free(g_dataElements);
       g_dataElements = NULL;
    }
 
+   // No more sets can arrive, so the last group is complete
+   persist_close();
+
    // Free tables
    for (int i = 0; i < g_num_tables; i++) {
       for (int j = 0; j < g_tables[i].num_rows; j++) {
@@ -804,6 +1172,7 @@ static void cleanup(void) {
             if (IS_STRING_TYPE(p->type)) {
                free(p->value.strVal);
             }
+            history_free(p->history);
             free(p);
             p = next;
          }
@@ -813,11 +1182,22 @@ static void cleanup(void) {
    free(g_tables);
    g_tables = NULL;
    g_num_tables = 0;
+   netlink_monitor_stop();
+   file_watch_cleanup();
+   alarm_cleanup();
+   changelog_cleanup();
+   history_cleanup();
+   method_schema_cleanup();
+   ip_cache_cleanup();
+   source_cleanup();
+   set_session_cleanup();
 
    if (g_rbusHandle) {
       rbus_close(g_rbusHandle);
       g_rbusHandle = NULL;
    }
+   // Last, so no rbus callback can still be running plugin code
+   plugin_cleanup();
 }
 
 void ensure_table(const char* table_wild) {
@@ -849,6 +1229,7 @@ void ensure_table(const char* table_wild) {
    }
    g_internalDataElements = tmp_realloc;
    DataElement* de = &g_internalDataElements[g_numElements];
+   memset(de, 0, sizeof(DataElement));
    strncpy(de->name, table_wild, MAX_NAME_LEN - 1);
    de->name[MAX_NAME_LEN - 1] = '\0';
    de->elementType = RBUS_ELEMENT_TYPE_TABLE;
@@ -885,6 +1266,7 @@ void ensure_table(const char* table_wild) {
       }
       g_internalDataElements = tmp_realloc;
       de = &g_internalDataElements[g_numElements];
+      memset(de, 0, sizeof(DataElement));
       strncpy(de->name, num_name, MAX_NAME_LEN - 1);
       de->name[MAX_NAME_LEN - 1] = '\0';
       de->elementType = RBUS_ELEMENT_TYPE_PROPERTY;
@@ -900,6 +1282,33 @@ void ensure_table(const char* table_wild) {
    }
 }
 
+// "<name>_Version": read-only change-log version of a stored property or, for a {i}
+// name, of each row's property
+static bool add_version_element(const char* target) {
+   char name[MAX_NAME_LEN];
+   snprintf(name, sizeof(name), "%s%s", target, VERSION_SUFFIX);
+   for (int j = 0; j < g_numElements; j++) {
+      if (strcmp(g_internalDataElements[j].name, name) == 0) {
+         return true;
+      }
+   }
+   void* tmp_realloc = realloc(g_internalDataElements, (g_numElements + 1) * sizeof(DataElement));
+   if (!tmp_realloc) {
+      fprintf(stderr, "Failed to allocate memory for data models\n");
+      return false;
+   }
+   g_internalDataElements = tmp_realloc;
+   DataElement* de = &g_internalDataElements[g_numElements];
+   memset(de, 0, sizeof(DataElement));
+   strncpy(de->name, name, MAX_NAME_LEN - 1);
+   de->elementType = RBUS_ELEMENT_TYPE_PROPERTY;
+   de->type = TYPE_ULONG;
+   de->getHandler = get_element_version;
+   de->setHandler = set_element_version;
+   g_numElements++;
+   return true;
+}
+
 static int num_table_max = 0;
 static TableMaxInst* table_max = NULL;
 static void update_max(const char* t_name, uint32_t inst) {
@@ -926,76 +1335,19 @@ static void ensure_inst(const char* c_table, uint32_t c_inst) {
    free(p_table);
 }
 
-int main(int argc, char* argv[]) {
-
-   // Set up signal handlers
-   signal(SIGINT, signal_handler);
-   signal(SIGTERM, signal_handler);
-   signal(SIGHUP, signal_handler);
-   signal(SIGQUIT, signal_handler);
-
-   if (!loadDataElementsFromJson((argc == 2) ? argv[1] : JSON_FILE)) {
-      fprintf(stderr, "Failed to load data elements from %s\n", (argc == 2) ? argv[1] : JSON_FILE);
-      return 1;
-   }
-
-   rbusError_t rc = rbus_open(&g_rbusHandle, "rbus-dataelements");
-   if (rc != RBUS_ERROR_SUCCESS) {
-      fprintf(stderr, "Failed to open rbus: %d\n", rc);
-      cleanup();
-      return 1;
-   }
-
-   g_dataElements = (rbusDataElement_t*)malloc(g_totalElements * sizeof(rbusDataElement_t));
-   if (!g_dataElements) {
-      fprintf(stderr, "Failed to allocate memory for data elements\n");
-      cleanup();
-      return 1;
-   }
-
-   for (int i = 0; i < g_totalElements; i++) {
-      g_dataElements[i].name = strdup(g_internalDataElements[i].name);
-      if (!g_dataElements[i].name) {
-         fprintf(stderr, "Failed to allocate memory for data element name\n");
-         cleanup();
-         return 1;
-      }
-      g_dataElements[i].type = g_internalDataElements[i].elementType;
-      g_dataElements[i].cbTable.getHandler = g_internalDataElements[i].getHandler ? g_internalDataElements[i].getHandler : (g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_PROPERTY ? getHandler : NULL);
-      g_dataElements[i].cbTable.setHandler = g_internalDataElements[i].setHandler ? g_internalDataElements[i].setHandler : (g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_PROPERTY ? setHandler : NULL);
-      g_dataElements[i].cbTable.tableAddRowHandler = g_internalDataElements[i].tableAddRowHandler;
-      g_dataElements[i].cbTable.tableRemoveRowHandler = g_internalDataElements[i].tableRemoveRowHandler;
-      g_dataElements[i].cbTable.eventSubHandler = g_internalDataElements[i].eventSubHandler ? g_internalDataElements[i].eventSubHandler : (g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_EVENT || g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_PROPERTY ? eventSubHandler : NULL);
-   /* assign method handler after struct init; silence pedantic function pointer warning */
-#ifdef __GNUC__
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wpedantic"
-#endif
-   g_dataElements[i].cbTable.methodHandler = g_internalDataElements[i].methodHandler;
-#ifdef __GNUC__
-#pragma GCC diagnostic pop
-#endif
-   }
-
-   rc = rbus_regDataElements(g_rbusHandle, g_totalElements, g_dataElements);
-   if (rc != RBUS_ERROR_SUCCESS) {
-      fprintf(stderr, "Failed to register data elements: %d\n", rc);
-      cleanup();
-      return 1;
-   }
-
-   printf("Successfully registered %d data elements\n", g_totalElements);
-
-   build_element_index();
-
-   for (size_t i = 0; i < sizeof(gMethodElements) / sizeof(DataElement); i++) {
-      const DataElement* method = &gMethodElements[i];
-      registerMethod(g_rbusHandle, method);
-   }
-
-   printf("Successfully registered %zu methods\n", sizeof(gMethodElements) / sizeof(DataElement));
+// Seeded values go straight to the element's setter; the main thread holds the model
+// lock, so an rbus_set on our own handle would wait for it on the rbus thread
+static rbusError_t seed_set(rbusSetHandler_t setter, const char* name, rbusValue_t value) {
+   rbusProperty_t prop = rbusProperty_Init(NULL, name, value);
+   rbusSetHandlerOptions_t opts = {.commit = true};
+   rbusError_t rc = setter(g_rbusHandle, prop, &opts);
+   rbusProperty_Release(prop);
+   return rc;
+}
 
-   // Populate initial rows and values
+// Populate initial rows and values from elements.json, then the persisted changes
+static void seed_model(void) {
+   rbusError_t rc;
 
    // First, collect unique concrete tables and max_inst recursively
    for (int j = 0; j < g_num_initial; j++) {
@@ -1028,20 +1380,17 @@ int main(int argc, char* argv[]) {
          table->num_inst = 0;
       }
 
-   for (uint32_t m = table->next_inst; m <= (uint32_t)max; m++) {
-         table->rows = realloc(table->rows, (table->num_rows + 1) * sizeof(TableRow));
-         TableRow* row = &table->rows[table->num_rows];
-         snprintf(row->name, MAX_NAME_LEN, "%s", tbl);
-         row->instNum = m;
-         row->alias[0] = '\0';
-         row->props = NULL;
-         table->num_rows++;
-         table->num_inst++; /* ensure getTableHandler returns correct NumberOfEntries */
-
-         //rc = rbusTable_registerRow(g_rbusHandle, row->name, row->instNum, NULL);
-         rc = rbusTable_addRow(g_rbusHandle, row->name, row->alias, &row->instNum);
+      for (uint32_t m = table->next_inst; m <= (uint32_t)max; m++) {
+         // Added the way table_add_row does it and registered directly: rbusTable_addRow on
+         // our own handle would call back on the rbus thread and wait for the model lock
+         uint32_t inst;
+         table->next_inst = m;
+         rc = table_add_row(g_rbusHandle, tbl, NULL, &inst);
+         if (rc == RBUS_ERROR_SUCCESS) {
+            rc = rbusTable_registerRow(g_rbusHandle, tbl, inst, NULL);
+         }
          if (rc != RBUS_ERROR_SUCCESS) {
-            fprintf(stderr, "Failed to register initial row %s: %d\n", row->name, rc);
+            fprintf(stderr, "Failed to register initial row %s%u.: %d\n", tbl, m, rc);
          }
       }
       table->next_inst = max + 1;
@@ -1088,23 +1437,15 @@ int main(int argc, char* argv[]) {
             break;
       }
 
-      rbusSetOptions_t opts = {.commit = true};
-      rc = rbus_set(g_rbusHandle, concrete, val, &opts);
+      rc = seed_set(setHandler, concrete, val);
       if (rc != RBUS_ERROR_SUCCESS) {
          fprintf(stderr, "Failed to set initial value for %s: %d\n", concrete, rc);
       }
       rbusValue_Release(val);
    }
 
-   // Free initial
-   for (int j = 0; j < g_num_initial; j++) {
-      if (IS_STRING_TYPE(g_initial_values[j].type)) {
-         free(g_initial_values[j].value.strVal);
-      }
-   }
-   free(g_initial_values);
-   g_initial_values = NULL;
-   g_num_initial = 0;
+   // Runtime changes from the previous run win over the initial values from elements.json
+   persist_replay(g_rbusHandle);
 
    // Set non-table properties
    for (int i = 0; i < g_totalElements; i++) {
@@ -1112,6 +1453,9 @@ int main(int argc, char* argv[]) {
          if (strstr(g_internalDataElements[i].name, "{i}") != NULL) {
             continue; // Skip wildcard properties
          }
+         if (g_internalDataElements[i].setHandler && g_internalDataElements[i].setHandler != setHandler) {
+            continue; // Sourced, plugin and built-in setters own their value; seeding them only fails
+         }
          rbusValue_t value;
          rbusValue_Init(&value);
          switch (g_internalDataElements[i].type) {
@@ -1146,23 +1490,143 @@ int main(int argc, char* argv[]) {
                break;
          }
 
-         rbusSetOptions_t opts = {.commit = true};
          //fprintf(stdout, "Setting initial value for %s\n", g_internalDataElements[i].name);
-         rc = rbus_set(g_rbusHandle, g_internalDataElements[i].name, value, &opts);
+         rc = seed_set(setHandler, g_internalDataElements[i].name, value);
          if (rc != RBUS_ERROR_SUCCESS) {
             fprintf(stderr, "Failed to set %s: %d\n", g_internalDataElements[i].name, rc);
          }
          rbusValue_Release(value);
       }
    }
+}
 
-   system("touch /tmp/pam_initialized");
+int main(int argc, char* argv[]) {
 
-   while (g_running) {
-      sleep(1);
+   // Set up signal handlers
+   signal(SIGINT, signal_handler);
+   signal(SIGTERM, signal_handler);
+   signal(SIGHUP, signal_handler);
+   signal(SIGQUIT, signal_handler);
+   signal(SIGUSR2, handoff_handler);
+
+   // Resolved now: once a package upgrade replaces the binary, /proc/self/exe names the old one
+   ssize_t self_len = readlink("/proc/self/exe", g_self_path, sizeof(g_self_path) - 1);
+   g_self_path[self_len > 0 ? self_len : 0] = '\0';
+
+   // Plugins first, so elements.json can bind to their handlers
+   const char* plugin_dir = getenv("RBUS_ELEMENTS_PLUGIN_DIR");
+   plugin_load_dir(plugin_dir ? plugin_dir : PLUGIN_DIR);
+
+   if (!loadDataElementsFromJson((argc == 2) ? argv[1] : JSON_FILE)) {
+      fprintf(stderr, "Failed to load data elements from %s\n", (argc == 2) ? argv[1] : JSON_FILE);
+      return 1;
    }
 
+   rbusError_t rc = rbus_open(&g_rbusHandle, "rbus-dataelements");
+   if (rc != RBUS_ERROR_SUCCESS) {
+      fprintf(stderr, "Failed to open rbus: %d\n", rc);
+      cleanup();
+      return 1;
+   }
+
+   g_dataElements = (rbusDataElement_t*)malloc(g_totalElements * sizeof(rbusDataElement_t));
+   if (!g_dataElements) {
+      fprintf(stderr, "Failed to allocate memory for data elements\n");
+      cleanup();
+      return 1;
+   }
+
+   for (int i = 0; i < g_totalElements; i++) {
+      g_dataElements[i].name = strdup(g_internalDataElements[i].name);
+      if (!g_dataElements[i].name) {
+         fprintf(stderr, "Failed to allocate memory for data element name\n");
+         cleanup();
+         return 1;
+      }
+      g_dataElements[i].type = g_internalDataElements[i].elementType;
+      g_dataElements[i].cbTable.getHandler = g_internalDataElements[i].getHandler ? g_internalDataElements[i].getHandler : (g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_PROPERTY ? getHandler : NULL);
+      g_dataElements[i].cbTable.setHandler = g_internalDataElements[i].setHandler ? g_internalDataElements[i].setHandler : (g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_PROPERTY ? setHandler : NULL);
+      g_dataElements[i].cbTable.tableAddRowHandler = g_internalDataElements[i].tableAddRowHandler;
+      g_dataElements[i].cbTable.tableRemoveRowHandler = g_internalDataElements[i].tableRemoveRowHandler;
+      g_dataElements[i].cbTable.eventSubHandler = g_internalDataElements[i].eventSubHandler ? g_internalDataElements[i].eventSubHandler : (g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_EVENT || g_internalDataElements[i].elementType == RBUS_ELEMENT_TYPE_PROPERTY ? eventSubHandler : NULL);
+   /* assign method handler after struct init; silence pedantic function pointer warning */
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
+   g_dataElements[i].cbTable.methodHandler = g_internalDataElements[i].methodHandler;
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+   }
+
+   rc = rbus_regDataElements(g_rbusHandle, g_totalElements, g_dataElements);
+   if (rc != RBUS_ERROR_SUCCESS) {
+      fprintf(stderr, "Failed to register data elements: %d\n", rc);
+      cleanup();
+      return 1;
+   }
+
+   printf("Successfully registered %d data elements\n", g_totalElements);
+
+   // Handlers can be called from here on; they wait until the model is complete
+   model_lock();
+   build_element_index();
+   alarm_bind_rules();
+   history_bind_rules();
+
+   for (size_t i = 0; i < sizeof(gMethodElements) / sizeof(DataElement); i++) {
+      const DataElement* method = &gMethodElements[i];
+      registerMethod(g_rbusHandle, method);
+   }
+
+   printf("Successfully registered %zu methods\n", sizeof(gMethodElements) / sizeof(DataElement));
+
+   // An upgraded daemon takes over the live model of the one it replaced
+   if (!persist_handoff_load(g_rbusHandle)) {
+      seed_model();
+   }
+
+   // Free initial
+   for (int j = 0; j < g_num_initial; j++) {
+      if (IS_STRING_TYPE(g_initial_values[j].type)) {
+         free(g_initial_values[j].value.strVal);
+      }
+   }
+   free(g_initial_values);
+   g_initial_values = NULL;
+   g_num_initial = 0;
+
+   status_monitor_init();
+   device_info_init();
+   ip_cache_init();
+   process_monitor_init();
+   source_watch_init();
+   model_unlock();
+   telemetry_start();
+   plugin_start();
+   persist_start();
+   if (!netlink_monitor_start(-1)) {
+      fprintf(stderr, "Interface notifications unavailable, reading interface data on every get\n");
+   }
+
+   system("touch /tmp/pam_initialized");
+
+   event_loop_run(&g_running);
+
+   model_lock();
+   int handoff_fd = g_handoff && g_self_path[0] ? persist_handoff_save() : -1;
+   model_unlock();
    fprintf(stdout, "Shutting down...\n");
    cleanup();
+   if (handoff_fd >= 0) {
+      // Same pid, so the service manager keeps tracking the daemon
+      char fd_str[16];
+      snprintf(fd_str, sizeof(fd_str), "%d", handoff_fd);
+      setenv(PERSIST_HANDOFF_ENV, fd_str, 1);
+      execv(g_self_path, argv);
+      fprintf(stderr, "Failed to exec %s: %s\n", g_self_path, strerror(errno));
+      return 1;
+   }
    return 0;
 }
@@ -8,6 +8,7 @@
 #include <signal.h>
 #include <time.h>
 #include <stdint.h>
+#include "rbus_elements_plugin.h"
 
 #ifdef __APPLE__
 #include <sys/sysctl.h>
@@ -21,13 +22,73 @@
 #include <unistd.h>
 #include <netinet/in.h>
 #include <errno.h>
+#include <fcntl.h>
 #endif
 
 #define MAX_NAME_LEN 512
 #define JSON_FILE "elements.json"
 #define MEMORY_CACHE_TIMEOUT 5
+#define DEVICE_INFO_SNAPSHOT_MS 100 // max age of the DeviceInfo snapshot behind the getters
+#define DEVICE_INFO_IP_ROLES 3       // STB_IP, WAN_IP, CM_IP
+#define DEVICE_INFO_IP_LEN 46        // INET6_ADDRSTRLEN
 #define MAX_REGISTERED_EVENTS 10
 #define TABLE_COUNT_PROP "NumberOfEntries"
+#define MAX_EVENT_LOOP_TIMERS 16
+#define MAX_EVENT_LOOP_FDS 8
+#define EVENT_LOOP_MAX_WAIT_MS 1000
+#define MAX_NETLINK_LISTENERS 8
+#define MAX_FILE_WATCHES 32
+#define PROCESS_TABLE "Device.DeviceInfo.ProcessStatus.Process."
+#define PROCESS_SAMPLE_INTERVAL 5
+#define PROCESS_MAX_ENTRIES 512
+#define PROCESS_COMMAND_LEN 64
+#define SOURCE_DEFAULT_TTL_MS 1000
+#define SOURCE_MAX_BYTES 65536
+#define SOURCE_MAX_TOKEN 256
+#define TELEMETRY_RING_SLOTS 128      // preallocated Telemetry.Collect() events
+#define TELEMETRY_EVENT_BYTES 4096    // string storage per event, payload included
+#define TELEMETRY_EVENT_MAX_BYTES (256 * 1024) // larger events spill to the heap up to this
+#define TELEMETRY_PRIORITY_SLOTS 32   // separate ring for qos >= TELEMETRY_QOS_HIGH
+#define TELEMETRY_QOS_MEDIUM 25       // Xmidt qos bands: 0-24 low, 25-49 medium, 50-74 high, 75-99 critical
+#define TELEMETRY_QOS_HIGH 50
+#define TELEMETRY_QOS_CRITICAL 75
+#define TELEMETRY_CRITICAL_WAIT_MS 100 // how long a critical event may wait for queue space
+#define TELEMETRY_BATCH_BYTES 16384   // default sink batch limits
+#define TELEMETRY_BATCH_MS 100
+#define TELEMETRY_BATCH_EVENT "Device.Telemetry.EventBatch!"
+#define TELEMETRY_SPOOL_SEGMENT_BYTES (1024 * 1024)
+#define TELEMETRY_SPOOL_SEGMENTS 16   // spool capacity, in segments
+#define TELEMETRY_SPOOL_SYNC_MS 1000  // default interval between msync batches
+#define JSON_SCAN_MAX_DEPTH 64
+#define SYSTEM_STATUS_EVENT "Device.SystemStatusChanged!"
+#define STATUS_MONITOR_INTERVAL 10   // seconds between health samples
+#define STATUS_CONFIRM_SAMPLES 2     // consecutive samples a transition must hold
+#define STATUS_LOW_MEM_ENTER_PCT 10  // free memory % thresholds, enter < exit for hysteresis
+#define STATUS_LOW_MEM_EXIT_PCT 15
+#define STATUS_CRIT_MEM_ENTER_PCT 5
+#define STATUS_CRIT_MEM_EXIT_PCT 8
+#define ALARM_TABLE "Device.X_RbusElements.Alarm."
+#define ALARM_EVENT "Device.X_RbusElements.AlarmChanged!"
+#define ALARM_DEFAULT_WINDOW 60
+#define CHANGE_LOG_SIZE 4096
+#define VERSION_SUFFIX "_Version" // companion read of a "versioned" property's version
+#define SET_COMMIT_EVENT "Device.X_RbusElements.SetCommitted!"
+#define MAX_SET_SESSIONS 8
+#define SET_SESSION_TIMEOUT 30       // seconds an uncommitted session is kept
+#define HISTORY_DEFAULT_SAMPLES 128
+#define HISTORY_BYTES_PER_SAMPLE 4   // ring bytes reserved per sample for varint deltas
+#define METHOD_MAX_ARGS 32           // inputs or outputs of a JSON-declared method
+#define METHOD_ARG_SLOTS 64          // compiled argument hash size, power of two > METHOD_MAX_ARGS
+#define METHOD_ARG_OBJECT (TYPE_BYTE + 1) // schema type for rbus object arguments
+#define PLUGIN_DIR "/usr/lib/rbus-elements/plugins" // overridden by RBUS_ELEMENTS_PLUGIN_DIR
+#define MAX_PLUGINS 16
+#define PLUGIN_STRING_BYTES 256      // inline string room per plugin output before spilling to the heap
+#define PERSIST_SYNC_MS 1000         // default group commit interval of the value log
+#define PERSIST_SYNC_RECORDS 64      // default records per group before an immediate commit
+#define PERSIST_SNAPSHOT_SEC 3600    // default interval between snapshots of a non-empty log
+#define PERSIST_SNAPSHOT_BYTES (1024 * 1024) // default log size that triggers a snapshot
+#define PERSIST_SNAPSHOT_FRAME 65536 // snapshot records are written in frames of about this size
+#define PERSIST_HANDOFF_ENV "RBUS_ELEMENTS_HANDOFF_FD" // memfd of the model handed over on upgrade
 
 typedef enum {
    TYPE_STRING = 0,
@@ -50,21 +111,33 @@ typedef struct {
    char **outputArgs;
 } MethodArgs;
 
+typedef union {
+   char *strVal;          // TYPE_STRING, TYPE_DATETIME, TYPE_BASE64
+   int32_t intVal;        // TYPE_INT
+   uint32_t uintVal;      // TYPE_UINT
+   bool boolVal;          // TYPE_BOOL
+   int64_t longVal;       // TYPE_LONG
+   uint64_t ulongVal;     // TYPE_ULONG
+   float floatVal;        // TYPE_FLOAT
+   double doubleVal;      // TYPE_DOUBLE
+   uint8_t byteVal;       // TYPE_BYTE
+} ElementValue;
+
+/* Alarm rules attached to a property: a contiguous run in g_alarm_rules and,
+ * for concrete properties, the matching run of per-instance state. */
+typedef struct {
+   int rule;    // first rule index
+   int count;   // number of rules, 0 when unbound
+   int state;   // first state index (concrete properties only)
+} AlarmBinding;
+
+typedef struct HistorySeries HistorySeries;
+
 typedef struct {
    char name[MAX_NAME_LEN];
    rbusElementType_t elementType; // RBUS_ELEMENT_TYPE_PROPERTY, TABLE, EVENT, or METHOD
    ValueType type; // Used for properties only
-   union {
-      char *strVal;          // TYPE_STRING, TYPE_DATETIME, TYPE_BASE64
-      int32_t intVal;        // TYPE_INT
-      uint32_t uintVal;      // TYPE_UINT
-      bool boolVal;          // TYPE_BOOL
-      int64_t longVal;       // TYPE_LONG
-      uint64_t ulongVal;     // TYPE_ULONG
-      float floatVal;        // TYPE_FLOAT
-      double doubleVal;      // TYPE_DOUBLE
-      uint8_t byteVal;       // TYPE_BYTE
-   } value;
+   ElementValue value;
    rbusGetHandler_t getHandler;
    rbusSetHandler_t setHandler;
    rbusTableAddRowHandler_t tableAddRowHandler;
@@ -72,22 +145,20 @@ typedef struct {
    rbusEventSubHandler_t eventSubHandler;
    rbusMethodHandler_t methodHandler;
    MethodArgs methodArgs;
+   AlarmBinding alarms;
+   uint64_t version; // change log version of the last set, 0 if never set
+   HistorySeries *history; // opt-in sample ring, template only for {i} elements
+   bool persisted; // value is in the value log
 } DataElement;
 
 typedef struct RowProperty {
    char name[MAX_NAME_LEN];
    ValueType type;
-   union {
-      char *strVal;
-      int32_t intVal;
-      uint32_t uintVal;
-      bool boolVal;
-      int64_t longVal;
-      uint64_t ulongVal;
-      float floatVal;
-      double doubleVal;
-      uint8_t byteVal;
-   } value;
+   ElementValue value;
+   AlarmBinding alarms;
+   uint64_t version;
+   HistorySeries *history;
+   bool persisted;
    struct RowProperty *next;
 } RowProperty;
 
@@ -96,6 +167,7 @@ typedef struct {
    uint32_t instNum;
    char alias[MAX_NAME_LEN];
    RowProperty *props;
+   uint64_t version; // bumped when the row is added or any of its properties change
 } TableRow;
 
 typedef struct {
@@ -111,19 +183,29 @@ typedef struct {
    int inst;
    char prop[MAX_NAME_LEN];
    ValueType type;
-   union {
-      char *strVal;
-      int32_t intVal;
-      uint32_t uintVal;
-      bool boolVal;
-      int64_t longVal;
-      uint64_t ulongVal;
-      float floatVal;
-      double doubleVal;
-      uint8_t byteVal;
-   } value;
+   ElementValue value;
 } InitialRowValue;
 
+#define DEVICE_INFO_HAS_SERIAL (1u << 0)
+#define DEVICE_INFO_HAS_TIME (1u << 1)
+#define DEVICE_INFO_HAS_UPTIME (1u << 2)
+#define DEVICE_INFO_HAS_MEMORY (1u << 3)
+#define DEVICE_INFO_HAS_IP(role) (1u << (4 + (role)))
+
+// One consistent set of DeviceInfo values, gathered in a single refresh
+typedef struct {
+   uint64_t taken_ms;  // CLOCK_MONOTONIC ms of the refresh
+   int64_t time_sec;   // CLOCK_REALTIME at the refresh
+   int32_t time_usec;
+   uint32_t uptime;    // seconds
+   uint64_t mem_total; // kB
+   uint64_t mem_free;
+   uint64_t mem_used;
+   uint32_t valid;     // DEVICE_INFO_HAS_* for the fields that could be read
+   char serial[64];
+   char ip[DEVICE_INFO_IP_ROLES][DEVICE_INFO_IP_LEN];
+} DeviceInfoSnapshot;
+
 // Built-in DeviceInfo data models
 rbusError_t get_system_serial_number(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t get_system_time(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
@@ -132,25 +214,292 @@ rbusError_t get_mac_address(rbusHandle_t handle, rbusProperty_t property, rbusGe
 rbusError_t get_memory_free(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t get_memory_used(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t get_memory_total(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+rbusError_t get_memory_refresh_interval(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+rbusError_t set_memory_refresh_interval(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t *options);
 rbusError_t get_local_time(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t get_manufacturer_oui(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t get_first_ip(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options);
+bool device_memory_status(uint64_t *total, uint64_t *free, uint64_t *used);
+bool device_uptime(uint32_t *uptime_seconds);
+uint32_t device_interfaces_up(uint32_t *names_hash);
+bool device_primary_mac(unsigned char mac[6]);
+void device_info_snapshot(DeviceInfoSnapshot *out);
+size_t device_info_system_time(const DeviceInfoSnapshot *snap, char *out, size_t outlen);
+void device_info_init(void);
+
+// ip_cache.c
+bool ip_role_add_rule(cJSON *item, int index);
+void ip_cache_init(void);
+bool ip_cache_get(const char *name, char *out, size_t outlen);
+rbusError_t ip_cache_sub_handler(rbusHandle_t handle, rbusEventSubAction_t action, const char *eventName, rbusFilter_t filter, int32_t interval, bool *autoPublish);
+void ip_cache_cleanup(void);
+
+// process_monitor.c
+rbusError_t get_cpu_usage(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+void process_monitor_init(void);
+void process_monitor_stop(void);
+
+// telemetry.c
+typedef enum {
+   TELEMETRY_SOURCE = 0,
+   TELEMETRY_DEST,
+   TELEMETRY_CONTENT_TYPE,
+   TELEMETRY_PARTNER_IDS,
+   TELEMETRY_HEADERS,
+   TELEMETRY_METADATA,
+   TELEMETRY_SESSION_ID,
+   TELEMETRY_TRANSACTION_UUID,
+   TELEMETRY_PAYLOAD,
+   TELEMETRY_FIELD_COUNT
+} TelemetryField;
+#define TELEMETRY_FIELD_ABSENT UINT32_MAX
+/* One queued Telemetry.Collect() event; strings are packed into data and located by
+ * off[] (TELEMETRY_FIELD_ABSENT when not supplied). data is the slot's own storage,
+ * or a heap spill once the strings outgrow it. */
+typedef struct {
+   uint32_t pos;
+   uint8_t lane;
+   bool valid;
+   bool simple_event;
+   bool has_qos;
+   bool has_rdr;
+   bool payload_json;   // payload passed validation and may be forwarded as raw JSON
+   int32_t qos;
+   int32_t rdr;
+   uint64_t received_ms;
+   uint32_t off[TELEMETRY_FIELD_COUNT];
+   uint32_t len;
+   uint32_t cap;
+   char *data;
+   char slot_data[TELEMETRY_EVENT_BYTES];
+} TelemetryEvent;
+TelemetryEvent *telemetry_claim(int32_t qos);
+bool telemetry_reserve(TelemetryEvent *ev, size_t need);
+void telemetry_release_spill(TelemetryEvent *ev);
+void telemetry_commit(TelemetryEvent *ev);
+bool telemetry_put(TelemetryEvent *ev, TelemetryField field, const char *s);
+bool telemetry_put_object(TelemetryEvent *ev, TelemetryField field, rbusObject_t obj, bool keys);
+bool telemetry_start(void);
+void telemetry_stop(void);
+rbusError_t get_telemetry_stat(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+
+// telemetry_sink.c
+typedef enum {
+   TELEMETRY_VALIDATE_NONE = 0,
+   TELEMETRY_VALIDATE_SCAN,   // structural scan, no allocation
+   TELEMETRY_VALIDATE_FULL    // full jansson decode
+} TelemetryValidate;
+typedef struct TelemetrySink TelemetrySink;
+typedef struct {
+   const char *kind;
+   bool (*open)(TelemetrySink *sink);
+   bool (*append)(TelemetrySink *sink, const TelemetryEvent *ev); // encode into the pending batch
+   bool (*flush)(TelemetrySink *sink);                            // deliver the pending batch
+   void (*close)(TelemetrySink *sink);
+} TelemetrySinkOps;
+struct TelemetrySink {
+   const TelemetrySinkOps *ops;
+   char path[MAX_NAME_LEN];
+   char spool[MAX_NAME_LEN]; // spool directory, empty when events go straight to the sink
+   size_t batch_bytes;
+   uint32_t batch_ms;
+   uint32_t sync_ms;
+   TelemetryValidate validate;
+   bool verbose;        // log sink decodes and pretty-prints payloads
+   int fd;
+   uint64_t retry_ms;
+   char *buf;           // encoded batch
+   size_t len;
+   size_t cap;
+   uint32_t count;      // events in the batch
+   rbusObject_t batch;
+};
+bool telemetry_sink_add_rule(cJSON *item, int index);
+bool telemetry_payload_check(const char *payload, size_t len, bool *is_json);
+TelemetrySink *telemetry_sink_open(void);
+bool telemetry_sink_append(TelemetrySink *sink, const TelemetryEvent *ev);
+bool telemetry_sink_flush(TelemetrySink *sink);
+void telemetry_sink_close(TelemetrySink *sink);
+
+// json_scan.c
+bool json_scan(const char *json, size_t len);
+
+// telemetry_spool.c
+bool telemetry_spool_open(const char *dir, uint32_t sync_ms);
+bool telemetry_spool_append(const TelemetryEvent *ev);
+const TelemetryEvent *telemetry_spool_peek(void); // next record not yet handed to the sink
+void telemetry_spool_next(void);                  // the peeked record is in the sink's batch
+void telemetry_spool_ack(void);                   // everything handed out was delivered
+void telemetry_spool_rewind(void);                // delivery failed, hand it out again
+void telemetry_spool_sync(bool force);
+uint32_t telemetry_spool_pending(void);
+void telemetry_spool_close(void);
+
+// sources.c
+bool source_add_binding(const char *name, ValueType type, cJSON *source, int index);
+void source_finish_load(void);
+rbusError_t source_get_handler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+rbusError_t source_set_handler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t *options);
+rbusError_t source_sub_handler(rbusHandle_t handle, rbusEventSubAction_t action, const char *eventName, rbusFilter_t filter, int32_t interval, bool *autoPublish);
+void source_watch_init(void);
+void source_cleanup(void);
+
+// file_watch.c
+typedef void (*FileWatchCb)(void *ctx);
+int file_watch_add(const char *path, FileWatchCb cb, void *ctx);
+void file_watch_cleanup(void);
+
+// netlink_monitor.c
+struct nlmsghdr;
+typedef void (*NetlinkCb)(const struct nlmsghdr *nh, void *ctx); // nh is NULL when notifications were lost
+int netlink_add_listener(uint32_t groups, NetlinkCb cb, void *ctx);
+bool netlink_monitor_start(int fd);
+bool netlink_monitor_active(void);
+void netlink_monitor_stop(void);
 
 // Methods
 rbusError_t system_reboot_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
 rbusError_t get_system_info_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
 rbusError_t device_telemetry_collect(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
+rbusError_t get_values_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
+rbusError_t add_rows_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
+rbusError_t get_if_modified_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
 void registerMethod(rbusHandle_t handle, const DataElement *method);
 
+// JSON-declared methods (method_schema.c)
+typedef struct {
+   char *name;
+   int type;       // ValueType or METHOD_ARG_OBJECT
+   bool required;
+   char *target;   // property written by the setMany handler
+} MethodArg;
+typedef struct DeclaredMethod DeclaredMethod;
+// args[i] is the validated value of input i in schema order, NULL when omitted
+typedef rbusError_t (*DeclaredMethodFn)(const DeclaredMethod *method, rbusValue_t const *args, rbusObject_t outParams);
+bool method_add(cJSON *item, const char *name, int index);
+rbusError_t declared_method_handler(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
+void method_schema_cleanup(void);
+
+// plugins.c
+int plugin_load_dir(const char *dir);
+const RbeHandler *plugin_find_handler(const char *ref);
+bool plugin_bind_property(const char *name, ValueType type, const char *ref, int index);
+void plugin_finish_load(void);
+rbusError_t plugin_get_handler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+rbusError_t plugin_set_handler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t *options);
+rbusError_t plugin_call_method(const RbeHandler *h, const char *method, rbusValue_t const *args, int num_args, const MethodArg *outs, int num_outs, rbusObject_t outParams);
+void plugin_start(void);
+void plugin_cleanup(void);
+
+// persist.c
+bool persist_add_rule(cJSON *item, int index);
+void persist_replay(rbusHandle_t handle);
+void persist_start(void);
+bool persist_log_set(const char *name, ValueType type, const ElementValue *v);
+void persist_log_row_add(const char *table, uint32_t inst, const char *alias);
+void persist_log_row_remove(const char *table, uint32_t inst);
+void persist_flush(void);
+void persist_close(void);
+int persist_handoff_save(void);
+bool persist_handoff_load(rbusHandle_t handle);
+
 // Handlers
+void model_lock(void);
+void model_unlock(void);
 char *get_table_name(const char *name, uint32_t *instance, char **property_name);
+TableDef *find_table(const char *name);
+TableDef *create_table(const char *name);
+TableRow *find_row(TableDef *table, uint32_t instNum);
+bool table_is_writable(const char *tableName);
+RowProperty *row_property(TableRow *row, const char *prop, ValueType type);
+void value_to_rbus(rbusValue_t value, ValueType type, const ElementValue *v);
+
+/* One concrete property visited by model_walk(); value is NULL for live
+ * properties, whose current value comes from getter. live is also set for rows of
+ * provider-owned tables, which are not versioned. */
+typedef struct {
+   const char *name;
+   ValueType type;
+   bool live;
+   const ElementValue *value;
+   rbusGetHandler_t getter;
+   uint64_t version;
+} ModelEntry;
+typedef void (*ModelVisitor)(const ModelEntry *entry, void *ctx);
+void model_walk(const char *path, ModelVisitor visit, void *ctx);
+void model_walk_paths(const char *const *paths, int count, bool *found, ModelVisitor visit, void *ctx);
+rbusError_t model_entry_value(const ModelEntry *entry, rbusValue_t *out);
 rbusError_t getTableHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t table_add_row(rbusHandle_t handle, const char *tableName, const char *aliasName, uint32_t *instNum);
 rbusError_t table_remove_row(rbusHandle_t handle, const char *rowName);
+rbusError_t table_add_rows(rbusHandle_t handle, const char *tableName, rbusObject_t rows, rbusObject_t created, char *err, size_t errlen);
 void valueChangeHandler(rbusHandle_t handle, rbusEvent_t const *event, rbusEventSubscription_t *subscription);
 rbusError_t eventSubHandler(rbusHandle_t handle, rbusEventSubAction_t action, const char *eventName, rbusFilter_t filter, int32_t interval, bool *autoPublish);
 rbusError_t getHandler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
 rbusError_t setHandler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t *options);
+rbusError_t readOnlySetHandler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t *options);
+
+/* Where a set lands: a plain element, or a row property (prop is NULL until the
+ * first set creates it from the wildcard definition). */
+typedef struct {
+   DataElement *de;
+   TableRow *row;
+   RowProperty *prop;
+   ValueType type;
+} SetTarget;
+bool value_type_matches(ValueType type, rbusValue_t value);
+rbusError_t value_from_rbus(ValueType type, rbusValue_t value, ElementValue *out);
+rbusError_t set_resolve(const char *name, rbusValue_t value, bool create, SetTarget *target);
+void set_apply(const char *name, const SetTarget *target, const ElementValue *v, rbusValue_t value);
+
+// Set sessions
+bool set_session_pending(const rbusSetHandlerOptions_t *options);
+rbusError_t set_session_stage(rbusHandle_t handle, const rbusSetHandlerOptions_t *options, const char *name, rbusValue_t value);
+rbusError_t set_session_end(rbusHandle_t handle, const rbusSetHandlerOptions_t *options, rbusError_t rc);
+void set_session_cleanup(void);
+
+// Event loop
+typedef void (*EventLoopTimerCb)(void *ctx);
+int event_loop_add_timer(unsigned int interval_ms, EventLoopTimerCb cb, void *ctx);
+typedef void (*EventLoopFdCb)(int fd, void *ctx);
+int event_loop_add_fd(int fd, EventLoopFdCb cb, void *ctx);
+void event_loop_remove_fd(int fd);
+void event_loop_run(volatile sig_atomic_t *running);
+
+// System status monitor
+void status_monitor_init(void);
+rbusError_t status_monitor_sub_handler(rbusHandle_t handle, rbusEventSubAction_t action, const char *eventName, rbusFilter_t filter, int32_t interval, bool *autoPublish);
+
+// Change log
+typedef enum {
+   CHANGE_VALUE = 0,
+   CHANGE_ROW_ADDED = 1,
+   CHANGE_ROW_REMOVED = 2
+} ChangeKind;
+uint64_t changelog_record(const char *name, ChangeKind kind);
+uint64_t changelog_version(void);
+rbusError_t get_model_version(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+rbusError_t get_element_version(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t *options);
+rbusError_t set_element_version(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t *options);
+rbusError_t get_changes_since_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
+void changelog_cleanup(void);
+
+// Alarms
+bool alarm_add_rule(cJSON *item, int index);
+void alarm_bind_rules(void);
+void alarm_bind(AlarmBinding *binding, const AlarmBinding *rules);
+void alarm_unbind(AlarmBinding *binding, const char *name);
+void alarm_evaluate(const char *name, const AlarmBinding *binding, rbusValue_t value);
+void alarm_cleanup(void);
+
+// History
+bool history_add_rule(cJSON *item, int index);
+void history_bind_rules(void);
+void history_bind(HistorySeries **series, const HistorySeries *tmpl);
+void history_record(HistorySeries *series, rbusValue_t value);
+void history_free(HistorySeries *series);
+rbusError_t get_history_method(rbusHandle_t handle, const char *methodName, rbusObject_t inParams, rbusObject_t outParams, rbusMethodAsyncHandle_t asyncHandle);
+void history_cleanup(void);
 
 #define IS_STRING_TYPE(type) (type == TYPE_STRING || type == TYPE_DATETIME || type == TYPE_BASE64)
 
@@ -0,0 +1,100 @@
+/* Plugin ABI for rbus-elements.
+ *
+ * A plugin is a shared object in the plugin directory that exports RBE_PLUGIN_ENTRY.
+ * The daemon calls it once at startup with its host API and binds the returned handlers
+ * to elements.json items by "<plugin>/<handler>". Plugins include only this header; no
+ * rbus types cross the boundary.
+ *
+ * Compatibility: abi_version must equal RBE_PLUGIN_ABI_VERSION. RbeHostApi only grows
+ * at the end, so check host->size before using members added after version 1.
+ *
+ * Threading: get, set and method handlers run on rbus callback threads, possibly
+ * concurrently; sample runs on the daemon's main loop. */
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RBE_PLUGIN_ABI_VERSION 1
+#define RBE_PLUGIN_ENTRY "rbe_plugin_init"
+
+// Handler return codes, mapped to the matching rbus errors
+#define RBE_OK 0
+#define RBE_ERROR 1
+#define RBE_INVALID_INPUT 2
+#define RBE_ACCESS_NOT_ALLOWED 3
+
+typedef enum {
+   RBE_NONE = 0,
+   RBE_BOOL,
+   RBE_INT32,
+   RBE_UINT32,
+   RBE_INT64,
+   RBE_UINT64,
+   RBE_DOUBLE,
+   RBE_STRING
+} RbeValueType;
+
+// Read-only input value; strings point into the caller's storage and are not NUL terminated
+typedef struct {
+   RbeValueType type;
+   union {
+      bool b;
+      int32_t i32;
+      uint32_t u32;
+      int64_t i64;
+      uint64_t u64;
+      double d;
+      struct {
+         const char *ptr;
+         size_t len;
+      } s;
+   } v;
+} RbeValue;
+
+// Host-owned output slot, written through RbeHostApi and converted once by the daemon
+typedef struct RbeValueOut RbeValueOut;
+
+typedef struct {
+   uint32_t abi_version;
+   uint32_t size;   // sizeof(RbeHostApi) in the daemon
+   void (*set_bool)(RbeValueOut *out, bool v);
+   void (*set_int32)(RbeValueOut *out, int32_t v);
+   void (*set_uint32)(RbeValueOut *out, uint32_t v);
+   void (*set_int64)(RbeValueOut *out, int64_t v);
+   void (*set_uint64)(RbeValueOut *out, uint64_t v);
+   void (*set_double)(RbeValueOut *out, double v);
+   void (*set_string)(RbeValueOut *out, const char *s, size_t len);
+   /* Format a string in place: string_buffer returns room for at least len bytes plus
+    * a terminator (NULL if unavailable), and commit_string sets the final length. */
+   char *(*string_buffer)(RbeValueOut *out, size_t len);
+   void (*commit_string)(RbeValueOut *out, size_t len);
+   void (*log)(const char *plugin, const char *msg);
+} RbeHostApi;
+
+typedef int (*RbeGetFn)(void *ctx, const char *name, RbeValueOut *out);
+typedef int (*RbeSetFn)(void *ctx, const char *name, const RbeValue *value);
+/* args follow the method's input schema (type RBE_NONE when omitted) and outs its output
+ * schema; outputs left unwritten are not returned. */
+typedef int (*RbeMethodFn)(void *ctx, const char *method, const RbeValue *args, int num_args, RbeValueOut *const *outs, int num_outs);
+
+typedef struct {
+   const char *name;   // referenced from elements.json as "<plugin>/<name>"
+   RbeGetFn get;       // property getter
+   RbeSetFn set;       // property setter, NULL for read-only properties
+   RbeMethodFn method; // method handler
+   void *ctx;
+} RbeHandler;
+
+typedef struct {
+   uint32_t abi_version; // RBE_PLUGIN_ABI_VERSION
+   const char *name;
+   const RbeHandler *handlers;
+   int num_handlers;
+   unsigned int sample_interval_ms; // 0 = no sampler
+   void (*sample)(void *ctx);
+   void *sample_ctx;
+   void (*shutdown)(void);
+} RbePlugin;
+
+// The one symbol a plugin exports; NULL declines to load
+typedef const RbePlugin *(*RbePluginInitFn)(const RbeHostApi *host);
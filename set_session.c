@@ -0,0 +1,265 @@
+#include "rbus_elements.h"
+
+// A multi-parameter set (rbus_setMulti, or sets inside an rbus session) reaches the
+// provider as one setHandler call per property with commit false on all but the last.
+// Values are type checked and converted as they arrive, kept in a private overlay, and
+// only written to the model when the commit arrives; any failure discards the lot.
+typedef struct {
+   char* name;
+   ValueType type;
+   ElementValue value;
+   rbusValue_t raw;     // kept for history, alarms and the commit event
+} StagedSet;
+
+// Sessions are keyed on the rbus session id and the requesting component: a plain
+// rbus_setMulti always arrives as session 0
+typedef struct {
+   bool used;
+   uint32_t id;
+   char* owner;
+   time_t started;
+   StagedSet* sets;
+   int count;
+   int cap;
+} SetSession;
+
+static SetSession g_sessions[MAX_SET_SESSIONS];
+
+static time_t monotonic_seconds(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec;
+}
+
+static void discard_session(SetSession* s) {
+   for (int i = 0; i < s->count; i++) {
+      StagedSet* st = &s->sets[i];
+      if (IS_STRING_TYPE(st->type)) free(st->value.strVal);
+      rbusValue_Release(st->raw);
+      free(st->name);
+   }
+   free(s->sets);
+   free(s->owner);
+   memset(s, 0, sizeof(*s));
+}
+
+// A client that died mid-transaction never sends its commit
+static bool expire_session(SetSession* s, time_t now) {
+   if (s->used && now - s->started > SET_SESSION_TIMEOUT) {
+      fprintf(stderr, "Discarding uncommitted set session %u\n", s->id);
+      discard_session(s);
+      return true;
+   }
+   return false;
+}
+
+static bool same_owner(const SetSession* s, const char* owner) {
+   return s->owner && owner ? strcmp(s->owner, owner) == 0 : s->owner == owner;
+}
+
+static SetSession* find_session(const rbusSetHandlerOptions_t* options) {
+   time_t now = monotonic_seconds();
+   for (int i = 0; i < MAX_SET_SESSIONS; i++) {
+      SetSession* s = &g_sessions[i];
+      if (s->used && s->id == options->sessionId && same_owner(s, options->requestingComponent) &&
+         !expire_session(s, now)) {
+         return s;
+      }
+   }
+   return NULL;
+}
+
+static SetSession* open_session(const rbusSetHandlerOptions_t* options) {
+   time_t now = monotonic_seconds();
+   SetSession* free_slot = NULL;
+   for (int i = 0; i < MAX_SET_SESSIONS; i++) {
+      SetSession* s = &g_sessions[i];
+      expire_session(s, now);
+      if (!s->used && !free_slot) {
+         free_slot = s;
+      }
+   }
+   if (free_slot) {
+      char* owner = options->requestingComponent ? strdup(options->requestingComponent) : NULL;
+      if (options->requestingComponent && !owner) {
+         return NULL;
+      }
+      free_slot->used = true;
+      free_slot->id = options->sessionId;
+      free_slot->owner = owner;
+      free_slot->started = now;
+   }
+   return free_slot;
+}
+
+static void publish_commit(rbusHandle_t handle, const SetSession* s) {
+   rbusObject_t data, values;
+   rbusObject_Init(&data, NULL);
+   rbusObject_Init(&values, NULL);
+   for (int i = 0; i < s->count; i++) {
+      rbusObject_SetValue(values, s->sets[i].name, s->sets[i].raw);
+   }
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, s->id);
+   rbusObject_SetValue(data, "SessionId", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, (uint32_t)s->count);
+   rbusObject_SetValue(data, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt64(val, changelog_version());
+   rbusObject_SetValue(data, "Version", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, values);
+   rbusObject_SetValue(data, "Values", val);
+   rbusValue_Release(val);
+
+   rbusEvent_t event = {.name = SET_COMMIT_EVENT, .type = RBUS_EVENT_GENERAL, .data = data};
+   rbusError_t rc = rbusEvent_Publish(handle, &event);
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish set commit event: %d\n", rc);
+   }
+   rbusObject_Release(values);
+   rbusObject_Release(data);
+}
+
+static rbusError_t commit_session(rbusHandle_t handle, SetSession* s) {
+   SetTarget* targets = calloc(s->count ? s->count : 1, sizeof(SetTarget));
+   if (!targets) {
+      discard_session(s);
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+
+   // Rows may have been removed since staging, so resolve everything again first, without
+   // creating anything, so a rejected batch leaves the model untouched
+   for (int i = 0; i < s->count; i++) {
+      rbusError_t rc = set_resolve(s->sets[i].name, s->sets[i].raw, false, &targets[i]);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         fprintf(stderr, "Set session %u rejected at %s: %d\n", s->id, s->sets[i].name, rc);
+         free(targets);
+         discard_session(s);
+         return rc;
+      }
+   }
+
+   // Then create the row properties set for the first time; only allocation can fail
+   for (int i = 0; i < s->count; i++) {
+      if (targets[i].de || targets[i].prop) continue;
+      rbusError_t rc = set_resolve(s->sets[i].name, s->sets[i].raw, true, &targets[i]);
+      if (rc != RBUS_ERROR_SUCCESS) {
+         free(targets);
+         discard_session(s);
+         return rc;
+      }
+   }
+
+   // Nothing can fail past this point, so the whole batch lands in one handler call
+   for (int i = 0; i < s->count; i++) {
+      StagedSet* st = &s->sets[i];
+      set_apply(st->name, &targets[i], &st->value, st->raw);
+      st->value.strVal = NULL; // now owned by the model
+   }
+   free(targets);
+
+   publish_commit(handle, s);
+   discard_session(s);
+   return RBUS_ERROR_SUCCESS;
+}
+
+bool set_session_pending(const rbusSetHandlerOptions_t* options) {
+   return options && (!options->commit || find_session(options));
+}
+
+// Setters other than setHandler apply their value at once, but still end the batch they
+// are part of: rbus stops a batch at the first failed set and never sends its commit,
+// so a failure drops what was staged, and a commit that lands here commits it
+rbusError_t set_session_end(rbusHandle_t handle, const rbusSetHandlerOptions_t* options, rbusError_t rc) {
+   if (!options) {
+      return rc;
+   }
+   model_lock();
+   SetSession* s = find_session(options);
+   if (s && rc != RBUS_ERROR_SUCCESS) {
+      discard_session(s);
+   } else if (s && options->commit) {
+      rc = commit_session(handle, s);
+   }
+   model_unlock();
+   return rc;
+}
+
+rbusError_t set_session_stage(rbusHandle_t handle, const rbusSetHandlerOptions_t* options, const char* name, rbusValue_t value) {
+   SetSession* s = find_session(options);
+   if (!s && !(s = open_session(options))) {
+      fprintf(stderr, "Too many open set sessions\n");
+      return RBUS_ERROR_OUT_OF_RESOURCES;
+   }
+
+   // Type errors are reported on the offending set, and roll back everything staged so far
+   SetTarget target;
+   ElementValue v;
+   rbusError_t rc = set_resolve(name, value, false, &target);
+   if (rc == RBUS_ERROR_SUCCESS) {
+      rc = value_from_rbus(target.type, value, &v);
+   }
+   if (rc != RBUS_ERROR_SUCCESS) {
+      discard_session(s);
+      return rc;
+   }
+
+   StagedSet* st = NULL;
+   for (int i = 0; i < s->count; i++) {
+      if (strcmp(s->sets[i].name, name) == 0) {
+         // Last write wins within a session
+         st = &s->sets[i];
+         if (IS_STRING_TYPE(st->type)) free(st->value.strVal);
+         rbusValue_Release(st->raw);
+         break;
+      }
+   }
+   if (!st) {
+      if (s->count == s->cap) {
+         int cap = s->cap ? s->cap * 2 : 16;
+         StagedSet* sets = realloc(s->sets, cap * sizeof(StagedSet));
+         if (!sets) {
+            if (IS_STRING_TYPE(target.type)) free(v.strVal);
+            discard_session(s);
+            return RBUS_ERROR_OUT_OF_RESOURCES;
+         }
+         s->sets = sets;
+         s->cap = cap;
+      }
+      st = &s->sets[s->count];
+      st->name = strdup(name);
+      if (!st->name) {
+         if (IS_STRING_TYPE(target.type)) free(v.strVal);
+         discard_session(s);
+         return RBUS_ERROR_OUT_OF_RESOURCES;
+      }
+      s->count++;
+   }
+   st->type = target.type;
+   st->value = v;
+   st->raw = value;
+   rbusValue_Retain(value);
+
+   if (options->commit) {
+      return commit_session(handle, s);
+   }
+   return RBUS_ERROR_SUCCESS;
+}
+
+void set_session_cleanup(void) {
+   for (int i = 0; i < MAX_SET_SESSIONS; i++) {
+      if (g_sessions[i].used) {
+         discard_session(&g_sessions[i]);
+      }
+   }
+}
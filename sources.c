@@ -0,0 +1,532 @@
+#include "rbus_elements.h"
+#include <regex.h>
+#include <ctype.h>
+#include <strings.h>
+#include <pthread.h>
+
+extern rbusHandle_t g_rbusHandle;
+
+// A file or command read at most once per refresh and shared by every property bound to it
+typedef struct {
+   char* path;
+   bool command;
+   int fd;
+   char* buf;
+   size_t len;
+   size_t cap;
+   uint64_t fetched;   // CLOCK_MONOTONIC ms of the last successful read, 0 if never
+   bool watch;         // re-read on inotify change instead of per TTL
+   bool watching;
+} SourceData;
+
+typedef struct {
+   char name[MAX_NAME_LEN];
+   ValueType type;
+   int source;         // index into g_sources
+   int line;           // 1-based line number, 0 for the first line (or the key's line)
+   char* key;          // select the line starting with this key
+   int column;         // whitespace-separated field, -1 for the whole (remaining) line
+   bool has_regex;
+   regex_t regex;      // first capture group (or whole match) of the selected text
+   double scale;
+   uint32_t ttl_ms;
+   uint64_t fetched;
+   bool valid;
+   ElementValue value;
+} SourceBinding;
+
+static SourceData* g_sources = NULL;
+static int g_num_sources = 0;
+static SourceBinding* g_bindings = NULL;
+static int g_num_bindings = 0;
+// Getters run on rbus threads while watched files are reloaded on the event loop
+static pthread_mutex_t g_source_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t now_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static int find_or_add_source(const char* path, bool command) {
+   for (int i = 0; i < g_num_sources; i++) {
+      if (g_sources[i].command == command && strcmp(g_sources[i].path, path) == 0) {
+         return i;
+      }
+   }
+   SourceData* sources = realloc(g_sources, (g_num_sources + 1) * sizeof(SourceData));
+   if (!sources) {
+      return -1;
+   }
+   g_sources = sources;
+   SourceData* s = &g_sources[g_num_sources];
+   memset(s, 0, sizeof(SourceData));
+   s->path = strdup(path);
+   if (!s->path) {
+      return -1;
+   }
+   s->command = command;
+   s->fd = -1;
+   return g_num_sources++;
+}
+
+bool source_add_binding(const char* name, ValueType type, cJSON* source, int index) {
+   cJSON* file_obj = cJSON_GetObjectItem(source, "file");
+   cJSON* command_obj = cJSON_GetObjectItem(source, "command");
+   cJSON* line_obj = cJSON_GetObjectItem(source, "line");
+   cJSON* key_obj = cJSON_GetObjectItem(source, "key");
+   cJSON* column_obj = cJSON_GetObjectItem(source, "column");
+   cJSON* regex_obj = cJSON_GetObjectItem(source, "regex");
+   cJSON* scale_obj = cJSON_GetObjectItem(source, "scale");
+   cJSON* ttl_obj = cJSON_GetObjectItem(source, "ttl");
+   cJSON* watch_obj = cJSON_GetObjectItem(source, "watch");
+
+   if (cJSON_IsString(file_obj) == cJSON_IsString(command_obj)) {
+      fprintf(stderr, "Source for item %d needs exactly one of file or command\n", index);
+      return false;
+   }
+   if (cJSON_IsTrue(watch_obj) && !cJSON_IsString(file_obj)) {
+      fprintf(stderr, "Source for item %d: only files can be watched\n", index);
+      return false;
+   }
+
+   SourceBinding* bindings = realloc(g_bindings, (g_num_bindings + 1) * sizeof(SourceBinding));
+   if (!bindings) {
+      fprintf(stderr, "Failed to allocate memory for property sources\n");
+      return false;
+   }
+   g_bindings = bindings;
+   SourceBinding* b = &g_bindings[g_num_bindings];
+   memset(b, 0, sizeof(SourceBinding));
+   snprintf(b->name, MAX_NAME_LEN, "%s", name);
+   b->type = type;
+   b->line = cJSON_IsNumber(line_obj) && line_obj->valuedouble >= 1 ? (int)line_obj->valuedouble : 0;
+   b->column = cJSON_IsNumber(column_obj) && column_obj->valuedouble >= 0 ? (int)column_obj->valuedouble : -1;
+   b->scale = cJSON_IsNumber(scale_obj) ? scale_obj->valuedouble : 1.0;
+   b->ttl_ms = cJSON_IsNumber(ttl_obj) && ttl_obj->valuedouble >= 0 ? (uint32_t)(ttl_obj->valuedouble * 1000) : SOURCE_DEFAULT_TTL_MS;
+
+   if (cJSON_IsString(key_obj) && !(b->key = strdup(key_obj->valuestring))) {
+      fprintf(stderr, "Failed to allocate memory for property sources\n");
+      return false;
+   }
+   if (cJSON_IsString(regex_obj)) {
+      if (regcomp(&b->regex, regex_obj->valuestring, REG_EXTENDED) != 0) {
+         fprintf(stderr, "Invalid source regex for item %d\n", index);
+         free(b->key);
+         return false;
+      }
+      b->has_regex = true;
+   }
+
+   bool command = cJSON_IsString(command_obj);
+   b->source = find_or_add_source(command ? command_obj->valuestring : file_obj->valuestring, command);
+   if (b->source < 0) {
+      fprintf(stderr, "Failed to allocate memory for property sources\n");
+      free(b->key);
+      if (b->has_regex) regfree(&b->regex);
+      return false;
+   }
+
+   if (cJSON_IsTrue(watch_obj)) {
+      g_sources[b->source].watch = true;
+   }
+   g_num_bindings++;
+   return true;
+}
+
+static bool ensure_capacity(SourceData* s, size_t need) {
+   if (need <= s->cap) return true;
+   size_t cap = s->cap ? s->cap : 1024;
+   while (cap < need) cap *= 2;
+   if (cap > SOURCE_MAX_BYTES + 1) cap = SOURCE_MAX_BYTES + 1;
+   if (cap < need) return false;
+   char* buf = realloc(s->buf, cap);
+   if (!buf) return false;
+   s->buf = buf;
+   s->cap = cap;
+   return true;
+}
+
+static bool read_file_source(SourceData* s) {
+   if (s->fd < 0) {
+      s->fd = open(s->path, O_RDONLY | O_CLOEXEC);
+      if (s->fd < 0) return false;
+   }
+
+   // procfs and sysfs regenerate content on a read from offset 0, so the fd stays open
+   size_t len = 0;
+   for (;;) {
+      if (!ensure_capacity(s, len + 1024)) break;
+      ssize_t n = pread(s->fd, s->buf + len, s->cap - len - 1, (off_t)len);
+      if (n < 0 && errno == EINTR) continue;
+      if (n < 0) {
+         close(s->fd);
+         s->fd = -1;
+         return false;
+      }
+      if (n == 0) break;
+      len += (size_t)n;
+   }
+   if (!s->buf) return false;
+   s->buf[len] = '\0';
+   s->len = len;
+   return true;
+}
+
+static bool read_command_source(SourceData* s) {
+   FILE* fp = popen(s->path, "r");
+   if (!fp) return false;
+
+   size_t len = 0;
+   while (ensure_capacity(s, len + 1024)) {
+      size_t n = fread(s->buf + len, 1, s->cap - len - 1, fp);
+      if (n == 0) break;
+      len += n;
+   }
+   int status = pclose(fp);
+   if (!s->buf || status != 0) return false;
+   s->buf[len] = '\0';
+   s->len = len;
+   return true;
+}
+
+// Content younger than the caller's TTL is reused, so properties bound to the same file
+// and read together cost one read. Called with g_source_lock held; it is dropped while
+// a command runs so getters of other sources are not stuck behind it.
+static bool refresh_source(SourceData* s, uint32_t ttl_ms, uint64_t now) {
+   if (s->fetched != 0 && now - s->fetched < ttl_ms) {
+      return true;
+   }
+   if (!s->command) {
+      if (!read_file_source(s)) {
+         return false;
+      }
+      s->fetched = now;
+      return true;
+   }
+
+   SourceData out = {.path = s->path, .fd = -1};
+   pthread_mutex_unlock(&g_source_lock);
+   bool ok = read_command_source(&out);
+   pthread_mutex_lock(&g_source_lock);
+   if (!ok) {
+      free(out.buf);
+      return false;
+   }
+   free(s->buf);
+   s->buf = out.buf;
+   s->len = out.len;
+   s->cap = out.cap;
+   s->fetched = now;
+   return true;
+}
+
+static const char* select_line(const SourceBinding* b, const char* text, size_t* len) {
+   const char* p = text;
+   int line = 1;
+   while (*p) {
+      const char* end = strchr(p, '\n');
+      size_t n = end ? (size_t)(end - p) : strlen(p);
+
+      if (b->key) {
+         size_t klen = strlen(b->key);
+         if (n >= klen && strncmp(p, b->key, klen) == 0 && (n == klen || strchr(": \t=", p[klen]))) {
+            p += klen;
+            n -= klen;
+            while (n > 0 && strchr(": \t=", *p)) { p++; n--; }
+            *len = n;
+            return p;
+         }
+      } else if (b->line == 0 || b->line == line) {
+         *len = n;
+         return p;
+      }
+
+      if (!end) break;
+      p = end + 1;
+      line++;
+   }
+   return NULL;
+}
+
+static bool extract_token(const SourceBinding* b, const char* text, char* out, size_t outlen) {
+   size_t len;
+   const char* p = select_line(b, text, &len);
+   if (!p) return false;
+
+   if (b->column >= 0) {
+      const char* end = p + len;
+      for (int col = 0;; col++) {
+         while (p < end && isspace((unsigned char)*p)) p++;
+         const char* start = p;
+         while (p < end && !isspace((unsigned char)*p)) p++;
+         if (start == p) return false;
+         if (col == b->column) {
+            len = (size_t)(p - start);
+            p = start;
+            break;
+         }
+      }
+   }
+
+   if (len >= outlen) len = outlen - 1;
+   memcpy(out, p, len);
+   out[len] = '\0';
+
+   if (b->has_regex) {
+      regmatch_t m[2];
+      if (regexec(&b->regex, out, 2, m, 0) != 0) return false;
+      int g = m[1].rm_so >= 0 ? 1 : 0;
+      size_t mlen = (size_t)(m[g].rm_eo - m[g].rm_so);
+      memmove(out, out + m[g].rm_so, mlen);
+      out[mlen] = '\0';
+   } else {
+      // Trim surrounding whitespace of whole-line selections
+      while (len > 0 && isspace((unsigned char)out[len - 1])) out[--len] = '\0';
+      size_t skip = strspn(out, " \t");
+      memmove(out, out + skip, len - skip + 1);
+   }
+   return true;
+}
+
+static bool parse_token(const SourceBinding* b, const char* token, ElementValue* out) {
+   char* end = NULL;
+   int base = strncmp(token, "0x", 2) == 0 ? 16 : 10;
+   errno = 0;
+
+   switch (b->type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64:
+         out->strVal = strdup(token);
+         return out->strVal != NULL;
+      case TYPE_BOOL:
+         out->boolVal = strcmp(token, "1") == 0 || strcasecmp(token, "true") == 0 ||
+            strcasecmp(token, "yes") == 0 || strcasecmp(token, "on") == 0;
+         return true;
+      case TYPE_FLOAT:
+      case TYPE_DOUBLE: {
+         double d = strtod(token, &end);
+         if (end == token || errno) return false;
+         d *= b->scale;
+         if (b->type == TYPE_FLOAT) out->floatVal = (float)d;
+         else out->doubleVal = d;
+         return true;
+      }
+      case TYPE_INT:
+      case TYPE_LONG: {
+         int64_t v = strtoll(token, &end, base);
+         if (end == token || errno) return false;
+         if (b->scale != 1.0) v = (int64_t)((double)v * b->scale);
+         if (b->type == TYPE_INT) out->intVal = (int32_t)v;
+         else out->longVal = v;
+         return true;
+      }
+      case TYPE_UINT:
+      case TYPE_ULONG:
+      case TYPE_BYTE: {
+         uint64_t v = strtoull(token, &end, base);
+         if (end == token || errno) return false;
+         if (b->scale != 1.0) v = (uint64_t)((double)v * b->scale);
+         if (b->type == TYPE_UINT) out->uintVal = (uint32_t)v;
+         else if (b->type == TYPE_ULONG) out->ulongVal = v;
+         else out->byteVal = (uint8_t)v;
+         return true;
+      }
+   }
+   return false;
+}
+
+static bool value_equal(ValueType type, const ElementValue* a, const ElementValue* b) {
+   switch (type) {
+      case TYPE_STRING:
+      case TYPE_DATETIME:
+      case TYPE_BASE64: return strcmp(a->strVal, b->strVal) == 0;
+      case TYPE_INT: return a->intVal == b->intVal;
+      case TYPE_UINT: return a->uintVal == b->uintVal;
+      case TYPE_BOOL: return a->boolVal == b->boolVal;
+      case TYPE_LONG: return a->longVal == b->longVal;
+      case TYPE_ULONG: return a->ulongVal == b->ulongVal;
+      case TYPE_FLOAT: return a->floatVal == b->floatVal;
+      case TYPE_DOUBLE: return a->doubleVal == b->doubleVal;
+      case TYPE_BYTE: return a->byteVal == b->byteVal;
+   }
+   return false;
+}
+
+// Extract and parse the binding's value from its source's current content. Returns
+// true if the stored value changed; *old receives the previous value (caller frees strings).
+static bool update_binding(SourceBinding* b, ElementValue* old, bool* changed) {
+   SourceData* s = &g_sources[b->source];
+   char token[SOURCE_MAX_TOKEN];
+   ElementValue v;
+   if (!s->buf || !extract_token(b, s->buf, token, sizeof(token)) || !parse_token(b, token, &v)) {
+      return false;
+   }
+   *changed = !b->valid || !value_equal(b->type, &b->value, &v);
+   *old = b->value;
+   if (!b->valid) memset(old, 0, sizeof(*old));
+   b->value = v;
+   b->valid = true;
+   return true;
+}
+
+static int compare_bindings(const void* a, const void* b) {
+   return strcmp(((const SourceBinding*)a)->name, ((const SourceBinding*)b)->name);
+}
+
+// Bindings are searched from rbus threads without the lock, so they are sorted once
+// before any handler is registered and never move afterwards
+void source_finish_load(void) {
+   qsort(g_bindings, g_num_bindings, sizeof(SourceBinding), compare_bindings);
+}
+
+static SourceBinding* find_binding(const char* name) {
+   SourceBinding key;
+   snprintf(key.name, MAX_NAME_LEN, "%s", name);
+   return bsearch(&key, g_bindings, g_num_bindings, sizeof(SourceBinding), compare_bindings);
+}
+
+rbusError_t source_get_handler(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+   SourceBinding* b = find_binding(rbusProperty_GetName(property));
+   if (!b) {
+      return RBUS_ERROR_ELEMENT_DOES_NOT_EXIST;
+   }
+
+   // Watched files are re-read on change notifications, so their value is always current
+   pthread_mutex_lock(&g_source_lock);
+   uint64_t now = now_ms();
+   SourceData* s = &g_sources[b->source];
+   if (!b->valid || (!s->watching && now - b->fetched >= b->ttl_ms)) {
+      ElementValue old;
+      bool changed;
+      if (!refresh_source(s, b->ttl_ms, now) || !update_binding(b, &old, &changed)) {
+         pthread_mutex_unlock(&g_source_lock);
+         return RBUS_ERROR_BUS_ERROR;
+      }
+      if (IS_STRING_TYPE(b->type)) free(old.strVal);
+      b->fetched = now;
+   }
+
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   value_to_rbus(value, b->type, &b->value);
+   pthread_mutex_unlock(&g_source_lock);
+   rbusProperty_SetValue(property, value);
+   rbusValue_Release(value);
+   return RBUS_ERROR_SUCCESS;
+}
+
+static void publish_source_change(const SourceBinding* b, const ElementValue* old) {
+   rbusObject_t data;
+   rbusObject_Init(&data, NULL);
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   value_to_rbus(val, b->type, &b->value);
+   rbusObject_SetValue(data, "value", val);
+   rbusValue_Release(val);
+
+   if (!IS_STRING_TYPE(b->type) || old->strVal) {
+      rbusValue_Init(&val);
+      value_to_rbus(val, b->type, old);
+      rbusObject_SetValue(data, "oldValue", val);
+      rbusValue_Release(val);
+   }
+
+   rbusEvent_t event = {.name = b->name, .type = RBUS_EVENT_VALUE_CHANGED, .data = data};
+   rbusError_t rc = rbusEvent_Publish(g_rbusHandle, &event);
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish value change for %s: %d\n", b->name, rc);
+   }
+   rbusObject_Release(data);
+}
+
+// Re-read a watched file and update every property bound to it. The fd is reopened
+// because editors and package managers usually replace the file rather than rewrite it.
+static void reload_source(int index, bool publish) {
+   SourceData* s = &g_sources[index];
+   pthread_mutex_lock(&g_source_lock);
+   if (s->fd >= 0) {
+      close(s->fd);
+      s->fd = -1;
+   }
+   if (!read_file_source(s)) {
+      // Deleted or unreadable: keep serving the last values until it reappears
+      pthread_mutex_unlock(&g_source_lock);
+      return;
+   }
+   s->fetched = now_ms();
+
+   for (int i = 0; i < g_num_bindings; i++) {
+      SourceBinding* b = &g_bindings[i];
+      ElementValue old;
+      bool changed;
+      if (b->source != index || !update_binding(b, &old, &changed)) continue;
+      b->fetched = s->fetched;
+
+      if (changed && publish) {
+         DataElement* de = lookup_element(b->name);
+         if (de) {
+            de->version = changelog_record(b->name, CHANGE_VALUE);
+         }
+         publish_source_change(b, &old);
+      }
+      if (IS_STRING_TYPE(b->type)) free(old.strVal);
+   }
+   pthread_mutex_unlock(&g_source_lock);
+}
+
+static void source_file_changed(void* ctx) {
+   // Taken before g_source_lock: publishing bumps the element's version
+   model_lock();
+   reload_source((int)(intptr_t)ctx, true);
+   model_unlock();
+}
+
+void source_watch_init(void) {
+   for (int i = 0; i < g_num_sources; i++) {
+      SourceData* s = &g_sources[i];
+      if (!s->watch) continue;
+      s->watching = file_watch_add(s->path, source_file_changed, (void*)(intptr_t)i) >= 0;
+      if (!s->watching) {
+         fprintf(stderr, "Watching %s failed, falling back to TTL reads\n", s->path);
+      }
+      reload_source(i, false);
+   }
+}
+
+rbusError_t source_sub_handler(rbusHandle_t handle, rbusEventSubAction_t action, const char* eventName, rbusFilter_t filter, int32_t interval, bool* autoPublish) {
+   (void)handle; (void)action; (void)filter; (void)interval;
+   // Watched sources publish their own changes; everything else is polled by rbus
+   SourceBinding* b = find_binding(eventName);
+   *autoPublish = !(b && g_sources[b->source].watching);
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t source_set_handler(rbusHandle_t handle, rbusProperty_t property, rbusSetHandlerOptions_t* options) {
+   (void)property;
+   return set_session_end(handle, options, RBUS_ERROR_ACCESS_NOT_ALLOWED);
+}
+
+void source_cleanup(void) {
+   for (int i = 0; i < g_num_bindings; i++) {
+      SourceBinding* b = &g_bindings[i];
+      free(b->key);
+      if (b->has_regex) regfree(&b->regex);
+      if (IS_STRING_TYPE(b->type) && b->valid) free(b->value.strVal);
+   }
+   free(g_bindings);
+   g_bindings = NULL;
+   g_num_bindings = 0;
+
+   for (int i = 0; i < g_num_sources; i++) {
+      if (g_sources[i].fd >= 0) close(g_sources[i].fd);
+      free(g_sources[i].path);
+      free(g_sources[i].buf);
+   }
+   free(g_sources);
+   g_sources = NULL;
+   g_num_sources = 0;
+}
@@ -0,0 +1,184 @@
+#include "rbus_elements.h"
+
+extern rbusHandle_t g_rbusHandle;
+
+typedef enum {
+   MEM_LEVEL_NORMAL = 0,
+   MEM_LEVEL_LOW = 1,
+   MEM_LEVEL_CRITICAL = 2
+} MemoryLevel;
+
+static const char* g_mem_level_names[] = {"Normal", "LowMemory", "CriticalMemory"};
+
+typedef struct {
+   bool primed;                // baseline captured since the first subscriber arrived
+   MemoryLevel level;          // last published memory level
+   MemoryLevel pending_level;  // candidate level waiting for confirmation
+   int pending_level_count;
+   uint32_t if_count;          // last published interface state
+   uint32_t if_hash;
+   uint32_t pending_if_hash;   // candidate interface state waiting for confirmation
+   int pending_if_count;
+} StatusMonitor;
+
+static StatusMonitor g_monitor = {0};
+static int g_subscribers = 0;
+static int g_rearm = 0;
+
+// Memory level with hysteresis: entering a level uses the *_ENTER threshold, leaving
+// it needs free memory to climb back past the higher *_EXIT threshold.
+static MemoryLevel classify_memory(MemoryLevel current, uint64_t free_kb, uint64_t total_kb) {
+   if (total_kb == 0) return current;
+   uint32_t pct = (uint32_t)(free_kb * 100 / total_kb);
+
+   switch (current) {
+      case MEM_LEVEL_CRITICAL:
+         if (pct >= STATUS_LOW_MEM_EXIT_PCT) return MEM_LEVEL_NORMAL;
+         if (pct >= STATUS_CRIT_MEM_EXIT_PCT) return MEM_LEVEL_LOW;
+         return MEM_LEVEL_CRITICAL;
+      case MEM_LEVEL_LOW:
+         if (pct < STATUS_CRIT_MEM_ENTER_PCT) return MEM_LEVEL_CRITICAL;
+         if (pct >= STATUS_LOW_MEM_EXIT_PCT) return MEM_LEVEL_NORMAL;
+         return MEM_LEVEL_LOW;
+      default:
+         if (pct < STATUS_CRIT_MEM_ENTER_PCT) return MEM_LEVEL_CRITICAL;
+         if (pct < STATUS_LOW_MEM_ENTER_PCT) return MEM_LEVEL_LOW;
+         return MEM_LEVEL_NORMAL;
+   }
+}
+
+static void publish_status(const char* reason, uint64_t free_kb, uint64_t total_kb, uint32_t uptime) {
+   rbusObject_t data;
+   rbusObject_Init(&data, NULL);
+
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, g_mem_level_names[g_monitor.level]);
+   rbusObject_SetValue(data, "Status", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetString(val, reason);
+   rbusObject_SetValue(data, "Reason", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, (uint32_t)free_kb);
+   rbusObject_SetValue(data, "MemoryFree", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, (uint32_t)total_kb);
+   rbusObject_SetValue(data, "MemoryTotal", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, uptime);
+   rbusObject_SetValue(data, "UpTime", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetUInt32(val, g_monitor.if_count);
+   rbusObject_SetValue(data, "InterfacesUp", val);
+   rbusValue_Release(val);
+
+   rbusEvent_t event = {.name = SYSTEM_STATUS_EVENT, .type = RBUS_EVENT_GENERAL, .data = data};
+   rbusError_t rc = rbusEvent_Publish(g_rbusHandle, &event);
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish %s: %d\n", SYSTEM_STATUS_EVENT, rc);
+   }
+   rbusObject_Release(data);
+}
+
+static void status_monitor_tick(void* ctx) {
+   (void)ctx;
+
+   // Nothing to do while nobody listens; the next subscriber re-captures a baseline
+   if (__atomic_load_n(&g_subscribers, __ATOMIC_ACQUIRE) <= 0) {
+      return;
+   }
+   if (__atomic_exchange_n(&g_rearm, 0, __ATOMIC_ACQ_REL)) {
+      g_monitor.primed = false;
+   }
+
+   uint64_t total_kb = 0, free_kb = 0;
+   if (!device_memory_status(&total_kb, &free_kb, NULL)) {
+      return;
+   }
+   uint32_t if_hash = 0;
+   uint32_t if_count = device_interfaces_up(&if_hash);
+
+   if (!g_monitor.primed) {
+      g_monitor.level = classify_memory(MEM_LEVEL_NORMAL, free_kb, total_kb);
+      g_monitor.pending_level = g_monitor.level;
+      g_monitor.pending_level_count = 0;
+      g_monitor.if_count = if_count;
+      g_monitor.if_hash = if_hash;
+      g_monitor.pending_if_hash = if_hash;
+      g_monitor.pending_if_count = 0;
+      g_monitor.primed = true;
+      return;
+   }
+
+   const char* reason = NULL;
+
+   // A transition has to hold for STATUS_CONFIRM_SAMPLES consecutive samples before it is published
+   MemoryLevel level = classify_memory(g_monitor.level, free_kb, total_kb);
+   if (level == g_monitor.level) {
+      g_monitor.pending_level_count = 0;
+   } else {
+      if (level != g_monitor.pending_level) {
+         g_monitor.pending_level = level;
+         g_monitor.pending_level_count = 0;
+      }
+      if (++g_monitor.pending_level_count >= STATUS_CONFIRM_SAMPLES) {
+         g_monitor.level = level;
+         g_monitor.pending_level_count = 0;
+         reason = "Memory";
+      }
+   }
+
+   if (if_hash == g_monitor.if_hash) {
+      g_monitor.pending_if_count = 0;
+   } else {
+      if (if_hash != g_monitor.pending_if_hash) {
+         g_monitor.pending_if_hash = if_hash;
+         g_monitor.pending_if_count = 0;
+      }
+      if (++g_monitor.pending_if_count >= STATUS_CONFIRM_SAMPLES) {
+         g_monitor.if_count = if_count;
+         g_monitor.if_hash = if_hash;
+         g_monitor.pending_if_count = 0;
+         reason = reason ? "Memory,Interfaces" : "Interfaces";
+      }
+   }
+
+   if (reason) {
+      uint32_t uptime = 0;
+      device_uptime(&uptime);
+      publish_status(reason, free_kb, total_kb, uptime);
+   }
+}
+
+rbusError_t status_monitor_sub_handler(rbusHandle_t handle, rbusEventSubAction_t action, const char* eventName, rbusFilter_t filter, int32_t interval, bool* autoPublish) {
+   (void)handle; (void)filter; (void)interval;
+   fprintf(stderr, "Event subscription handler called for %s, action: %s\n", eventName,
+      action == RBUS_EVENT_ACTION_SUBSCRIBE ? "subscribe" : "unsubscribe");
+
+   if (action == RBUS_EVENT_ACTION_SUBSCRIBE) {
+      if (__atomic_fetch_add(&g_subscribers, 1, __ATOMIC_ACQ_REL) == 0) {
+         __atomic_store_n(&g_rearm, 1, __ATOMIC_RELEASE);
+      }
+   } else if (__atomic_load_n(&g_subscribers, __ATOMIC_ACQUIRE) > 0) {
+      __atomic_fetch_sub(&g_subscribers, 1, __ATOMIC_ACQ_REL);
+   }
+
+   *autoPublish = false;
+   return RBUS_ERROR_SUCCESS;
+}
+
+void status_monitor_init(void) {
+   if (event_loop_add_timer(STATUS_MONITOR_INTERVAL * 1000, status_monitor_tick, NULL) < 0) {
+      fprintf(stderr, "Failed to schedule system status monitor\n");
+   }
+}
@@ -0,0 +1,443 @@
+#include "rbus_elements.h"
+#include <pthread.h>
+
+// Device.Telemetry.Collect() events are copied into a preallocated ring and handed to
+// a consumer thread, so the method returns without any formatting or I/O. Each ring is
+// a bounded MPSC queue: producers claim a slot by advancing tail with a CAS and publish
+// it through the slot's sequence number; the consumer owns head. High and critical qos
+// events get their own ring, which the consumer always drains first.
+typedef struct {
+   uint32_t seq;
+   TelemetryEvent ev;
+} TelemetrySlot;
+
+typedef struct {
+   TelemetrySlot* slots;
+   uint32_t size;
+   uint32_t tail;
+   uint32_t head;
+} TelemetryRing;
+
+enum { LANE_PRIORITY, LANE_NORMAL, LANE_COUNT };
+
+static TelemetrySlot g_priority_slots[TELEMETRY_PRIORITY_SLOTS];
+static TelemetrySlot g_normal_slots[TELEMETRY_RING_SLOTS];
+static TelemetryRing g_lanes[LANE_COUNT] = {
+   {g_priority_slots, TELEMETRY_PRIORITY_SLOTS, 0, 0},
+   {g_normal_slots, TELEMETRY_RING_SLOTS, 0, 0},
+};
+
+static uint64_t g_received = 0;
+static uint64_t g_delivered = 0;
+static uint64_t g_dropped = 0;
+static uint32_t g_events_per_sec = 0;
+
+static pthread_t g_consumer;
+static pthread_mutex_t g_wake_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t g_wake = PTHREAD_COND_INITIALIZER;
+static int g_consumer_waiting = 0;
+static int g_running = 0;
+static bool g_started = false;
+static uint64_t g_retry_ms = 0; // spooled delivery is paused until then after a failed flush
+
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Claim a slot only while fewer than limit slots are in use
+static TelemetryEvent* ring_claim(TelemetryRing* ring, uint8_t lane, uint32_t limit) {
+   uint32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+   for (;;) {
+      if ((int32_t)(pos - __atomic_load_n(&ring->head, __ATOMIC_RELAXED)) >= (int32_t)limit) {
+         return NULL;
+      }
+      TelemetrySlot* slot = &ring->slots[pos % ring->size];
+      int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+      if (diff == 0) {
+         if (__atomic_compare_exchange_n(&ring->tail, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+            TelemetryEvent* ev = &slot->ev;
+            ev->pos = pos;
+            ev->lane = lane;
+            ev->valid = false;
+            ev->payload_json = false;
+            ev->len = 0;
+            ev->data = ev->slot_data;
+            ev->cap = sizeof(ev->slot_data);
+            for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) ev->off[f] = TELEMETRY_FIELD_ABSENT;
+            return ev;
+         }
+      } else if (diff < 0) {
+         // Consumer has not freed this slot yet: the ring is full
+         return NULL;
+      } else {
+         pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+      }
+   }
+}
+
+// Backpressure by qos: low qos events are shed once the ring is half full, high and
+// critical ones go to the priority ring and spill into the normal ring, and critical
+// callers are held for up to TELEMETRY_CRITICAL_WAIT_MS rather than dropped outright.
+TelemetryEvent* telemetry_claim(int32_t qos) {
+   TelemetryRing* normal = &g_lanes[LANE_NORMAL];
+   TelemetryRing* priority = &g_lanes[LANE_PRIORITY];
+   TelemetryEvent* ev = NULL;
+
+   if (qos < TELEMETRY_QOS_MEDIUM) {
+      ev = ring_claim(normal, LANE_NORMAL, normal->size / 2);
+   } else if (qos < TELEMETRY_QOS_HIGH) {
+      ev = ring_claim(normal, LANE_NORMAL, normal->size);
+   } else {
+      uint64_t deadline = qos >= TELEMETRY_QOS_CRITICAL ? monotonic_ms() + TELEMETRY_CRITICAL_WAIT_MS : 0;
+      for (;;) {
+         ev = ring_claim(priority, LANE_PRIORITY, priority->size);
+         if (!ev) ev = ring_claim(normal, LANE_NORMAL, normal->size);
+         if (ev || monotonic_ms() >= deadline) break;
+         struct timespec pause = {0, 1000000};
+         nanosleep(&pause, NULL);
+      }
+   }
+   if (!ev) {
+      __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+   }
+   return ev;
+}
+
+void telemetry_commit(TelemetryEvent* ev) {
+   TelemetryRing* ring = &g_lanes[ev->lane];
+   TelemetrySlot* slot = &ring->slots[ev->pos % ring->size];
+   ev->received_ms = monotonic_ms();
+   // Events that did not fit their slot are released unsent
+   __atomic_fetch_add(ev->valid ? &g_received : &g_dropped, 1, __ATOMIC_RELAXED);
+   __atomic_store_n(&slot->seq, ev->pos + 1, __ATOMIC_RELEASE);
+
+   // Only pay for the wakeup when the consumer is actually asleep
+   __atomic_thread_fence(__ATOMIC_SEQ_CST);
+   if (__atomic_load_n(&g_consumer_waiting, __ATOMIC_RELAXED)) {
+      pthread_mutex_lock(&g_wake_lock);
+      pthread_cond_signal(&g_wake);
+      pthread_mutex_unlock(&g_wake_lock);
+   }
+}
+
+// Make room for need bytes of strings. An event that outgrows its slot moves to a heap
+// spill, which the consumer frees when it releases the slot.
+bool telemetry_reserve(TelemetryEvent* ev, size_t need) {
+   if (need <= ev->cap) {
+      return true;
+   }
+   if (need > TELEMETRY_EVENT_MAX_BYTES) {
+      return false;
+   }
+   size_t cap = ev->cap ? (size_t)ev->cap * 2 : TELEMETRY_EVENT_BYTES;
+   while (cap < need) cap *= 2;
+   if (cap > TELEMETRY_EVENT_MAX_BYTES) cap = TELEMETRY_EVENT_MAX_BYTES;
+   bool spilled = ev->data != ev->slot_data;
+   char* data = realloc(spilled ? ev->data : NULL, cap);
+   if (!data) {
+      return false;
+   }
+   if (!spilled) {
+      memcpy(data, ev->slot_data, ev->cap);
+   }
+   ev->data = data;
+   ev->cap = cap;
+   return true;
+}
+
+void telemetry_release_spill(TelemetryEvent* ev) {
+   if (ev->data && ev->data != ev->slot_data) {
+      free(ev->data);
+   }
+   ev->data = ev->slot_data;
+   ev->cap = sizeof(ev->slot_data);
+}
+
+bool telemetry_put(TelemetryEvent* ev, TelemetryField field, const char* s) {
+   size_t n = strlen(s) + 1;
+   if (!telemetry_reserve(ev, ev->len + n)) {
+      return false;
+   }
+   ev->off[field] = ev->len;
+   memcpy(ev->data + ev->len, s, n);
+   ev->len += n;
+   return true;
+}
+
+static int put_entry(TelemetryEvent* ev, size_t len, bool first, const char* key, const char* value) {
+   return snprintf(ev->data + len, ev->cap - len, "%s%s%s%s", first ? "" : ", ", key ? key : "", key ? ": " : "", value);
+}
+
+// Flatten the string values of an object as "a, b" or, with keys, "k: v, k: v"
+bool telemetry_put_object(TelemetryEvent* ev, TelemetryField field, rbusObject_t obj, bool keys) {
+   size_t start = ev->len, len = ev->len;
+   bool first = true;
+   for (rbusProperty_t prop = rbusObject_GetProperties(obj); prop; prop = rbusProperty_GetNext(prop)) {
+      rbusValue_t val = rbusProperty_GetValue(prop);
+      if (!val || rbusValue_GetType(val) != RBUS_STRING) continue;
+      const char* key = keys ? rbusProperty_GetName(prop) : NULL;
+      const char* value = rbusValue_GetString(val, NULL);
+      int n = put_entry(ev, len, first, key, value);
+      if (n >= 0 && len + n + 1 > ev->cap) {
+         // Grow and format again; the entries already written are kept
+         if (!telemetry_reserve(ev, len + n + 1)) {
+            return false;
+         }
+         n = put_entry(ev, len, first, key, value);
+      }
+      if (n < 0) {
+         return false;
+      }
+      len += n;
+      first = false;
+   }
+   if (!telemetry_reserve(ev, len + 1)) {
+      return false;
+   }
+   ev->data[len++] = '\0';
+   ev->off[field] = start;
+   ev->len = len;
+   return true;
+}
+
+static TelemetrySlot* ready_slot(TelemetryRing* ring) {
+   TelemetrySlot* slot = &ring->slots[ring->head % ring->size];
+   return __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == ring->head + 1 ? slot : NULL;
+}
+
+static void release_slot(TelemetryRing* ring, TelemetrySlot* slot) {
+   telemetry_release_spill(&slot->ev);
+   __atomic_store_n(&slot->seq, ring->head + ring->size, __ATOMIC_RELEASE);
+   __atomic_store_n(&ring->head, ring->head + 1, __ATOMIC_RELAXED);
+}
+
+static bool any_ready(void) {
+   return ready_slot(&g_lanes[LANE_PRIORITY]) || ready_slot(&g_lanes[LANE_NORMAL]);
+}
+
+static uint32_t flush(TelemetrySink* sink) {
+   uint32_t n = sink->count;
+   if (n == 0) {
+      return 0;
+   }
+   bool spooled = sink->spool[0];
+   if (!telemetry_sink_flush(sink)) {
+      // Spooled events stay on disk and are sent again once the sink recovers
+      if (spooled) {
+         telemetry_spool_rewind();
+         g_retry_ms = monotonic_ms() + 1000;
+      } else {
+         __atomic_fetch_add(&g_dropped, n, __ATOMIC_RELAXED);
+      }
+      return 0;
+   }
+   if (spooled) {
+      telemetry_spool_ack();
+   }
+   __atomic_fetch_add(&g_delivered, n, __ATOMIC_RELAXED);
+   return n;
+}
+
+// Feed spooled records to the sink under the same batching rules as direct delivery
+static uint32_t pump(TelemetrySink* sink, uint64_t* batch_start, bool urgent) {
+   uint32_t delivered = 0;
+   if (g_retry_ms && monotonic_ms() < g_retry_ms) {
+      return 0;
+   }
+   g_retry_ms = 0;
+
+   const TelemetryEvent* ev;
+   while (!g_retry_ms && (ev = telemetry_spool_peek())) {
+      if (sink->count == 0) {
+         *batch_start = monotonic_ms();
+      }
+      // A record the sink cannot encode is skipped and acknowledged with the batch
+      if (!telemetry_sink_append(sink, ev)) {
+         __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+      }
+      telemetry_spool_next();
+      if (sink->len >= sink->batch_bytes) {
+         delivered += flush(sink);
+      }
+   }
+   if (sink->count > 0 && (urgent || monotonic_ms() - *batch_start >= sink->batch_ms)) {
+      delivered += flush(sink);
+   }
+   return delivered;
+}
+
+// Move everything that is ready into the spool or the sink, priority ring first,
+// flushing whenever the batch fills or takes a critical event. Returns the number of
+// events delivered.
+static uint32_t drain(TelemetrySink* sink, uint64_t* batch_start) {
+   uint32_t delivered = 0;
+   bool spooled = sink->spool[0];
+   bool urgent = false;
+   for (;;) {
+      TelemetryRing* ring = &g_lanes[LANE_PRIORITY];
+      TelemetrySlot* slot = ready_slot(ring);
+      if (!slot) {
+         ring = &g_lanes[LANE_NORMAL];
+         slot = ready_slot(ring);
+      }
+      if (!slot) {
+         break;
+      }
+
+      if (slot->ev.valid) {
+         bool critical = slot->ev.qos >= TELEMETRY_QOS_CRITICAL;
+         if (spooled) {
+            if (telemetry_spool_append(&slot->ev)) {
+               urgent |= critical;
+            } else {
+               __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+            }
+         } else {
+            if (sink->count == 0) {
+               *batch_start = monotonic_ms();
+            }
+            if (telemetry_sink_append(sink, &slot->ev)) {
+               urgent = critical;
+            } else {
+               __atomic_fetch_add(&g_dropped, 1, __ATOMIC_RELAXED);
+            }
+         }
+      }
+      release_slot(ring, slot);
+
+      if (!spooled && (urgent || sink->len >= sink->batch_bytes)) {
+         delivered += flush(sink);
+         urgent = false;
+      }
+   }
+
+   if (spooled) {
+      delivered += pump(sink, batch_start, urgent);
+      telemetry_spool_sync(false);
+   } else if (sink->count > 0 && monotonic_ms() - *batch_start >= sink->batch_ms) {
+      delivered += flush(sink);
+   }
+   return delivered;
+}
+
+static void* consumer_thread(void* arg) {
+   TelemetrySink* sink = arg;
+   uint64_t batch_start = 0;
+   uint64_t window_start = monotonic_ms();
+   uint32_t window_count = 0;
+
+   while (__atomic_load_n(&g_running, __ATOMIC_ACQUIRE)) {
+      window_count += drain(sink, &batch_start);
+
+      uint64_t now = monotonic_ms();
+      if (now - window_start >= 1000) {
+         __atomic_store_n(&g_events_per_sec, (uint32_t)(window_count * 1000 / (now - window_start)), __ATOMIC_RELAXED);
+         window_start = now;
+         window_count = 0;
+      }
+
+      // Sleep until more events arrive, the open batch falls due, or at most a second
+      // so the rate still decays to zero when events stop
+      uint64_t wait_ms = 1000;
+      if (sink->count > 0) {
+         uint64_t due = batch_start + sink->batch_ms;
+         wait_ms = due > now ? due - now : 0;
+      }
+      if (g_retry_ms) {
+         uint64_t due = g_retry_ms > now ? g_retry_ms - now : 0;
+         wait_ms = due < wait_ms ? due : wait_ms;
+      }
+      if (sink->spool[0] && wait_ms > sink->sync_ms) {
+         wait_ms = sink->sync_ms;
+      }
+      pthread_mutex_lock(&g_wake_lock);
+      __atomic_store_n(&g_consumer_waiting, 1, __ATOMIC_RELAXED);
+      __atomic_thread_fence(__ATOMIC_SEQ_CST);
+      if (wait_ms > 0 && !any_ready() && __atomic_load_n(&g_running, __ATOMIC_ACQUIRE)) {
+         struct timespec deadline;
+         clock_gettime(CLOCK_REALTIME, &deadline);
+         deadline.tv_sec += wait_ms / 1000;
+         deadline.tv_nsec += (wait_ms % 1000) * 1000000;
+         if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+         }
+         pthread_cond_timedwait(&g_wake, &g_wake_lock, &deadline);
+      }
+      __atomic_store_n(&g_consumer_waiting, 0, __ATOMIC_RELAXED);
+      pthread_mutex_unlock(&g_wake_lock);
+   }
+
+   drain(sink, &batch_start);
+   flush(sink);
+   // Anything still spooled is replayed on the next start
+   telemetry_sink_close(sink);
+   return NULL;
+}
+
+bool telemetry_start(void) {
+   for (int l = 0; l < LANE_COUNT; l++) {
+      for (uint32_t i = 0; i < g_lanes[l].size; i++) {
+         g_lanes[l].slots[i].seq = i;
+      }
+   }
+   TelemetrySink* sink = telemetry_sink_open();
+   if (!sink) {
+      return false;
+   }
+   __atomic_store_n(&g_running, 1, __ATOMIC_RELEASE);
+   if (pthread_create(&g_consumer, NULL, consumer_thread, sink) != 0) {
+      fprintf(stderr, "Failed to start telemetry consumer\n");
+      __atomic_store_n(&g_running, 0, __ATOMIC_RELEASE);
+      telemetry_sink_close(sink);
+      return false;
+   }
+   g_started = true;
+   return true;
+}
+
+void telemetry_stop(void) {
+   if (!g_started) {
+      return;
+   }
+   pthread_mutex_lock(&g_wake_lock);
+   __atomic_store_n(&g_running, 0, __ATOMIC_RELEASE);
+   pthread_cond_signal(&g_wake);
+   pthread_mutex_unlock(&g_wake_lock);
+   pthread_join(g_consumer, NULL);
+   g_started = false;
+}
+
+rbusError_t get_telemetry_stat(rbusHandle_t handle, rbusProperty_t property, rbusGetHandlerOptions_t* options) {
+   (void)handle; (void)options;
+   const char* name = rbusProperty_GetName(property);
+   const char* stat = strrchr(name, '.') + 1;
+
+   rbusValue_t value;
+   rbusValue_Init(&value);
+   if (strcmp(stat, "EventsPerSecond") == 0) {
+      rbusValue_SetUInt32(value, __atomic_load_n(&g_events_per_sec, __ATOMIC_RELAXED));
+   } else if (strcmp(stat, "Received") == 0) {
+      rbusValue_SetUInt64(value, __atomic_load_n(&g_received, __ATOMIC_RELAXED));
+   } else if (strcmp(stat, "Delivered") == 0) {
+      rbusValue_SetUInt64(value, __atomic_load_n(&g_delivered, __ATOMIC_RELAXED));
+   } else if (strcmp(stat, "Dropped") == 0) {
+      rbusValue_SetUInt64(value, __atomic_load_n(&g_dropped, __ATOMIC_RELAXED));
+   } else if (strcmp(stat, "Spooled") == 0) {
+      rbusValue_SetUInt32(value, telemetry_spool_pending());
+   } else if (strcmp(stat, "QueueDepth") == 0) {
+      uint32_t depth = 0;
+      for (int l = 0; l < LANE_COUNT; l++) {
+         depth += __atomic_load_n(&g_lanes[l].tail, __ATOMIC_RELAXED) - __atomic_load_n(&g_lanes[l].head, __ATOMIC_RELAXED);
+      }
+      rbusValue_SetUInt32(value, depth);
+   } else {
+      rbusValue_Release(value);
+      return RBUS_ERROR_ELEMENT_DOES_NOT_EXIST;
+   }
+   rbusProperty_SetValue(property, value);
+   rbusValue_Release(value);
+   return RBUS_ERROR_SUCCESS;
+}
@@ -0,0 +1,104 @@
+// Compares the Telemetry.Collect() payload validation modes on report-style payloads
+// of increasing size:
+//   copy   - no validation, only the copy into the queue slot
+//   scan   - json_scan() structural check
+//   full   - jansson decode and free
+//   pretty - jansson decode plus indented re-encode (the old per-event stderr dump)
+//
+// usage: telemetry_bench [milliseconds per case]
+#include "rbus_elements.h"
+#include <jansson.h>
+
+static uint64_t monotonic_ns(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// A T2 style report: a flat array of single-parameter objects
+static char* make_report(size_t target) {
+   size_t cap = target + 256;
+   char* buf = malloc(cap);
+   if (!buf) return NULL;
+   size_t len = snprintf(buf, cap,
+      "{\"searchResult\":[{\"Profile\":\"RDKB_Profile\"},{\"Time\":\"2024-05-14 10:21:33\"},"
+      "{\"mac\":\"A0:B1:C2:D3:E4:F5\"},{\"Version\":\"3.1.2-p4\"}");
+   for (int i = 1; len + 128 < target; i++) {
+      len += snprintf(buf + len, cap - len,
+         ",{\"Device.WiFi.Radio.%d.Stats.Noise\":\"-9%d\",\"Device.WiFi.SSID.%d.Stats.ErrorsSent\":%d,\"ok\":true}",
+         i, i % 10, i, i * 37);
+   }
+   snprintf(buf + len, cap - len, "]}");
+   return buf;
+}
+
+typedef bool (*BenchFn)(const char* payload, size_t len);
+
+static char g_slot[TELEMETRY_EVENT_BYTES * 8];
+
+static bool run_copy(const char* payload, size_t len) {
+   memcpy(g_slot, payload, len < sizeof(g_slot) ? len : sizeof(g_slot));
+   return true;
+}
+
+static bool run_scan(const char* payload, size_t len) {
+   return json_scan(payload, len);
+}
+
+static bool run_full(const char* payload, size_t len) {
+   json_error_t error;
+   json_t* obj = json_loadb(payload, len, JSON_DECODE_ANY, &error);
+   json_decref(obj);
+   return obj != NULL;
+}
+
+static bool run_pretty(const char* payload, size_t len) {
+   json_error_t error;
+   json_t* obj = json_loadb(payload, len, JSON_DECODE_ANY, &error);
+   char* pretty = obj ? json_dumps(obj, JSON_INDENT(2)) : NULL;
+   free(pretty);
+   json_decref(obj);
+   return pretty != NULL;
+}
+
+int main(int argc, char* argv[]) {
+   uint64_t budget_ns = (argc > 1 ? strtoull(argv[1], NULL, 10) : 200) * 1000000ull;
+   const size_t sizes[] = {512, 2048, 3584, 16384};
+   const struct {
+      const char* name;
+      BenchFn fn;
+   } modes[] = {
+      {"copy", run_copy},
+      {"scan", run_scan},
+      {"full", run_full},
+      {"pretty", run_pretty},
+   };
+
+   printf("%8s %8s %12s %10s\n", "bytes", "mode", "ns/event", "MB/s");
+   for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+      char* payload = make_report(sizes[s]);
+      if (!payload) return 1;
+      size_t len = strlen(payload);
+
+      for (size_t m = 0; m < sizeof(modes) / sizeof(modes[0]); m++) {
+         if (!modes[m].fn(payload, len)) {
+            fprintf(stderr, "%s rejected the %zu byte payload\n", modes[m].name, len);
+            return 1;
+         }
+         uint64_t iterations = 0;
+         uint64_t start = monotonic_ns(), elapsed;
+         do {
+            for (int i = 0; i < 64; i++) {
+               modes[m].fn(payload, len);
+            }
+            iterations += 64;
+            elapsed = monotonic_ns() - start;
+         } while (elapsed < budget_ns);
+
+         double ns = (double)elapsed / iterations;
+         printf("%8zu %8s %12.0f %10.1f\n", len, modes[m].name, ns, len / ns * 1000.0);
+      }
+      free(payload);
+   }
+   return 0;
+}
@@ -0,0 +1,135 @@
+// Local stand-in for the telemetry cloud endpoint. Accepts the socket sink's
+// newline delimited JSON events and prints the received rate once a second.
+//
+// usage: telemetry_receiver [-v] [socket path]
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#define DEFAULT_SOCKET "/tmp/rbus-telemetry.sock"
+#define MAX_CLIENTS 8
+
+static volatile sig_atomic_t g_stop = 0;
+
+static void signal_handler(int sig) {
+   (void)sig;
+   g_stop = 1;
+}
+
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+int main(int argc, char* argv[]) {
+   bool verbose = false;
+   const char* path = DEFAULT_SOCKET;
+   for (int i = 1; i < argc; i++) {
+      if (strcmp(argv[i], "-v") == 0) {
+         verbose = true;
+      } else {
+         path = argv[i];
+      }
+   }
+
+   signal(SIGINT, signal_handler);
+   signal(SIGTERM, signal_handler);
+
+   struct sockaddr_un addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", path);
+
+   int listener = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (listener < 0) {
+      fprintf(stderr, "socket: %s\n", strerror(errno));
+      return 1;
+   }
+   unlink(path);
+   if (bind(listener, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listener, MAX_CLIENTS) < 0) {
+      fprintf(stderr, "Failed to listen on %s: %s\n", path, strerror(errno));
+      close(listener);
+      return 1;
+   }
+   printf("Listening on %s\n", path);
+
+   struct pollfd fds[MAX_CLIENTS + 1];
+   int nfds = 1;
+   fds[0].fd = listener;
+   fds[0].events = POLLIN;
+
+   static char buf[65536];
+   uint64_t total = 0, window_events = 0, window_bytes = 0;
+   uint64_t window_start = monotonic_ms();
+
+   while (!g_stop) {
+      int n = poll(fds, nfds, 1000);
+      if (n < 0 && errno != EINTR) {
+         fprintf(stderr, "poll: %s\n", strerror(errno));
+         break;
+      }
+
+      if (n > 0 && (fds[0].revents & POLLIN)) {
+         int fd = accept(listener, NULL, NULL);
+         if (fd >= 0 && nfds <= MAX_CLIENTS) {
+            fds[nfds].fd = fd;
+            fds[nfds].events = POLLIN;
+            nfds++;
+            printf("Sender connected\n");
+         } else if (fd >= 0) {
+            close(fd);
+         }
+      }
+
+      for (int i = 1; n > 0 && i < nfds; i++) {
+         if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR))) continue;
+         ssize_t len = read(fds[i].fd, buf, sizeof(buf));
+         if (len <= 0) {
+            if (len < 0 && errno == EINTR) continue;
+            printf("Sender disconnected\n");
+            close(fds[i].fd);
+            fds[i--] = fds[--nfds];
+            continue;
+         }
+         for (ssize_t j = 0; j < len; j++) {
+            if (buf[j] == '\n') window_events++;
+         }
+         window_bytes += len;
+         if (verbose) {
+            fwrite(buf, 1, len, stdout);
+         }
+      }
+
+      uint64_t now = monotonic_ms();
+      if (now - window_start >= 1000) {
+         total += window_events;
+         if (window_events > 0) {
+            printf("%llu events/s, %llu bytes/s, %llu total\n",
+               (unsigned long long)(window_events * 1000 / (now - window_start)),
+               (unsigned long long)(window_bytes * 1000 / (now - window_start)),
+               (unsigned long long)total);
+            fflush(stdout);
+         }
+         window_start = now;
+         window_events = 0;
+         window_bytes = 0;
+      }
+   }
+
+   for (int i = 0; i < nfds; i++) {
+      close(fds[i].fd);
+   }
+   unlink(path);
+   printf("Received %llu events\n", (unsigned long long)(total + window_events));
+   return 0;
+}
@@ -0,0 +1,449 @@
+#include "rbus_elements.h"
+#include <jansson.h>
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+extern rbusHandle_t g_rbusHandle;
+
+// Delivery side of Device.Telemetry.Collect(). The consumer thread appends each queued
+// event to the sink's pending batch and flushes once the batch reaches batchBytes, is
+// batchMs old, or holds a critical event. Sinks only ever run on the consumer thread.
+
+static const char* g_field_names[TELEMETRY_FIELD_COUNT] = {
+   "source", "dest", "content_type", "partner_ids", "headers", "metadata",
+   "session_id", "transaction_uuid", "payload"
+};
+
+static const char* field(const TelemetryEvent* ev, TelemetryField f) {
+   return ev->off[f] == TELEMETRY_FIELD_ABSENT ? NULL : ev->data + ev->off[f];
+}
+
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool out_reserve(TelemetrySink* s, size_t n) {
+   if (s->len + n < s->cap) {
+      return true;
+   }
+   size_t cap = s->cap ? s->cap : 4096;
+   while (cap <= s->len + n) cap *= 2;
+   char* buf = realloc(s->buf, cap);
+   if (!buf) {
+      return false;
+   }
+   s->buf = buf;
+   s->cap = cap;
+   return true;
+}
+
+static bool out_printf(TelemetrySink* s, const char* fmt, ...) __attribute__((format(printf, 2, 3)));
+static bool out_printf(TelemetrySink* s, const char* fmt, ...) {
+   va_list ap;
+   va_start(ap, fmt);
+   int n = vsnprintf(NULL, 0, fmt, ap);
+   va_end(ap);
+   if (n < 0 || !out_reserve(s, n + 1)) {
+      return false;
+   }
+   va_start(ap, fmt);
+   vsnprintf(s->buf + s->len, s->cap - s->len, fmt, ap);
+   va_end(ap);
+   s->len += n;
+   return true;
+}
+
+static bool out_json_string(TelemetrySink* s, const char* str) {
+   // Worst case every byte becomes a \u00XX escape
+   if (!out_reserve(s, strlen(str) * 6 + 3)) {
+      return false;
+   }
+   char* p = s->buf + s->len;
+   *p++ = '"';
+   for (const unsigned char* c = (const unsigned char*)str; *c; c++) {
+      if (*c == '"' || *c == '\\') {
+         *p++ = '\\';
+         *p++ = *c;
+      } else if (*c == '\n') {
+         *p++ = '\\';
+         *p++ = 'n';
+      } else if (*c < 0x20) {
+         p += sprintf(p, "\\u%04x", *c);
+      } else {
+         *p++ = *c;
+      }
+   }
+   *p++ = '"';
+   s->len = p - s->buf;
+   return true;
+}
+
+// A validated payload is forwarded as is. Raw line breaks in valid JSON can only be
+// whitespace, so they become spaces to keep one event per line.
+static bool out_raw_json(TelemetrySink* s, const char* json) {
+   size_t n = strlen(json);
+   if (!out_reserve(s, n + 1)) {
+      return false;
+   }
+   char* dst = s->buf + s->len;
+   memcpy(dst, json, n);
+   for (char* p = dst; (p = memchr(p, '\n', dst + n - p)); p++) *p = ' ';
+   for (char* p = dst; (p = memchr(p, '\r', dst + n - p)); p++) *p = ' ';
+   s->len += n;
+   return true;
+}
+
+static bool write_all(int fd, const char* buf, size_t len, bool sock) {
+   while (len > 0) {
+      ssize_t n = sock ? send(fd, buf, len, MSG_NOSIGNAL) : write(fd, buf, len);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) return false;
+      buf += n;
+      len -= n;
+   }
+   return true;
+}
+
+// log: the human readable dump to stderr that Collect() has always produced
+static bool log_append(TelemetrySink* s, const TelemetryEvent* ev) {
+   bool ok = out_printf(s, "\nEvent Received:\n") &&
+      out_printf(s, "  msg_type: %s\n", ev->simple_event ? "event" : "4");
+   for (int f = TELEMETRY_SOURCE; ok && f < TELEMETRY_PAYLOAD; f++) {
+      const char* str = field(ev, f);
+      if (!str) continue;
+      if (f == TELEMETRY_PARTNER_IDS || f == TELEMETRY_HEADERS) {
+         ok = out_printf(s, "  %s: [%s]\n", g_field_names[f], str);
+      } else if (f == TELEMETRY_METADATA) {
+         ok = out_printf(s, "  %s: {%s}\n", g_field_names[f], str);
+      } else {
+         ok = out_printf(s, "  %s: %s\n", g_field_names[f], str);
+      }
+   }
+   if (ok && ev->has_qos) {
+      if (ev->qos >= 0 && ev->qos <= 99) {
+         ok = out_printf(s, "  qos: %d\n", ev->qos);
+      } else {
+         ok = out_printf(s, "  qos: %d (invalid, must be 0-99)\n", ev->qos);
+      }
+   }
+   if (ok && ev->has_rdr) {
+      ok = out_printf(s, "  rdr: %d\n", ev->rdr);
+   }
+
+   const char* payload = field(ev, TELEMETRY_PAYLOAD);
+   if (ok && payload && !s->verbose) {
+      ok = out_printf(s, "  payload: %s\n\n", payload);
+   } else if (ok && payload) {
+      json_error_t error;
+      json_t* obj = json_loads(payload, 0, &error);
+      char* pretty = obj ? json_dumps(obj, JSON_INDENT(2)) : NULL;
+      if (pretty) {
+         ok = out_printf(s, "payload:\n%s\n\n", pretty);
+      } else {
+         ok = out_printf(s, "  payload: %s\n\n", payload);
+      }
+      free(pretty);
+      json_decref(obj);
+   }
+   return ok;
+}
+
+static bool log_flush(TelemetrySink* s) {
+   return fwrite(s->buf, 1, s->len, stderr) == s->len;
+}
+
+// file and socket: one JSON object per line
+static bool json_line_append(TelemetrySink* s, const TelemetryEvent* ev) {
+   size_t start = s->len;
+   bool ok = out_printf(s, "{\"msg_type\":%s", ev->simple_event ? "\"event\"" : "4");
+   for (int f = 0; ok && f < TELEMETRY_FIELD_COUNT; f++) {
+      const char* str = field(ev, f);
+      if (!str) continue;
+      ok = out_printf(s, ",\"%s\":", g_field_names[f]);
+      if (ok && f == TELEMETRY_PAYLOAD && ev->payload_json) {
+         ok = out_raw_json(s, str);
+      } else if (ok) {
+         ok = out_json_string(s, str);
+      }
+   }
+   if (ok && ev->has_qos) ok = out_printf(s, ",\"qos\":%d", ev->qos);
+   if (ok && ev->has_rdr) ok = out_printf(s, ",\"rdr\":%d", ev->rdr);
+   if (ok) ok = out_printf(s, "}\n");
+   if (!ok) {
+      s->len = start;
+   }
+   return ok;
+}
+
+static bool file_open(TelemetrySink* s) {
+   s->fd = open(s->path, O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644);
+   if (s->fd < 0) {
+      fprintf(stderr, "Failed to open telemetry file %s: %s\n", s->path, strerror(errno));
+      return false;
+   }
+   return true;
+}
+
+static bool file_flush(TelemetrySink* s) {
+   return write_all(s->fd, s->buf, s->len, false);
+}
+
+static void fd_close(TelemetrySink* s) {
+   if (s->fd >= 0) {
+      close(s->fd);
+      s->fd = -1;
+   }
+}
+
+// The receiver may start after us or restart, so connect lazily and retry at most once a second
+static bool socket_connect(TelemetrySink* s) {
+   uint64_t now = monotonic_ms();
+   if (s->retry_ms && now < s->retry_ms) {
+      return false;
+   }
+   s->retry_ms = now + 1000;
+
+   struct sockaddr_un addr;
+   memset(&addr, 0, sizeof(addr));
+   addr.sun_family = AF_UNIX;
+   snprintf(addr.sun_path, sizeof(addr.sun_path), "%s", s->path);
+
+   s->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+   if (s->fd < 0) {
+      return false;
+   }
+   if (connect(s->fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+      fd_close(s);
+      return false;
+   }
+   s->retry_ms = 0;
+   return true;
+}
+
+static bool socket_open(TelemetrySink* s) {
+   if (!socket_connect(s)) {
+      fprintf(stderr, "Telemetry receiver %s not available yet, will retry\n", s->path);
+   }
+   return true;
+}
+
+static bool socket_flush(TelemetrySink* s) {
+   if (s->fd < 0 && !socket_connect(s)) {
+      return false;
+   }
+   if (!write_all(s->fd, s->buf, s->len, true)) {
+      fprintf(stderr, "Lost telemetry receiver %s: %s\n", s->path, strerror(errno));
+      fd_close(s);
+      return false;
+   }
+   return true;
+}
+
+// rbus: each batch is republished as one TELEMETRY_BATCH_EVENT
+static void set_string(rbusObject_t obj, const char* name, const char* str) {
+   rbusValue_t val = rbusValue_InitString(str);
+   rbusObject_SetValue(obj, name, val);
+   rbusValue_Release(val);
+}
+
+static void set_int(rbusObject_t obj, const char* name, int32_t i) {
+   rbusValue_t val = rbusValue_InitInt32(i);
+   rbusObject_SetValue(obj, name, val);
+   rbusValue_Release(val);
+}
+
+static bool republish_append(TelemetrySink* s, const TelemetryEvent* ev) {
+   if (!s->batch) {
+      rbusObject_Init(&s->batch, NULL);
+   }
+   rbusObject_t obj;
+   rbusObject_Init(&obj, NULL);
+   set_string(obj, "msg_type", ev->simple_event ? "event" : "4");
+   for (int f = 0; f < TELEMETRY_FIELD_COUNT; f++) {
+      const char* str = field(ev, f);
+      if (str) set_string(obj, g_field_names[f], str);
+   }
+   if (ev->has_qos) set_int(obj, "qos", ev->qos);
+   if (ev->has_rdr) set_int(obj, "rdr", ev->rdr);
+
+   char key[16];
+   snprintf(key, sizeof(key), "%u", s->count + 1);
+   rbusValue_t val;
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, obj);
+   rbusObject_SetValue(s->batch, key, val);
+   rbusValue_Release(val);
+   rbusObject_Release(obj);
+   // Only drives the size trigger
+   s->len += ev->len;
+   return true;
+}
+
+static bool republish_flush(TelemetrySink* s) {
+   rbusObject_t data;
+   rbusObject_Init(&data, NULL);
+
+   rbusValue_t val = rbusValue_InitUInt32(s->count);
+   rbusObject_SetValue(data, "Count", val);
+   rbusValue_Release(val);
+
+   rbusValue_Init(&val);
+   rbusValue_SetObject(val, s->batch);
+   rbusObject_SetValue(data, "Events", val);
+   rbusValue_Release(val);
+
+   rbusEvent_t event = {.name = TELEMETRY_BATCH_EVENT, .type = RBUS_EVENT_GENERAL, .data = data};
+   rbusError_t rc = rbusEvent_Publish(g_rbusHandle, &event);
+   rbusObject_Release(data);
+   rbusObject_Release(s->batch);
+   s->batch = NULL;
+   if (rc != RBUS_ERROR_SUCCESS && rc != RBUS_ERROR_NOSUBSCRIBERS) {
+      fprintf(stderr, "Failed to publish telemetry batch: %d\n", rc);
+      return false;
+   }
+   return true;
+}
+
+static void republish_close(TelemetrySink* s) {
+   if (s->batch) {
+      rbusObject_Release(s->batch);
+      s->batch = NULL;
+   }
+}
+
+static const TelemetrySinkOps g_sink_ops[] = {
+   {"log", NULL, log_append, log_flush, NULL},
+   {"file", file_open, json_line_append, file_flush, fd_close},
+   {"socket", socket_open, json_line_append, socket_flush, fd_close},
+   {"rbus", NULL, republish_append, republish_flush, republish_close},
+};
+
+static TelemetrySink g_sink = {
+   .ops = &g_sink_ops[0],
+   .batch_bytes = TELEMETRY_BATCH_BYTES,
+   .batch_ms = TELEMETRY_BATCH_MS,
+   .sync_ms = TELEMETRY_SPOOL_SYNC_MS,
+   .fd = -1,
+};
+static bool g_sink_configured = false;
+
+bool telemetry_sink_add_rule(cJSON* item, int index) {
+   cJSON* sink_obj = cJSON_GetObjectItem(item, "sink");
+   cJSON* path_obj = cJSON_GetObjectItem(item, "path");
+   cJSON* bytes_obj = cJSON_GetObjectItem(item, "batchBytes");
+   cJSON* ms_obj = cJSON_GetObjectItem(item, "batchMs");
+   cJSON* spool_obj = cJSON_GetObjectItem(item, "spool");
+   cJSON* sync_obj = cJSON_GetObjectItem(item, "syncMs");
+   cJSON* validate_obj = cJSON_GetObjectItem(item, "validatePayload");
+   cJSON* verbose_obj = cJSON_GetObjectItem(item, "verbose");
+
+   if (g_sink_configured) {
+      fprintf(stderr, "Telemetry sink item %d: only one sink can be configured\n", index);
+      return false;
+   }
+   const char* kind = cJSON_GetStringValue(sink_obj);
+   const TelemetrySinkOps* ops = NULL;
+   for (size_t i = 0; kind && i < sizeof(g_sink_ops) / sizeof(g_sink_ops[0]); i++) {
+      if (strcmp(kind, g_sink_ops[i].kind) == 0) {
+         ops = &g_sink_ops[i];
+      }
+   }
+   if (!ops) {
+      fprintf(stderr, "Telemetry sink item %d: sink must be log, file, socket or rbus\n", index);
+      return false;
+   }
+   const char* validate = cJSON_GetStringValue(validate_obj);
+   TelemetryValidate mode = TELEMETRY_VALIDATE_NONE;
+   if (validate && strcmp(validate, "scan") == 0) {
+      mode = TELEMETRY_VALIDATE_SCAN;
+   } else if (validate && strcmp(validate, "full") == 0) {
+      mode = TELEMETRY_VALIDATE_FULL;
+   } else if (validate && strcmp(validate, "none") != 0) {
+      fprintf(stderr, "Telemetry sink item %d: validatePayload must be none, scan or full\n", index);
+      return false;
+   }
+   if ((ops->flush == file_flush || ops->flush == socket_flush) && !cJSON_IsString(path_obj)) {
+      fprintf(stderr, "Telemetry sink item %d: %s sink needs a path\n", index, kind);
+      return false;
+   }
+
+   g_sink.ops = ops;
+   g_sink.validate = mode;
+   g_sink.verbose = cJSON_IsTrue(verbose_obj);
+   if (cJSON_IsString(path_obj)) {
+      snprintf(g_sink.path, sizeof(g_sink.path), "%s", cJSON_GetStringValue(path_obj));
+   }
+   if (cJSON_IsNumber(bytes_obj) && bytes_obj->valuedouble >= 0) {
+      g_sink.batch_bytes = (size_t)bytes_obj->valuedouble;
+   }
+   if (cJSON_IsNumber(ms_obj) && ms_obj->valuedouble >= 0) {
+      g_sink.batch_ms = (uint32_t)ms_obj->valuedouble;
+   }
+   if (cJSON_IsString(spool_obj)) {
+      snprintf(g_sink.spool, sizeof(g_sink.spool), "%s", cJSON_GetStringValue(spool_obj));
+   }
+   if (cJSON_IsNumber(sync_obj) && sync_obj->valuedouble >= 0) {
+      g_sink.sync_ms = (uint32_t)sync_obj->valuedouble;
+   }
+   g_sink_configured = true;
+   return true;
+}
+
+// Runs on the Collect() caller's thread; is_json reports whether the payload may be
+// forwarded as raw JSON
+bool telemetry_payload_check(const char* payload, size_t len, bool* is_json) {
+   *is_json = false;
+   if (g_sink.validate == TELEMETRY_VALIDATE_SCAN) {
+      *is_json = json_scan(payload, len);
+   } else if (g_sink.validate == TELEMETRY_VALIDATE_FULL) {
+      json_error_t error;
+      json_t* obj = json_loadb(payload, len, JSON_DECODE_ANY, &error);
+      *is_json = obj != NULL;
+      json_decref(obj);
+   } else {
+      return true;
+   }
+   return *is_json;
+}
+
+TelemetrySink* telemetry_sink_open(void) {
+   if (g_sink.spool[0] && !telemetry_spool_open(g_sink.spool, g_sink.sync_ms)) {
+      return NULL;
+   }
+   if (g_sink.ops->open && !g_sink.ops->open(&g_sink)) {
+      if (g_sink.spool[0]) telemetry_spool_close();
+      return NULL;
+   }
+   return &g_sink;
+}
+
+bool telemetry_sink_append(TelemetrySink* s, const TelemetryEvent* ev) {
+   if (!s->ops->append(s, ev)) {
+      return false;
+   }
+   s->count++;
+   return true;
+}
+
+bool telemetry_sink_flush(TelemetrySink* s) {
+   bool ok = s->count == 0 || s->ops->flush(s);
+   s->len = 0;
+   s->count = 0;
+   return ok;
+}
+
+void telemetry_sink_close(TelemetrySink* s) {
+   if (s->ops->close) {
+      s->ops->close(s);
+   }
+   if (s->spool[0]) {
+      telemetry_spool_close();
+   }
+   free(s->buf);
+   s->buf = NULL;
+   s->len = s->cap = 0;
+   s->count = 0;
+}
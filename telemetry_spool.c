@@ -0,0 +1,417 @@
+#include "rbus_elements.h"
+#include <dirent.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Crash-safe spool between the telemetry ring and the sink. Events are appended to
+// fixed-size segment files mapped into memory and the sink is fed from the spool, so
+// nothing is lost while the sink is unreachable or across a restart. Each record
+// carries a CRC, so a record torn by power loss ends its segment instead of corrupting
+// replay. A segment header keeps the offset up to which the sink has acknowledged its
+// records, and segments acknowledged to the end are deleted. Only the telemetry
+// consumer thread touches the spool.
+
+#define SPOOL_MAGIC 0x53544252 // "RBTS"
+#define SPOOL_VERSION 2
+#define SPOOL_ALIGN 8
+
+typedef struct {
+   uint32_t magic;
+   uint32_t version;
+   uint32_t id;
+   uint32_t acked;   // offset of the first unacknowledged record
+} SpoolHeader;
+
+typedef struct {
+   uint32_t len;     // whole record padded to SPOOL_ALIGN, 0 ends the segment
+   uint32_t crc;     // over everything after this field
+   uint8_t flags;
+   uint8_t reserved;
+   uint16_t reserved2;
+   uint32_t data_len;
+   int32_t qos;
+   int32_t rdr;
+   uint32_t off[TELEMETRY_FIELD_COUNT];
+} SpoolRecord;
+
+enum { REC_SIMPLE_EVENT = 1, REC_HAS_QOS = 2, REC_HAS_RDR = 4, REC_PAYLOAD_JSON = 8 };
+
+typedef struct {
+   uint32_t id;
+   int fd;
+   uint8_t* base;
+} SpoolSegment;
+
+typedef struct {
+   uint32_t id;
+   uint32_t off;
+} SpoolCursor;
+
+static char g_dir[MAX_NAME_LEN];
+static int g_dir_fd = -1;
+static SpoolSegment g_segs[TELEMETRY_SPOOL_SEGMENTS];
+// acknowledged <= sent <= written
+static SpoolCursor g_ack, g_send, g_write;
+static uint32_t g_send_len = 0;  // length of the record last returned by peek
+static uint32_t g_inflight = 0;  // records sent since the last ack
+static uint32_t g_pending = 0;   // records not yet acknowledged
+static uint32_t g_synced = 0;    // write offset already on storage
+static bool g_ack_dirty = false;
+static bool g_dir_dirty = false;
+static uint32_t g_sync_ms = TELEMETRY_SPOOL_SYNC_MS;
+static uint64_t g_last_sync_ms = 0;
+static TelemetryEvent g_scratch;
+static uint32_t g_crc_table[256];
+
+static uint64_t monotonic_ms(void) {
+   struct timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint32_t crc32(const uint8_t* p, size_t n) {
+   uint32_t c = 0xFFFFFFFF;
+   while (n--) {
+      c = g_crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+   }
+   return ~c;
+}
+
+static SpoolSegment* segment(uint32_t id) {
+   SpoolSegment* seg = &g_segs[id % TELEMETRY_SPOOL_SEGMENTS];
+   return seg->base && seg->id == id ? seg : NULL;
+}
+
+static SpoolHeader* header(const SpoolSegment* seg) {
+   return (SpoolHeader*)seg->base;
+}
+
+static SpoolSegment* map_segment(uint32_t id, bool create) {
+   SpoolSegment* seg = &g_segs[id % TELEMETRY_SPOOL_SEGMENTS];
+   if (seg->base) {
+      return NULL;
+   }
+   char path[MAX_NAME_LEN * 2];
+   snprintf(path, sizeof(path), "%s/%010u.seg", g_dir, id);
+
+   int fd = open(path, O_RDWR | O_CLOEXEC | (create ? O_CREAT | O_EXCL : 0), 0644);
+   if (fd < 0) {
+      fprintf(stderr, "Failed to open telemetry spool segment %s: %s\n", path, strerror(errno));
+      return NULL;
+   }
+   struct stat st;
+   if (create ? ftruncate(fd, TELEMETRY_SPOOL_SEGMENT_BYTES) < 0 :
+         fstat(fd, &st) < 0 || st.st_size != TELEMETRY_SPOOL_SEGMENT_BYTES) {
+      fprintf(stderr, "Telemetry spool segment %s has the wrong size\n", path);
+      close(fd);
+      return NULL;
+   }
+   void* base = mmap(NULL, TELEMETRY_SPOOL_SEGMENT_BYTES, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   if (base == MAP_FAILED) {
+      fprintf(stderr, "Failed to map telemetry spool segment %s: %s\n", path, strerror(errno));
+      close(fd);
+      return NULL;
+   }
+
+   seg->id = id;
+   seg->fd = fd;
+   seg->base = base;
+   SpoolHeader* h = header(seg);
+   if (create) {
+      h->magic = SPOOL_MAGIC;
+      h->version = SPOOL_VERSION;
+      h->id = id;
+      h->acked = sizeof(SpoolHeader);
+      g_dir_dirty = true;
+   } else if (h->magic != SPOOL_MAGIC || h->version != SPOOL_VERSION || h->id != id ||
+         h->acked < sizeof(SpoolHeader) || h->acked > TELEMETRY_SPOOL_SEGMENT_BYTES) {
+      fprintf(stderr, "Ignoring corrupt telemetry spool segment %s\n", path);
+      munmap(base, TELEMETRY_SPOOL_SEGMENT_BYTES);
+      close(fd);
+      seg->base = NULL;
+      return NULL;
+   }
+   return seg;
+}
+
+static void unmap_segment(SpoolSegment* seg, bool remove) {
+   if (remove) {
+      char path[MAX_NAME_LEN * 2];
+      snprintf(path, sizeof(path), "%s/%010u.seg", g_dir, seg->id);
+      unlink(path);
+      g_dir_dirty = true;
+   }
+   munmap(seg->base, TELEMETRY_SPOOL_SEGMENT_BYTES);
+   close(seg->fd);
+   seg->base = NULL;
+}
+
+// The record at off, or NULL at the end of the segment or at a torn record
+static const SpoolRecord* record_at(const SpoolSegment* seg, uint32_t off) {
+   if (off + sizeof(SpoolRecord) > TELEMETRY_SPOOL_SEGMENT_BYTES) {
+      return NULL;
+   }
+   const SpoolRecord* rec = (const SpoolRecord*)(seg->base + off);
+   uint32_t len = rec->len;
+   if (len < sizeof(SpoolRecord) || len % SPOOL_ALIGN || len > TELEMETRY_SPOOL_SEGMENT_BYTES - off ||
+         sizeof(SpoolRecord) + rec->data_len > len) {
+      return NULL;
+   }
+   const uint8_t* body = (const uint8_t*)rec + offsetof(SpoolRecord, flags);
+   if (crc32(body, sizeof(SpoolRecord) - offsetof(SpoolRecord, flags) + rec->data_len) != rec->crc) {
+      return NULL;
+   }
+   return rec;
+}
+
+static uint32_t segment_start(const SpoolSegment* seg) {
+   return header(seg)->acked;
+}
+
+static void sync_written(SpoolSegment* seg) {
+   long page = sysconf(_SC_PAGESIZE);
+   uint32_t from = g_synced & ~(uint32_t)(page - 1);
+   if (g_write.off > from) {
+      msync(seg->base + from, g_write.off - from, MS_SYNC);
+   }
+   g_synced = g_write.off;
+}
+
+static bool scan(const char* dir, uint32_t** ids, int* count) {
+   DIR* d = opendir(dir);
+   if (!d) {
+      return false;
+   }
+   struct dirent* de;
+   while ((de = readdir(d))) {
+      uint32_t id;
+      char suffix[8];
+      if (sscanf(de->d_name, "%10u.%7s", &id, suffix) != 2 || strcmp(suffix, "seg") != 0) {
+         continue;
+      }
+      uint32_t* grown = realloc(*ids, (*count + 1) * sizeof(uint32_t));
+      if (!grown) {
+         closedir(d);
+         return false;
+      }
+      *ids = grown;
+      (*ids)[(*count)++] = id;
+   }
+   closedir(d);
+   return true;
+}
+
+static int compare_ids(const void* a, const void* b) {
+   uint32_t x = *(const uint32_t*)a, y = *(const uint32_t*)b;
+   return x < y ? -1 : x > y;
+}
+
+bool telemetry_spool_open(const char* dir, uint32_t sync_ms) {
+   for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+      for (int k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+      g_crc_table[i] = c;
+   }
+   snprintf(g_dir, sizeof(g_dir), "%s", dir);
+   g_sync_ms = sync_ms;
+   if (mkdir(g_dir, 0755) < 0 && errno != EEXIST) {
+      fprintf(stderr, "Failed to create telemetry spool %s: %s\n", g_dir, strerror(errno));
+      return false;
+   }
+   g_dir_fd = open(g_dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+   uint32_t* ids = NULL;
+   int count = 0;
+   if (g_dir_fd < 0 || !scan(g_dir, &ids, &count)) {
+      fprintf(stderr, "Failed to read telemetry spool %s: %s\n", g_dir, strerror(errno));
+      free(ids);
+      return false;
+   }
+   qsort(ids, count, sizeof(uint32_t), compare_ids);
+
+   // Segments left by the previous run are replayed from their acknowledged offset on
+   int mapped = 0;
+   for (int i = 0; i < count; i++) {
+      if (count - i > TELEMETRY_SPOOL_SEGMENTS) {
+         fprintf(stderr, "Telemetry spool %s holds too many segments, discarding %010u\n", g_dir, ids[i]);
+         char path[MAX_NAME_LEN * 2];
+         snprintf(path, sizeof(path), "%s/%010u.seg", g_dir, ids[i]);
+         unlink(path);
+         continue;
+      }
+      SpoolSegment* seg = map_segment(ids[i], false);
+      if (!seg) {
+         continue;
+      }
+      if (mapped++ == 0) {
+         g_ack.id = seg->id;
+         g_ack.off = segment_start(seg);
+      }
+      g_write.id = seg->id;
+      g_write.off = segment_start(seg);
+      const SpoolRecord* rec;
+      while ((rec = record_at(seg, g_write.off))) {
+         g_write.off += rec->len;
+         g_pending++;
+      }
+   }
+   free(ids);
+
+   if (mapped == 0) {
+      SpoolSegment* seg = map_segment(1, true);
+      if (!seg) {
+         return false;
+      }
+      g_ack.id = g_write.id = seg->id;
+      g_ack.off = g_write.off = segment_start(seg);
+   }
+   g_send = g_ack;
+   g_synced = g_write.off;
+   g_last_sync_ms = monotonic_ms();
+   if (g_pending) {
+      fprintf(stderr, "Replaying %u spooled telemetry events\n", g_pending);
+   }
+   return true;
+}
+
+bool telemetry_spool_append(const TelemetryEvent* ev) {
+   uint32_t len = (sizeof(SpoolRecord) + ev->len + SPOOL_ALIGN - 1) & ~(uint32_t)(SPOOL_ALIGN - 1);
+   SpoolSegment* seg = segment(g_write.id);
+
+   if (g_write.off + len > TELEMETRY_SPOOL_SEGMENT_BYTES) {
+      // Full: the spool keeps what it has and the newest event is dropped, as with the ring
+      if (g_write.id + 1 - g_ack.id >= TELEMETRY_SPOOL_SEGMENTS) {
+         return false;
+      }
+      SpoolSegment* next = map_segment(g_write.id + 1, true);
+      if (!next) {
+         return false;
+      }
+      sync_written(seg);
+      seg = next;
+      g_write.id = seg->id;
+      g_write.off = g_synced = segment_start(seg);
+   }
+
+   SpoolRecord* rec = (SpoolRecord*)(seg->base + g_write.off);
+   rec->flags = (ev->simple_event ? REC_SIMPLE_EVENT : 0) | (ev->has_qos ? REC_HAS_QOS : 0) | (ev->has_rdr ? REC_HAS_RDR : 0) |
+      (ev->payload_json ? REC_PAYLOAD_JSON : 0);
+   rec->reserved = 0;
+   rec->reserved2 = 0;
+   rec->data_len = ev->len;
+   rec->qos = ev->qos;
+   rec->rdr = ev->rdr;
+   memcpy(rec->off, ev->off, sizeof(rec->off));
+   memcpy(rec + 1, ev->data, ev->len);
+   rec->crc = crc32((const uint8_t*)rec + offsetof(SpoolRecord, flags), sizeof(SpoolRecord) - offsetof(SpoolRecord, flags) + ev->len);
+   // Written last so a partial record never looks complete
+   rec->len = len;
+
+   g_write.off += len;
+   __atomic_store_n(&g_pending, g_pending + 1, __ATOMIC_RELAXED);
+   return true;
+}
+
+const TelemetryEvent* telemetry_spool_peek(void) {
+   for (;;) {
+      SpoolSegment* seg = segment(g_send.id);
+      bool at_end = g_send.id == g_write.id && g_send.off >= g_write.off;
+      const SpoolRecord* rec = seg && !at_end ? record_at(seg, g_send.off) : NULL;
+      if (rec) {
+         TelemetryEvent* ev = &g_scratch;
+         ev->valid = true;
+         ev->simple_event = rec->flags & REC_SIMPLE_EVENT;
+         ev->has_qos = rec->flags & REC_HAS_QOS;
+         ev->has_rdr = rec->flags & REC_HAS_RDR;
+         ev->payload_json = rec->flags & REC_PAYLOAD_JSON;
+         ev->qos = rec->qos;
+         ev->rdr = rec->rdr;
+         memcpy(ev->off, rec->off, sizeof(ev->off));
+         ev->len = 0;
+         if (!telemetry_reserve(ev, rec->data_len)) {
+            return NULL;
+         }
+         ev->len = rec->data_len;
+         memcpy(ev->data, rec + 1, rec->data_len);
+         g_send_len = rec->len;
+         return ev;
+      }
+      if (g_send.id == g_write.id) {
+         return NULL;
+      }
+      // Rest of this segment is empty or torn, continue with the next one
+      g_send.id++;
+      seg = segment(g_send.id);
+      g_send.off = seg ? segment_start(seg) : 0;
+   }
+}
+
+void telemetry_spool_next(void) {
+   g_send.off += g_send_len;
+   g_send_len = 0;
+   g_inflight++;
+}
+
+void telemetry_spool_ack(void) {
+   // Everything before the send cursor's segment is now delivered
+   for (uint32_t id = g_ack.id; id != g_send.id; id++) {
+      SpoolSegment* seg = segment(id);
+      if (seg) {
+         unmap_segment(seg, true);
+      }
+   }
+   g_ack = g_send;
+   SpoolSegment* seg = segment(g_ack.id);
+   if (seg) {
+      header(seg)->acked = g_ack.off;
+      g_ack_dirty = true;
+   }
+   __atomic_store_n(&g_pending, g_pending - g_inflight, __ATOMIC_RELAXED);
+   g_inflight = 0;
+}
+
+void telemetry_spool_rewind(void) {
+   g_send = g_ack;
+   g_send_len = 0;
+   g_inflight = 0;
+}
+
+// Written records and acknowledgements reach storage in one batch every sync_ms
+void telemetry_spool_sync(bool force) {
+   uint64_t now = monotonic_ms();
+   if (!force && now - g_last_sync_ms < g_sync_ms) {
+      return;
+   }
+   g_last_sync_ms = now;
+
+   SpoolSegment* seg = segment(g_write.id);
+   if (seg && g_write.off > g_synced) {
+      sync_written(seg);
+   }
+   seg = segment(g_ack.id);
+   if (seg && g_ack_dirty) {
+      msync(seg->base, sizeof(SpoolHeader), MS_SYNC);
+      g_ack_dirty = false;
+   }
+   if (g_dir_dirty && g_dir_fd >= 0) {
+      fdatasync(g_dir_fd);
+      g_dir_dirty = false;
+   }
+}
+
+uint32_t telemetry_spool_pending(void) {
+   return __atomic_load_n(&g_pending, __ATOMIC_RELAXED);
+}
+
+void telemetry_spool_close(void) {
+   telemetry_spool_sync(true);
+   telemetry_release_spill(&g_scratch);
+   for (int i = 0; i < TELEMETRY_SPOOL_SEGMENTS; i++) {
+      if (g_segs[i].base) {
+         unmap_segment(&g_segs[i], false);
+      }
+   }
+   if (g_dir_fd >= 0) {
+      close(g_dir_fd);
+      g_dir_fd = -1;
+   }
+}
@@ -0,0 +1,211 @@
+// Feeds rtnetlink notifications to netlink_monitor through a socketpair in place of
+// the kernel socket and checks they reach the listeners of the right groups, and that
+// link changes make device_info.c read the primary interface MAC again.
+#include "rbus_elements.h"
+#include <stdarg.h>
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+typedef struct {
+   int calls;
+   int lost;         // callbacks with nh == NULL
+   uint16_t last_type;
+} ListenerLog;
+
+static ListenerLog g_link;
+static ListenerLog g_addr;
+static volatile sig_atomic_t g_running = 0;
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+   do {                                                                 \
+      if (!(cond)) {                                                    \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         g_failures++;                                                  \
+      }                                                                 \
+   } while (0)
+
+// The primary interface as device_info.c sees it through ioctl
+static unsigned char g_iface_hwaddr[6] = {0x02, 0x00, 0x00, 0x00, 0x00, 0x01};
+static int g_hwaddr_reads = 0;
+
+int ioctl(int fd, unsigned long request, ...) {
+   (void)fd;
+   va_list ap;
+   va_start(ap, request);
+   void* arg = va_arg(ap, void*);
+   va_end(ap);
+   switch (request) {
+      case SIOCGIFCONF: {
+         struct ifconf* ifc = arg;
+         if (ifc->ifc_len < (int)sizeof(struct ifreq)) return -1;
+         memset(ifc->ifc_req, 0, sizeof(struct ifreq));
+         snprintf(ifc->ifc_req->ifr_name, IFNAMSIZ, "eth0");
+         ifc->ifc_len = sizeof(struct ifreq);
+         return 0;
+      }
+      case SIOCGIFFLAGS:
+         ((struct ifreq*)arg)->ifr_flags = IFF_UP;
+         return 0;
+      case SIOCGIFHWADDR:
+         g_hwaddr_reads++;
+         memcpy(((struct ifreq*)arg)->ifr_hwaddr.sa_data, g_iface_hwaddr, 6);
+         return 0;
+      default:
+         return -1;
+   }
+}
+
+// device_info.c needs these only for properties this test does not read
+int file_watch_add(const char* path, FileWatchCb cb, void* ctx) {
+   (void)path; (void)cb; (void)ctx;
+   return 0;
+}
+bool ip_cache_get(const char* name, char* out, size_t outlen) {
+   (void)name; (void)out; (void)outlen;
+   return false;
+}
+rbusError_t set_session_end(rbusHandle_t handle, const rbusSetHandlerOptions_t* options, rbusError_t rc) {
+   (void)handle; (void)options;
+   return rc;
+}
+
+static bool primary_mac_is(unsigned char last) {
+   unsigned char mac[6];
+   return device_primary_mac(mac) && mac[0] == 0x02 && mac[5] == last;
+}
+
+static void record(const struct nlmsghdr* nh, void* ctx) {
+   ListenerLog* log = ctx;
+   log->calls++;
+   if (nh) {
+      log->last_type = nh->nlmsg_type;
+   } else {
+      log->lost++;
+   }
+}
+
+static void stop_loop(void* ctx) {
+   (void)ctx;
+   g_running = 0;
+}
+
+// One pass of the event loop: dispatches whatever is readable, then the stop timer ends it
+static void run_once(void) {
+   g_running = 1;
+   event_loop_run(&g_running);
+}
+
+static void reset_logs(void) {
+   memset(&g_link, 0, sizeof(g_link));
+   memset(&g_addr, 0, sizeof(g_addr));
+}
+
+// Appends one header-only message of the given type at *off and advances it
+static void put_message(char* buf, size_t* off, uint16_t type, size_t payload) {
+   struct nlmsghdr* nh = (struct nlmsghdr*)(buf + *off);
+   memset(nh, 0, NLMSG_SPACE(payload));
+   nh->nlmsg_len = NLMSG_LENGTH(payload);
+   nh->nlmsg_type = type;
+   *off += NLMSG_SPACE(payload);
+}
+
+static void send_messages(int fd, const uint16_t* types, int count) {
+   char buf[1024] __attribute__((aligned(NLMSG_ALIGNTO)));
+   size_t off = 0;
+   for (int i = 0; i < count; i++) {
+      size_t payload = (types[i] == RTM_NEWLINK || types[i] == RTM_DELLINK) ? sizeof(struct ifinfomsg) : sizeof(struct ifaddrmsg);
+      put_message(buf, &off, types[i], payload);
+   }
+   CHECK(send(fd, buf, off, 0) == (ssize_t)off);
+}
+
+int main(void) {
+   CHECK(netlink_add_listener(RTMGRP_LINK, record, &g_link) >= 0);
+   CHECK(netlink_add_listener(RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR, record, &g_addr) >= 0);
+   CHECK(event_loop_add_timer(10, stop_loop, NULL) >= 0);
+   device_info_init();
+
+   // SEQPACKET keeps datagram boundaries like netlink and reports the peer closing
+   int sv[2];
+   if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+      perror("socketpair");
+      return 1;
+   }
+   CHECK(!netlink_monitor_active());
+   CHECK(netlink_monitor_start(sv[0]));
+   CHECK(netlink_monitor_active());
+
+   // A link change reaches only the link listener
+   reset_logs();
+   send_messages(sv[1], (const uint16_t[]){RTM_NEWLINK}, 1);
+   run_once();
+   CHECK(g_link.calls == 1 && g_link.last_type == RTM_NEWLINK);
+   CHECK(g_addr.calls == 0);
+
+   // An address change reaches only the address listener
+   reset_logs();
+   send_messages(sv[1], (const uint16_t[]){RTM_DELADDR}, 1);
+   run_once();
+   CHECK(g_link.calls == 0);
+   CHECK(g_addr.calls == 1 && g_addr.last_type == RTM_DELADDR);
+
+   // Several messages in one datagram, plus a second datagram queued behind it, are all
+   // dispatched in a single wakeup; NLMSG_DONE is skipped
+   reset_logs();
+   send_messages(sv[1], (const uint16_t[]){RTM_NEWLINK, RTM_NEWADDR, RTM_DELLINK, NLMSG_DONE}, 4);
+   send_messages(sv[1], (const uint16_t[]){RTM_NEWADDR}, 1);
+   run_once();
+   CHECK(g_link.calls == 2 && g_link.last_type == RTM_DELLINK);
+   CHECK(g_addr.calls == 2 && g_addr.last_type == RTM_NEWADDR);
+   CHECK(g_link.lost == 0 && g_addr.lost == 0);
+
+   // The primary MAC is read once and cached while notifications flow
+   g_hwaddr_reads = 0;
+   CHECK(primary_mac_is(0x01));
+   g_iface_hwaddr[5] = 0x02;
+   CHECK(primary_mac_is(0x01));
+   CHECK(g_hwaddr_reads == 1);
+
+   // A link coming up drops the cached MAC, and the next get reads the new one
+   send_messages(sv[1], (const uint16_t[]){RTM_NEWLINK}, 1);
+   run_once();
+   CHECK(primary_mac_is(0x02));
+   CHECK(primary_mac_is(0x02));
+   CHECK(g_hwaddr_reads == 2);
+
+   // So does a link going away
+   g_iface_hwaddr[5] = 0x03;
+   send_messages(sv[1], (const uint16_t[]){RTM_DELLINK}, 1);
+   run_once();
+   CHECK(primary_mac_is(0x03));
+   CHECK(g_hwaddr_reads == 3);
+
+   // Address changes leave it alone
+   g_iface_hwaddr[5] = 0x04;
+   send_messages(sv[1], (const uint16_t[]){RTM_NEWADDR}, 1);
+   run_once();
+   CHECK(primary_mac_is(0x03));
+   CHECK(g_hwaddr_reads == 3);
+
+   // Closing the peer stops the monitor and tells every listener its cache is stale
+   reset_logs();
+   close(sv[1]);
+   run_once();
+   CHECK(!netlink_monitor_active());
+   CHECK(g_link.lost == 1 && g_addr.lost == 1);
+
+   // Without notifications nothing would invalidate the MAC, so every get reads it
+   CHECK(primary_mac_is(0x04));
+   g_iface_hwaddr[5] = 0x05;
+   CHECK(primary_mac_is(0x05));
+   CHECK(g_hwaddr_reads == 5);
+
+   if (g_failures) {
+      fprintf(stderr, "%d check(s) failed\n", g_failures);
+      return 1;
+   }
+   printf("netlink_monitor_test: ok\n");
+   return 0;
+}
@@ -0,0 +1,100 @@
+// Drives set_session.c the way rbus delivers multi-parameter sets and checks that a
+// batch stopped by another setter does not leak into the next plain set.
+#include "rbus_elements.h"
+
+static char g_applied[8][MAX_NAME_LEN];
+static int g_num_applied = 0;
+static int g_failures = 0;
+
+#define CHECK(cond)                                                     \
+   do {                                                                 \
+      if (!(cond)) {                                                    \
+         fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+         g_failures++;                                                  \
+      }                                                                 \
+   } while (0)
+
+// The model is reduced to uint properties that always resolve
+void model_lock(void) {}
+void model_unlock(void) {}
+uint64_t changelog_version(void) { return 0; }
+
+rbusError_t set_resolve(const char* name, rbusValue_t value, bool create, SetTarget* target) {
+   (void)name; (void)value; (void)create;
+   memset(target, 0, sizeof(*target));
+   target->type = TYPE_UINT;
+   target->de = (DataElement*)&g_applied; // any non-NULL element, never dereferenced here
+   return RBUS_ERROR_SUCCESS;
+}
+
+rbusError_t value_from_rbus(ValueType type, rbusValue_t value, ElementValue* out) {
+   (void)type;
+   out->uintVal = rbusValue_GetUInt32(value);
+   return RBUS_ERROR_SUCCESS;
+}
+
+void set_apply(const char* name, const SetTarget* target, const ElementValue* v, rbusValue_t value) {
+   (void)target; (void)v; (void)value;
+   if (g_num_applied < 8) {
+      snprintf(g_applied[g_num_applied], MAX_NAME_LEN, "%s", name);
+   }
+   g_num_applied++;
+}
+
+// What setHandler does with a set: stage it when it belongs to a batch, else apply it
+static rbusError_t generic_set(const char* component, bool commit, const char* name, uint32_t v) {
+   rbusSetHandlerOptions_t opts = {.commit = commit, .sessionId = 0, .requestingComponent = component};
+   rbusValue_t value = rbusValue_InitUInt32(v);
+   rbusError_t rc = RBUS_ERROR_SUCCESS;
+   if (set_session_pending(&opts)) {
+      rc = set_session_stage(NULL, &opts, name, value);
+   } else {
+      set_apply(name, NULL, NULL, value);
+   }
+   rbusValue_Release(value);
+   return rc;
+}
+
+// What a read-only setter such as source_set_handler does
+static rbusError_t rejecting_set(const char* component, bool commit) {
+   rbusSetHandlerOptions_t opts = {.commit = commit, .sessionId = 0, .requestingComponent = component};
+   return set_session_end(NULL, &opts, RBUS_ERROR_ACCESS_NOT_ALLOWED);
+}
+
+int main(void) {
+   // A complete batch is applied at its commit
+   CHECK(generic_set("client", false, "Device.A", 1) == RBUS_ERROR_SUCCESS);
+   CHECK(g_num_applied == 0);
+   CHECK(generic_set("client", true, "Device.B", 2) == RBUS_ERROR_SUCCESS);
+   CHECK(g_num_applied == 2);
+
+   // rbus stops a batch at a rejected set and never sends the commit; the next plain set
+   // must not commit what was staged before the failure
+   g_num_applied = 0;
+   CHECK(generic_set("client", false, "Device.A", 3) == RBUS_ERROR_SUCCESS);
+   CHECK(rejecting_set("client", false) == RBUS_ERROR_ACCESS_NOT_ALLOWED);
+   CHECK(generic_set("client", true, "Device.C", 4) == RBUS_ERROR_SUCCESS);
+   CHECK(g_num_applied == 1 && strcmp(g_applied[0], "Device.C") == 0);
+
+   // A batch left open by one component is not joined by another component's set
+   g_num_applied = 0;
+   CHECK(generic_set("client", false, "Device.A", 5) == RBUS_ERROR_SUCCESS);
+   CHECK(generic_set("other", true, "Device.D", 6) == RBUS_ERROR_SUCCESS);
+   CHECK(g_num_applied == 1 && strcmp(g_applied[0], "Device.D") == 0);
+
+   // A batch whose commit is rejected by another setter is dropped as a whole
+   g_num_applied = 0;
+   CHECK(generic_set("client", false, "Device.A", 8) == RBUS_ERROR_SUCCESS);
+   CHECK(rejecting_set("client", true) == RBUS_ERROR_ACCESS_NOT_ALLOWED);
+   CHECK(g_num_applied == 0);
+   CHECK(generic_set("client", true, "Device.E", 7) == RBUS_ERROR_SUCCESS);
+   CHECK(g_num_applied == 1 && strcmp(g_applied[0], "Device.E") == 0);
+
+   set_session_cleanup();
+   if (g_failures) {
+      fprintf(stderr, "%d check(s) failed\n", g_failures);
+      return 1;
+   }
+   printf("set_session_test: ok\n");
+   return 0;
+}